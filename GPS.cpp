@@ -26,6 +26,9 @@ GPS::reset(void)
   m_date = 0;
   m_time = 0;
 #ifndef GPS_TIME_ONLY
+  m_last_time_update = 0;
+  m_early_date = 0;
+  m_early_time = 0;
   m_latitude = 0;
   m_longitude = 0;
   m_altitude = 0;
@@ -36,6 +39,135 @@ GPS::reset(void)
 #endif
 }
 
+bool
+GPS::attach(Listener* listener)
+{
+  if (listener->m_gps != NULL)
+    return (false);
+
+  for (uint8_t i = 0; i < GPS_MAX_LISTENERS; i++)
+    if (m_listener[i] == NULL)
+      {
+        listener->m_gps = this;
+        m_listener[i] = listener;
+        return (true);
+      }
+
+  return (false);
+}
+
+bool
+GPS::detach(Listener* listener)
+{
+  for (uint8_t i = 0; i < GPS_MAX_LISTENERS; i++)
+    if (m_listener[i] == listener)
+      {
+        m_listener[i] = NULL;
+        listener->m_gps = NULL;
+        return (true);
+      }
+
+  return (false);
+}
+
+void
+GPS::notify()
+{
+#ifdef GPS_INTERRUPT_IMPL
+  fix_t fix;
+  bool taken = false;
+
+
+  /* Called in the Irq; listeners get a copy of the fix as committed */
+  for (uint8_t i = 0; i < GPS_MAX_LISTENERS; i++)
+    {
+      Listener* listener = m_listener[i];
+
+
+      if (listener == NULL)
+        continue;
+
+      if (!taken)
+        {
+          snapshot(fix);
+          taken = true;
+        }
+
+      listener->m_fix = fix;
+      if (listener->m_pending)
+        m_dropped++;
+      else if (Event::push(Event::USER_TYPE, listener))
+        listener->m_pending = true;
+      else
+        m_dropped++;
+    }
+#else
+  for (uint8_t i = 0; i < GPS_MAX_LISTENERS; i++)
+    if (m_listener[i] != NULL)
+      m_listener[i]->on_fix(*this);
+#endif
+}
+
+void
+GPS::Listener::on_event(uint8_t type, uint16_t value)
+{
+  UNUSED(type);
+  UNUSED(value);
+
+#ifdef GPS_INTERRUPT_IMPL
+  fix_t fix;
+
+
+  synchronized {
+    fix = m_fix;
+    m_pending = false;
+  }
+
+  if (m_gps != NULL)
+    {
+      m_gps->m_deferred = &fix;
+      on_fix(*m_gps);
+      m_gps->m_deferred = NULL;
+    }
+#else
+  if (m_gps != NULL)
+    on_fix(*m_gps);
+#endif
+}
+
+void
+GPS::get(fix_t& fix)
+{
+#ifdef GPS_INTERRUPT_IMPL
+  if (m_deferred != NULL)
+    {
+      fix = *m_deferred;
+      return;
+    }
+
+  synchronized
+#endif
+  {
+    snapshot(fix);
+  }
+}
+
+void
+GPS::snapshot(fix_t& fix)
+{
+  fix.date = m_date;
+  fix.time = m_time;
+#ifndef GPS_TIME_ONLY
+  fix.latitude = m_latitude;
+  fix.longitude = m_longitude;
+  fix.altitude = m_altitude;
+  fix.course = m_course;
+  fix.speed = m_speed;
+  fix.satellites = m_satellites;
+  fix.hdop = m_hdop;
+#endif
+}
+
 clock_t
 GPS::clock(void)
 {
@@ -64,6 +196,75 @@ GPS::clock(void)
   return (clock_t(t));
 }
 
+#ifndef GPS_TIME_ONLY
+uint16_t
+GPS::cos_latitude(position_t latitude)
+{
+  uint32_t d;
+  uint32_t d2;
+
+
+  /* Hundredths of a degree, 0..9000 */
+  d = (latitude < 0 ? -latitude : latitude) / 10000;
+  if (d > 9000)
+    d = 9000;
+  d2 = d * d;
+
+  /* cos(x) ~ (180^2 - 4x^2) / (180^2 + x^2), scaled to Q15 */
+  d = (324000000UL - 4 * d2) / ((324000000UL + d2 + 16384) >> 15);
+
+  return (d > 32767 ? 32767 : d);
+}
+
+int16_t
+GPS::cos_course(int32_t angle)
+{
+  angle %= 36000;
+  if (angle < 0)
+    angle += 36000;
+  if (angle > 18000)
+    angle = 36000 - angle;
+  if (angle > 9000)
+    return (-(int16_t) cos_latitude((18000 - angle) * 10000L));
+  return (cos_latitude(angle * 10000L));
+}
+#endif
+
+#ifndef GPS_TIME_ONLY
+uint32_t
+GPS::speed_mph100()
+{
+  /* A knot is 57875/50292 mph; split to stay within 32 bits */
+  return ((m_speed / 50292) * 57875 +
+          ((m_speed % 50292) * 57875 + 25146) / 50292);
+}
+#endif
+
+IOStream&
+operator<<(IOStream& outs, GPS::decimal_t d)
+{
+  char buf[13];
+  char* p = buf + sizeof(buf);
+  uint32_t v = (d.value < 0 ? -(uint32_t) d.value : d.value);
+  uint8_t i = 0;
+
+
+  /* Digits from the right, at least one before the point */
+  *--p = 0;
+  do {
+    if (i == d.places && i != 0)
+      *--p = '.';
+    *--p = '0' + v % 10;
+    v /= 10;
+    i++;
+  } while (v != 0 || i <= d.places);
+  if (d.value < 0)
+    *--p = '-';
+
+  outs << p;
+  return (outs);
+}
+
 IOStream&
 operator<<(IOStream& outs, GPS& gps)
 {
@@ -73,13 +274,13 @@ operator<<(IOStream& outs, GPS& gps)
     << PSTR(",D=") << gps.date()
     << PSTR(",T=") << gps.time()
 #ifndef GPS_TIME_ONLY
-    << PSTR(",LA=") << gps.f_latitude()
-    << PSTR(",LO=") << gps.f_longitude()
-    << PSTR(",A=") << gps.f_altitude()
-    << PSTR(",C=") << gps.f_course()
-    << PSTR(",SP=") << gps.f_speed()
+    << PSTR(",LA=") << GPS::decimal(gps.latitude(), 6)
+    << PSTR(",LO=") << GPS::decimal(gps.longitude(), 6)
+    << PSTR(",A=") << GPS::decimal(gps.altitude(), 2)
+    << PSTR(",C=") << GPS::decimal(gps.course(), 2)
+    << PSTR(",SP=") << GPS::decimal(gps.speed(), 2)
     << PSTR(",SA=") << gps.satellites()
-    << PSTR(",H=") << gps.f_hdop()
+    << PSTR(",H=") << GPS::decimal(gps.hdop(), 2)
 #endif
     ;
   return (outs);
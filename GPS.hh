@@ -21,10 +21,16 @@
 #define COSA_GPS_HH
 
 #include "Cosa/IOStream.hh"
+#include "Cosa/Event.hh"
 #include "Cosa/Time.hh"
 
+/* Build options; define GPS_CONFIGURED to give them on the command
+ * line instead (e.g. test/Makefile) */
+#ifndef GPS_CONFIGURED
 #define GPS_TIME_ONLY
 //#define GPS_INTERRUPT_IMPL
+//#define GPS_SATELLITE_TABLE
+#endif
 
 #define GPS_FEET_PER_CENTIMETER 0.0328084
 
@@ -34,6 +40,8 @@
 
 #define GPS_MINIMUM_SATELLITES 4
 
+#define GPS_MAX_LISTENERS 4
+
 #ifdef GPS_INTERRUPT_IMPL
 #define GPS_VOLATILE volatile
 #else
@@ -59,6 +67,64 @@ public:
   typedef uint32_t hdop_t;
 #endif
 
+  /**
+   * Fix; snapshot of the data returned by the methods below.
+   */
+  struct fix_t {
+    date_t date;
+    gps_time_t time;
+#ifndef GPS_TIME_ONLY
+    position_t latitude;
+    position_t longitude;
+    altitude_t altitude;
+    course_t course;
+    speed_t speed;
+    satellites_t satellites;
+    hdop_t hdop;
+#endif
+  };
+
+  /**
+   * GPS Listener
+   *
+   * Receives each committed fix. Listeners are called from the commit
+   * in process_sentence(); with GPS_INTERRUPT_IMPL the call is deferred
+   * through the Cosa event queue so user code does not run in the Irq.
+   * The deferred call sees the fix as committed through GPS::get(),
+   * even if later sentences have been parsed since; while a call is
+   * pending newer commits replace the fix and are counted as dropped.
+   */
+  class Listener : public Event::Handler {
+  public:
+    Listener() :
+#ifdef GPS_INTERRUPT_IMPL
+      m_pending(false),
+#endif
+      m_gps(NULL)
+    {}
+
+    /**
+     * Called with the gps that committed a new fix.
+     * @param[in] gps
+     */
+    virtual void on_fix(GPS& gps) = 0;
+
+  protected:
+    /* Deferred notification */
+    virtual void on_event(uint8_t type, uint16_t value);
+
+#ifdef GPS_INTERRUPT_IMPL
+    /* Fix at commit and deferred call queued */
+    fix_t m_fix;
+    volatile bool m_pending;
+#endif
+
+    /* Attached to */
+    GPS* m_gps;
+
+    friend class GPS;
+  };
+
   /**
    * Construct GPS
    */
@@ -68,6 +134,9 @@ public:
     m_time(0)
 #ifndef GPS_TIME_ONLY
     ,
+    m_last_time_update(0),
+    m_early_date(0),
+    m_early_time(0),
     m_latitude(0),
     m_longitude(0),
     m_altitude(0),
@@ -76,13 +145,34 @@ public:
     m_satellites(0),
     m_hdop(0)
 #endif
-  {}
+#ifdef GPS_INTERRUPT_IMPL
+    ,
+    m_deferred(NULL),
+    m_dropped(0)
+#endif
+  {
+    memset(m_listener, 0, sizeof(m_listener));
+  }
 
   /**
    * Reset
    */
   virtual void reset();
 
+  /**
+   * Attach listener.
+   * @param[in] listener
+   * @return true if attached, false if table full or already attached
+   */
+  bool attach(Listener* listener);
+
+  /**
+   * Detach listener.
+   * @param[in] listener
+   * @return true if detached
+   */
+  bool detach(Listener* listener);
+
   /**
    * Is data valid? Data returned from methods is not valid until the
    * first GPS data is received.
@@ -104,6 +194,22 @@ public:
     return m_last_update;
   }
 
+  /**
+   * Get last early date and time update. In full builds early_date()
+   * and early_time() are published as soon as they are received, ahead
+   * of the position.
+   * @return last_time_update in milliseconds (RTC::millis)
+   */
+  last_update_t last_time_update()
+    __attribute__((always_inline))
+  {
+#ifdef GPS_TIME_ONLY
+    return m_last_update;
+#else
+    return m_last_time_update;
+#endif
+  }
+
   /**
    * Get date
    * @return date in DDMMYY
@@ -124,6 +230,57 @@ public:
     return m_time;
   }
 
+  /**
+   * Get date received ahead of the position; date() is that of the
+   * committed fix.
+   * @return date in DDMMYY
+   */
+  date_t early_date()
+    __attribute__((always_inline))
+  {
+#ifdef GPS_TIME_ONLY
+    return m_date;
+#else
+    return m_early_date;
+#endif
+  }
+
+  /**
+   * Get time received ahead of the position; time() is that of the
+   * committed fix.
+   * @return time in HHMMSSmmm
+   */
+  gps_time_t early_time()
+    __attribute__((always_inline))
+  {
+#ifdef GPS_TIME_ONLY
+    return m_time;
+#else
+    return m_early_time;
+#endif
+  }
+
+  /**
+   * Get copy of current fix, read at once. With GPS_INTERRUPT_IMPL,
+   * from GPS::Listener::on_fix() it is the fix that was committed when
+   * the call was queued.
+   * @param[out] fix
+   */
+  void get(fix_t& fix);
+
+#ifdef GPS_INTERRUPT_IMPL
+  /**
+   * Get number of listener notifications dropped, because the event
+   * queue was full or the previous call was still pending.
+   * @return dropped
+   */
+  uint16_t dropped()
+    __attribute__((always_inline))
+  {
+    return (m_dropped);
+  }
+#endif
+
   /**
    * Get clock (time since Epoch, 1970-01-01 00:00:00 +0000 (UTC))
    * @return clock
@@ -201,6 +358,17 @@ public:
     return m_altitude * GPS_FEET_PER_CENTIMETER;
   }
 
+  /**
+   * Get altitude
+   * @return altitude in 10ths of a foot, rounded
+   */
+  int32_t altitude_ft10()
+    __attribute__((always_inline))
+  {
+    /* A centimeter is 125/381 10ths of a foot */
+    return ((m_altitude * 125 + (m_altitude < 0 ? -190 : 190)) / 381);
+  }
+
   /**
    * Get course
    * @return course in 100ths of a degree
@@ -251,6 +419,12 @@ public:
     return m_speed * GPS_MILES_PER_HOUR_PER_KNOT;
   }
 
+  /**
+   * Get speed
+   * @return speed in 100ths of a mph, rounded
+   */
+  uint32_t speed_mph100();
+
   /**
    * Get speed
    * @return speed in mps
@@ -261,6 +435,17 @@ public:
     return m_speed * GPS_METERS_PER_SECOND_PER_KNOT;
   }
 
+  /**
+   * Get speed
+   * @return speed in mm/s, rounded
+   */
+  uint32_t speed_mmps()
+    __attribute__((always_inline))
+  {
+    /* A 100th of a knot is 463/90 mm/s; split to stay within 32 bits */
+    return ((m_speed / 90) * 463 + ((m_speed % 90) * 463 + 45) / 90);
+  }
+
   /**
    * Get speed
    * @return speed in kmph
@@ -271,6 +456,17 @@ public:
     return m_speed * GPS_KILOMETER_PER_HOUR_PER_KNOT;
   }
 
+  /**
+   * Get speed
+   * @return speed in 100ths of a kmph, rounded
+   */
+  uint32_t speed_kmph100()
+    __attribute__((always_inline))
+  {
+    /* A knot is 463/250 kmph; split to stay within 32 bits */
+    return ((m_speed / 250) * 463 + ((m_speed % 250) * 463 + 125) / 250);
+  }
+
   /**
    * Get satellites
    * @return satellites
@@ -300,8 +496,53 @@ public:
   {
     return m_hdop / 100.0;
   }
+
+  /**
+   * Get cosine of latitude, used to scale longitude differences
+   * to distance (Bhaskara approximation, error < 0.002).
+   * @param[in] latitude in millionths of a degree
+   * @return cosine in Q15 (32768 is 1.0)
+   */
+  static uint16_t cos_latitude(position_t latitude);
+
+  /**
+   * Get cosine of course or other angle (sine is cos_course(angle -
+   * 9000)).
+   * @param[in] angle in 100ths of a degree
+   * @return cosine in Q15
+   */
+  static int16_t cos_course(int32_t angle);
 #endif
 
+  /* Fixed point decimal number, for printing without float */
+  struct decimal_t {
+    int32_t value;
+    uint8_t places;
+  };
+
+  /**
+   * Get fixed point decimal number for printing, e.g.
+   * outs << GPS::decimal(gps.latitude(), 6).
+   * @param[in] value scaled by 10^places
+   * @param[in] places decimals (max 9)
+   * @return decimal
+   */
+  static decimal_t decimal(int32_t value, uint8_t places)
+  {
+    decimal_t d;
+    d.value = value;
+    d.places = (places > 9 ? 9 : places);
+    return (d);
+  }
+
+  /**
+   * Print fixed point decimal number to given stream.
+   * @param[in] outs output stream
+   * @param[in] d decimal
+   * @return stream
+   */
+  friend IOStream& operator<<(IOStream& outs, decimal_t d);
+
 protected:
   /* Last time updated received */
   GPS_VOLATILE last_update_t m_last_update;
@@ -313,6 +554,13 @@ protected:
   GPS_VOLATILE gps_time_t m_time;
 
 #ifndef GPS_TIME_ONLY
+  /* Last date and time update received */
+  GPS_VOLATILE last_update_t m_last_time_update;
+
+  /* Date and time received ahead of the position */
+  GPS_VOLATILE date_t m_early_date;
+  GPS_VOLATILE gps_time_t m_early_time;
+
   /* Latitude in millionths of a degree */
   GPS_VOLATILE position_t m_latitude;
 
@@ -335,6 +583,28 @@ protected:
   GPS_VOLATILE hdop_t m_hdop;
 #endif
 
+  /* Listeners */
+  Listener* m_listener[GPS_MAX_LISTENERS];
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* Fix of the deferred call in progress, if any */
+  const fix_t* m_deferred;
+
+  /* Notifications dropped */
+  volatile uint16_t m_dropped;
+#endif
+
+  /**
+   * Copy current fix.
+   * @param[out] fix
+   */
+  void snapshot(fix_t& fix);
+
+  /**
+   * Notify listeners of new fix; called by subclass on commit.
+   */
+  void notify();
+
   /**
    * Print latest gps information to
    * given stream.
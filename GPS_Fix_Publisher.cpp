@@ -0,0 +1,196 @@
+/**
+ * @file ?/GPS_Fix_Publisher.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Fix_Publisher.hh"
+
+/* Order region accesses around the sequence number. AVR has one core
+ * and orders memory accesses; keeping the compiler from reordering is
+ * enough. Elsewhere readers may run on other cores and need a fence. */
+#ifdef __AVR__
+#define barrier() __asm__ __volatile__("" ::: "memory")
+#else
+#define barrier() __sync_synchronize()
+#endif
+
+GPS_Fix_Publisher::GPS_Fix_Publisher(void* region, uint8_t entries) :
+  GPS::Listener(),
+  m_header((header_t*) region),
+  m_fix((GPS::fix_t*) (m_header + 1))
+{
+  m_header->magic = 0;
+  barrier();
+  m_header->fix_size = sizeof(GPS::fix_t);
+  m_header->entries = entries;
+  m_header->sequence = 0;
+  m_header->latest = entries - 1;
+  m_header->reserved = 0;
+  m_header->count = 0;
+  barrier();
+  m_header->magic = MAGIC;
+}
+
+void
+GPS_Fix_Publisher::on_fix(GPS& gps)
+{
+  GPS::fix_t fix;
+
+
+  gps.get(fix);
+  publish(fix);
+}
+
+void
+GPS_Fix_Publisher::publish(const GPS::fix_t& fix)
+{
+  uint8_t latest = m_header->latest + 1;
+
+
+  if (latest == m_header->entries)
+    latest = 0;
+
+  m_header->sequence++;
+  barrier();
+  m_fix[latest] = fix;
+  m_header->latest = latest;
+  m_header->count = m_header->count + 1;
+  barrier();
+  m_header->sequence++;
+}
+
+bool
+GPS_Fix_Publisher::Reader::valid()
+{
+  return (m_header->magic == MAGIC &&
+          m_header->fix_size == sizeof(GPS::fix_t) &&
+          m_header->entries != 0);
+}
+
+bool
+GPS_Fix_Publisher::Reader::history(uint8_t age, GPS::fix_t& fix)
+{
+  const GPS::fix_t* ring = (const GPS::fix_t*) (m_header + 1);
+
+
+  if (!valid() || age >= m_header->entries)
+    return (false);
+
+  for (uint8_t retry = 0; retry < RETRIES; retry++)
+    {
+      uint16_t sequence = m_header->sequence;
+      uint8_t index;
+
+      if (sequence & 1)
+        continue;
+      barrier();
+      if (age >= m_header->count)
+        return (false);
+      index = m_header->latest;
+      fix = ring[index >= age ? index - age : index + m_header->entries - age];
+      barrier();
+      if (m_header->sequence == sequence)
+        return (true);
+    }
+
+  return (false);
+}
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+void*
+GPS_Fix_Region_POSIX::create(const char* name, uint8_t entries)
+{
+  size_t size = GPS_Fix_Publisher::size(entries);
+  void* region;
+  int fd;
+
+
+  close();
+  if (entries == 0)
+    return (NULL);
+
+  fd = ::shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0)
+    return (NULL);
+  if (::ftruncate(fd, size) < 0)
+    {
+      ::close(fd);
+      return (NULL);
+    }
+  region = ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (region == MAP_FAILED)
+    return (NULL);
+
+  m_region = region;
+  m_size = size;
+
+  return (m_region);
+}
+
+const void*
+GPS_Fix_Region_POSIX::open(const char* name)
+{
+  struct stat st;
+  void* region;
+  int fd;
+
+
+  close();
+  fd = ::shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return (NULL);
+  if (::fstat(fd, &st) < 0 ||
+      (size_t) st.st_size < GPS_Fix_Publisher::size(1))
+    {
+      ::close(fd);
+      return (NULL);
+    }
+  region = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (region == MAP_FAILED)
+    return (NULL);
+
+  m_region = region;
+  m_size = st.st_size;
+
+  return (m_region);
+}
+
+void
+GPS_Fix_Region_POSIX::close()
+{
+  if (m_region == NULL)
+    return;
+
+  ::munmap(m_region, m_size);
+  m_region = NULL;
+  m_size = 0;
+}
+
+bool
+GPS_Fix_Region_POSIX::unlink(const char* name)
+{
+  return (::shm_unlink(name) == 0);
+}
+#endif
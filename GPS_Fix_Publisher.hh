@@ -0,0 +1,250 @@
+/**
+ * @file ?/GPS_Fix_Publisher.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_FIX_PUBLISHER_HH
+#define COSA_GPS_FIX_PUBLISHER_HH
+
+#include "GPS.hh"
+
+/**
+ * GPS Fix Publisher
+ *
+ * Publishes each committed fix into a fixed-layout region: a header
+ * followed by a ring of the latest fixes. The region is supplied by
+ * the caller, so it may be memory shared with other processors or
+ * processes; readers (GPS_Fix_Publisher::Reader) only need the region
+ * address and never write to it. The region is protected by a sequence
+ * number that is odd while a fix is being written (seqlock); readers
+ * retry when the sequence changed during their copy, so snapshots are
+ * consistent without locks and the writer never waits. On a Linux host
+ * GPS_Fix_Region_POSIX maps the region in shared memory.
+ */
+
+class GPS_Fix_Publisher : public GPS::Listener {
+public:
+  /* Region header; the ring of fixes follows */
+  struct header_t {
+    uint16_t magic;
+    uint8_t fix_size;           // sizeof(GPS::fix_t), layout check
+    uint8_t entries;            // fixes in ring
+    volatile uint16_t sequence; // odd while writing
+    volatile uint8_t latest;    // index of latest fix in ring
+    uint8_t reserved;
+    volatile uint32_t count;    // fixes published
+  };
+
+  /**
+   * Get size of region for given number of fixes.
+   * @param[in] entries in ring
+   * @return bytes
+   */
+  static size_t size(uint8_t entries)
+  {
+    return (sizeof(header_t) + entries * sizeof(GPS::fix_t));
+  }
+
+  /**
+   * Construct publisher and initiate region.
+   * @param[in] region of size(entries) bytes
+   * @param[in] entries in ring (1..255)
+   */
+  GPS_Fix_Publisher(void* region, uint8_t entries);
+
+  /**
+   * @override GPS::Listener
+   * Publish committed fix.
+   * @param[in] gps
+   */
+  virtual void on_fix(GPS& gps);
+
+  /**
+   * Publish fix.
+   * @param[in] fix
+   */
+  void publish(const GPS::fix_t& fix);
+
+  /**
+   * GPS Fix Publisher Reader
+   *
+   * Read-only view of a published region.
+   */
+  class Reader {
+  public:
+    /**
+     * Construct reader of given region.
+     * @param[in] region
+     */
+    Reader(const void* region) :
+      m_header((const header_t*) region)
+    {}
+
+    /**
+     * Is region initiated with a compatible layout?
+     * @return valid
+     */
+    bool valid();
+
+    /**
+     * Get number of fixes published; changes when a new fix is
+     * available.
+     * @return count
+     */
+    uint32_t count()
+      __attribute__((always_inline))
+    {
+      return (m_header->count);
+    }
+
+    /**
+     * Get snapshot of latest fix.
+     * @param[out] fix
+     * @return true if read, false if none published or no consistent
+     *   copy within retries
+     */
+    bool latest(GPS::fix_t& fix)
+    {
+      return (history(0, fix));
+    }
+
+    /**
+     * Get snapshot of an earlier fix.
+     * @param[in] age 0 for latest, 1 for the one before, etc.
+     * @param[out] fix
+     * @return true if read, false if not available or no consistent
+     *   copy within retries
+     */
+    bool history(uint8_t age, GPS::fix_t& fix);
+
+  protected:
+    /* Retries before a snapshot is given up */
+    static const uint8_t RETRIES = 8;
+
+    const header_t* m_header;
+  };
+
+protected:
+  static const uint16_t MAGIC = 0x4750;
+
+  header_t* m_header;
+  GPS::fix_t* m_fix;
+};
+
+/**
+ * GPS Fix Publisher with region for ENTRIES fixes, e.g. for readers in
+ * other contexts of the same program.
+ */
+
+template<uint8_t ENTRIES>
+class GPS_Fix_Publishers : public GPS_Fix_Publisher {
+public:
+  GPS_Fix_Publishers() :
+    GPS_Fix_Publisher(&m_region, ENTRIES)
+  {}
+
+  /**
+   * Get region, for readers.
+   * @return region
+   */
+  const void* region()
+    __attribute__((always_inline))
+  {
+    return (&m_region);
+  }
+
+private:
+  struct {
+    header_t header;
+    GPS::fix_t fix[ENTRIES];
+  } m_region;
+};
+
+#ifdef __linux__
+/**
+ * GPS Fix Region POSIX
+ *
+ * Region in POSIX shared memory (shm_open), for readers in other
+ * processes on a Linux host. The publishing process creates the region
+ * and passes it to GPS_Fix_Publisher; readers open it by name, mapped
+ * read-only, and pass it to GPS_Fix_Publisher::Reader.
+ *
+ * Host only; not defined on other targets.
+ */
+
+class GPS_Fix_Region_POSIX {
+public:
+  /**
+   * Construct without region.
+   */
+  GPS_Fix_Region_POSIX() :
+    m_region(NULL),
+    m_size(0)
+  {}
+
+  /**
+   * Destruct; unmap region. The shared memory object is kept.
+   */
+  ~GPS_Fix_Region_POSIX()
+  {
+    close();
+  }
+
+  /**
+   * Create or resize shared memory object and map it for writing.
+   * @param[in] name of object, e.g. "/gps"
+   * @param[in] entries in ring (1..255)
+   * @return region of GPS_Fix_Publisher::size(entries) bytes, NULL on
+   *   error
+   */
+  void* create(const char* name, uint8_t entries);
+
+  /**
+   * Map existing shared memory object for reading.
+   * @param[in] name of object
+   * @return region, NULL on error
+   */
+  const void* open(const char* name);
+
+  /**
+   * Unmap region.
+   */
+  void close();
+
+  /**
+   * Remove shared memory object; mapped regions stay valid.
+   * @param[in] name of object
+   * @return true if removed
+   */
+  static bool unlink(const char* name);
+
+  /**
+   * Get mapped region.
+   * @return region, NULL if none
+   */
+  const void* region()
+    __attribute__((always_inline))
+  {
+    return (m_region);
+  }
+
+protected:
+  void* m_region;
+  size_t m_size;
+};
+#endif
+#endif
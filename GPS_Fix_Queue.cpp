@@ -0,0 +1,72 @@
+/**
+ * @file ?/GPS_Fix_Queue.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Fix_Queue.hh"
+
+/*
+ * Entries are published by moving head and released by moving tail.
+ * AVR has one core and keeps the order of its memory accesses, so the
+ * compiler only must not move the entry copy past the index update.
+ * On a multi-core host the consumer may run on another core and needs
+ * a memory barrier.
+ */
+#ifdef __AVR__
+#define barrier() __asm__ __volatile__("" ::: "memory")
+#else
+#define barrier() __sync_synchronize()
+#endif
+
+bool
+GPS_Fix_Queue::put(GPS& gps)
+{
+  uint8_t head = m_head;
+  uint8_t next = (head + 1) & m_mask;
+
+
+  if (next == m_tail)
+    {
+      m_dropped++;
+      return (false);
+    }
+
+  /* Fill entry before it is published by moving head */
+  m_entry[head].gps = &gps;
+  gps.get(m_entry[head].fix);
+  barrier();
+  m_head = next;
+
+  return (true);
+}
+
+bool
+GPS_Fix_Queue::get(entry_t& entry)
+{
+  uint8_t tail = m_tail;
+
+
+  if (tail == m_head)
+    return (false);
+
+  /* Copy entry before it is released by moving tail */
+  entry = m_entry[tail];
+  barrier();
+  m_tail = (tail + 1) & m_mask;
+
+  return (true);
+}
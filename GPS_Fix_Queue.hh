@@ -0,0 +1,151 @@
+/**
+ * @file ?/GPS_Fix_Queue.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_FIX_QUEUE_HH
+#define COSA_GPS_FIX_QUEUE_HH
+
+#include "GPS.hh"
+
+/**
+ * GPS Fix Queue
+ *
+ * Bounded queue of committed fixes from one or more GPS, for a consumer
+ * that runs apart from the parsers. Attach an Input to each GPS; fixes
+ * are queued in commit order, so the order per receiver is kept. The
+ * queue is lock-free for one producer and one consumer context, e.g.
+ * parsers in an interrupt handler and the consumer in the main loop; a
+ * fix committed while the queue is full is dropped and counted.
+ * Storage is supplied by GPS_Fix_Queues<>.
+ *
+ * Many receivers share one queue as long as their fixes are committed
+ * in the same context, e.g. all serviced by one GPS_NMEA_Pool, or all
+ * in interrupt handlers, which do not nest. Parsers committing from
+ * different contexts that may preempt each other need a queue each.
+ */
+
+class GPS_Fix_Queue {
+public:
+  /* Queued fix */
+  struct entry_t {
+    GPS* gps;
+    GPS::fix_t fix;
+  };
+
+  /**
+   * Construct queue with given storage.
+   * @param[in] entry storage
+   * @param[in] entries number of entries (power of 2, max 128)
+   */
+  GPS_Fix_Queue(entry_t* entry, uint8_t entries) :
+    m_entry(entry),
+    m_mask(entries - 1),
+    m_head(0),
+    m_tail(0),
+    m_dropped(0)
+  {}
+
+  /**
+   * Queue input from one GPS
+   */
+  class Input : public GPS::Listener {
+  public:
+    /**
+     * Construct input to given queue.
+     * @param[in] queue
+     */
+    Input(GPS_Fix_Queue* queue) :
+      GPS::Listener(),
+      m_queue(queue)
+    {}
+
+    /**
+     * @override GPS::Listener
+     * Queue committed fix.
+     * @param[in] gps
+     */
+    virtual void on_fix(GPS& gps)
+    {
+      m_queue->put(gps);
+    }
+
+  protected:
+    GPS_Fix_Queue* m_queue;
+  };
+
+  /**
+   * Queue current fix of given GPS.
+   * @param[in] gps
+   * @return true if queued, false if queue full
+   */
+  bool put(GPS& gps);
+
+  /**
+   * Get oldest fix.
+   * @param[out] entry fix and the GPS it came from
+   * @return true if a fix was dequeued, false if empty
+   */
+  bool get(entry_t& entry);
+
+  /**
+   * Get number of queued fixes
+   * @return fixes
+   */
+  uint8_t available()
+    __attribute__((always_inline))
+  {
+    return ((m_head - m_tail) & m_mask);
+  }
+
+  /**
+   * Get number of fixes dropped because the queue was full
+   * @return dropped
+   */
+  uint16_t dropped()
+    __attribute__((always_inline))
+  {
+    return (m_dropped);
+  }
+
+protected:
+  entry_t* m_entry;
+  uint8_t m_mask;
+
+  /* Written by producer and consumer only */
+  volatile uint8_t m_head;
+  volatile uint8_t m_tail;
+
+  uint16_t m_dropped;
+};
+
+/**
+ * GPS Fix Queue with storage for ENTRIES - 1 fixes; ENTRIES is a
+ * power of 2, max 128.
+ */
+
+template<uint8_t ENTRIES>
+class GPS_Fix_Queues : public GPS_Fix_Queue {
+public:
+  GPS_Fix_Queues() :
+    GPS_Fix_Queue(m_entry_buf, ENTRIES)
+  {}
+
+private:
+  entry_t m_entry_buf[ENTRIES];
+};
+#endif
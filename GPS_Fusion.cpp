@@ -0,0 +1,223 @@
+/**
+ * @file ?/GPS_Fusion.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "Cosa/RTT.hh"
+
+#include "GPS_Fusion.hh"
+
+GPS_Fusion::GPS_Fusion(uint16_t stall) :
+  GPS(),
+  m_stall(stall),
+  m_epoch_date(0),
+  m_epoch_time(0),
+  m_reported(0),
+  m_expected(0),
+  m_used(0),
+  m_failovers(0)
+{
+  for (uint8_t i = 0; i < GPS_FUSION_RECEIVERS; i++)
+    m_input[i].m_fusion = this;
+}
+
+bool
+GPS_Fusion::add(GPS* gps)
+{
+  for (uint8_t i = 0; i < GPS_FUSION_RECEIVERS; i++)
+    if (m_input[i].gps() == NULL)
+      return (gps->attach(&m_input[i]));
+
+  return (false);
+}
+
+bool
+GPS_Fusion::remove(GPS* gps)
+{
+  for (uint8_t i = 0; i < GPS_FUSION_RECEIVERS; i++)
+    if (m_input[i].gps() == gps)
+      {
+        m_reported &= ~_BV(i);
+        m_expected &= ~_BV(i);
+        return (gps->detach(&m_input[i]));
+      }
+
+  return (false);
+}
+
+void
+GPS_Fusion::reset()
+{
+  GPS::reset();
+  m_epoch_date = 0;
+  m_epoch_time = 0;
+  m_reported = 0;
+  m_expected = 0;
+  m_used = 0;
+}
+
+void
+GPS_Fusion::Input::on_fix(GPS& gps)
+{
+  gps.get(m_fix);
+  m_received = RTT::millis();
+  m_fusion->align(this);
+}
+
+void
+GPS_Fusion::align(Input* input)
+{
+  uint8_t bit = _BV(input - m_input);
+
+
+  /* Late fix of the epoch already fused; expect it next time */
+  if (valid() && input->m_fix.time == m_time && input->m_fix.date == m_date)
+    {
+      m_expected |= bit;
+      return;
+    }
+
+  if (input->m_fix.time != m_epoch_time || input->m_fix.date != m_epoch_date)
+    {
+      /* New epoch; fuse the pending one without the missing receivers */
+      if (m_reported != 0)
+        fuse();
+      m_epoch_date = input->m_fix.date;
+      m_epoch_time = input->m_fix.time;
+      m_reported = 0;
+    }
+
+  m_reported |= bit;
+  if ((m_reported & waiting()) == waiting())
+    fuse();
+}
+
+uint8_t
+GPS_Fusion::waiting()
+{
+  uint8_t waiting = m_expected;
+
+
+  /* Stalled receivers are not waited for */
+  for (uint8_t i = 0; i < GPS_FUSION_RECEIVERS; i++)
+    if ((waiting & _BV(i)) && !(m_reported & _BV(i)) &&
+        RTT::since(m_input[i].m_received) > m_stall)
+      waiting &= ~_BV(i);
+
+  return (waiting);
+}
+
+void
+GPS_Fusion::service()
+{
+  if (m_reported != 0 && (m_reported & waiting()) == waiting())
+    fuse();
+}
+
+#ifndef GPS_TIME_ONLY
+uint16_t
+GPS_Fusion::weight(const GPS::fix_t& fix)
+{
+  hdop_t hdop = (fix.hdop < 50 ? 50 : fix.hdop);
+
+
+  /* At most 12 * 200 */
+  return ((fix.satellites == 0 ? 1 : fix.satellites) * 10000UL / hdop);
+}
+#endif
+
+void
+GPS_Fusion::fuse()
+{
+  Input* best = NULL;
+#ifndef GPS_TIME_ONLY
+  const GPS::fix_t* ref = NULL;
+  int64_t latitude = 0;
+  int64_t longitude = 0;
+  int64_t altitude = 0;
+  uint32_t total = 0;
+  uint16_t best_weight = 0;
+  satellites_t satellites = 0;
+  int32_t d;
+#endif
+
+
+  for (uint8_t i = 0; i < GPS_FUSION_RECEIVERS; i++)
+    {
+      Input* input = &m_input[i];
+
+      if (!(m_reported & _BV(i)))
+        continue;
+#ifdef GPS_TIME_ONLY
+      if (best == NULL)
+        best = input;
+#else
+      uint16_t w = weight(input->m_fix);
+
+      /* Sum weighted offsets from the first fix; the short way round
+       * across the antimeridian */
+      if (ref == NULL)
+        ref = &input->m_fix;
+      d = input->m_fix.longitude - ref->longitude;
+      if (d > 180000000L) d -= 360000000L;
+      else if (d < -180000000L) d += 360000000L;
+      latitude += (int64_t) (input->m_fix.latitude - ref->latitude) * w;
+      longitude += (int64_t) d * w;
+      altitude += (int64_t) (input->m_fix.altitude - ref->altitude) * w;
+      total += w;
+      if (w > best_weight)
+        {
+          best_weight = w;
+          best = input;
+        }
+      if (input->m_fix.satellites > satellites)
+        satellites = input->m_fix.satellites;
+#endif
+    }
+  if (best == NULL)
+    return;
+
+  if (m_expected & ~m_reported)
+    m_failovers++;
+
+  m_used = m_reported;
+  m_expected = m_reported;
+  m_reported = 0;
+
+  m_date = m_epoch_date;
+  m_time = m_epoch_time;
+#ifndef GPS_TIME_ONLY
+  m_latitude = ref->latitude + (position_t) (latitude / total);
+  d = ref->longitude + (int32_t) (longitude / total);
+  if (d > 180000000L) d -= 360000000L;
+  else if (d <= -180000000L) d += 360000000L;
+  m_longitude = d;
+  m_altitude = ref->altitude + (altitude_t) (altitude / total);
+  m_course = best->m_fix.course;
+  m_speed = best->m_fix.speed;
+  m_satellites = satellites;
+  m_hdop = best->m_fix.hdop;
+#endif
+  m_last_update = RTT::millis();
+#ifndef GPS_TIME_ONLY
+  m_last_time_update = m_last_update;
+  m_early_date = m_date;
+  m_early_time = m_time;
+#endif
+
+  notify();
+}
@@ -0,0 +1,157 @@
+/**
+ * @file ?/GPS_Fusion.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_FUSION_HH
+#define COSA_GPS_FUSION_HH
+
+#include "GPS.hh"
+
+#define GPS_FUSION_RECEIVERS 3
+
+/* Receiver stall timeout in milliseconds */
+#define GPS_FUSION_STALL 1500
+
+/**
+ * GPS Fusion
+ *
+ * A GPS fed by the committed fixes of several receivers, e.g. redundant
+ * receivers on one vehicle. Fixes are aligned by GPS time; an epoch is
+ * fused as soon as every receiver expected for it has reported, or when
+ * a fix of a later epoch arrives. A receiver is expected if it reported
+ * for the previous epoch and has not stalled. When a receiver stops,
+ * the epoch it misses is fused as soon as it has stalled, checked as
+ * the others report and in service(), and later epochs are fused
+ * without waiting for it. In full builds the position and altitude are
+ * averaged with weights from satellites and hdop; course, speed and
+ * hdop are taken from the best receiver. Listeners attached to the
+ * fusion receive the fused fixes.
+ */
+
+class GPS_Fusion : public GPS {
+public:
+  /**
+   * Construct fusion.
+   * @param[in] stall milliseconds without fix before a receiver is
+   *   no longer expected
+   */
+  GPS_Fusion(uint16_t stall = GPS_FUSION_STALL);
+
+  /**
+   * Add receiver.
+   * @param[in] gps receiver
+   * @return true if added, false if full or listener table of gps full
+   */
+  bool add(GPS* gps);
+
+  /**
+   * Remove receiver.
+   * @param[in] gps receiver
+   * @return true if removed
+   */
+  bool remove(GPS* gps);
+
+  /**
+   * Fuse the pending epoch when the receivers still missing from it
+   * have stalled. Call periodically, e.g. from the loop, so that the
+   * epoch a receiver misses is not held until the next one arrives.
+   */
+  void service();
+
+  /**
+   * @override GPS
+   * Reset fused fix and alignment.
+   */
+  virtual void reset();
+
+  /**
+   * Get receivers used in latest fused fix.
+   * @return mask, bit n for the n:th receiver added
+   */
+  uint8_t used()
+    __attribute__((always_inline))
+  {
+    return (m_used);
+  }
+
+  /**
+   * Get number of times an expected receiver was missing from an epoch.
+   * @return failovers
+   */
+  uint16_t failovers()
+    __attribute__((always_inline))
+  {
+    return (m_failovers);
+  }
+
+protected:
+  /* Receiver input */
+  class Input : public GPS::Listener {
+  public:
+    Input() :
+      GPS::Listener(),
+      m_fusion(NULL),
+      m_received(0)
+    {}
+
+    /**
+     * @override GPS::Listener
+     * Align fix with the other receivers.
+     * @param[in] gps
+     */
+    virtual void on_fix(GPS& gps);
+
+    /* Receiver attached to */
+    GPS* gps()
+    {
+      return (m_gps);
+    }
+
+    GPS_Fusion* m_fusion;
+    GPS::fix_t m_fix;
+    uint32_t m_received;
+  };
+
+  Input m_input[GPS_FUSION_RECEIVERS];
+  uint16_t m_stall;
+
+  /* Epoch being aligned; receivers reported and expected */
+  date_t m_epoch_date;
+  gps_time_t m_epoch_time;
+  uint8_t m_reported;
+  uint8_t m_expected;
+
+  /* Latest fused fix */
+  uint8_t m_used;
+  uint16_t m_failovers;
+
+  /* Add receiver fix to epoch */
+  void align(Input* input);
+
+  /* Expected receivers that have not stalled */
+  uint8_t waiting();
+
+  /* Fuse reported fixes and notify */
+  void fuse();
+
+#ifndef GPS_TIME_ONLY
+  /* Weight of fix from satellites and hdop */
+  static uint16_t weight(const GPS::fix_t& fix);
+#endif
+};
+#endif
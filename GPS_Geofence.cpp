@@ -0,0 +1,378 @@
+/**
+ * @file ?/GPS_Geofence.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Geofence.hh"
+
+#ifndef GPS_TIME_ONLY
+
+/**
+ * The grid covers the bounding box of all fences with ROWS x COLS
+ * cells. Each fence is referenced from every cell its bounding box
+ * overlaps (compressed rows: m_cells[c]..m_cells[c+1] index m_entry).
+ * A fence containing the position is therefore always found in the
+ * position's cell, and a fence we leave was found in the previous cell,
+ * so only those two cells need to be tested per fix.
+ */
+
+GPS_Geofence::GPS_Geofence(fence_t* fences, uint16_t max_fences,
+                           vertex_t* vertices, uint16_t max_vertices,
+                           uint8_t* inside,
+                           uint16_t* cells, uint8_t rows, uint8_t cols,
+                           uint16_t* entries, uint16_t max_entries) :
+  m_fence(fences),
+  m_max_fences(max_fences),
+  m_vertex(vertices),
+  m_max_vertices(max_vertices),
+  m_inside(inside),
+  m_cells(cells),
+  m_rows(rows),
+  m_cols(cols),
+  m_entry(entries),
+  m_max_entries(max_entries)
+{
+  clear();
+}
+
+void
+GPS_Geofence::clear()
+{
+  m_fences = 0;
+  m_vertices = 0;
+  m_origin_latitude = 0;
+  m_origin_longitude = 0;
+  m_cell_height = 1;
+  m_cell_width = 1;
+  m_cell = NONE;
+  m_tested = 0;
+  memset(m_inside, 0, (m_max_fences + 7) / 8);
+  memset(m_cells, 0, (m_rows * m_cols + 1) * sizeof(uint16_t));
+}
+
+uint16_t
+GPS_Geofence::add_circle(position_t latitude, position_t longitude,
+                         uint32_t radius)
+{
+  fence_t* fence;
+
+
+  /* Meters to units; 1m is 8.983 millionths of a degree latitude */
+  if (m_fences == m_max_fences || radius > 58000)
+    return (NONE);
+
+  fence = &m_fence[m_fences];
+  fence->latitude = latitude;
+  fence->longitude = longitude;
+  fence->circle.radius = (radius * 575 + 512) >> 10;
+  fence->circle.cos = GPS::cos_latitude(latitude);
+  if (fence->circle.cos == 0)
+    fence->circle.cos = 1;
+  fence->first = 0;
+  fence->count = 0;
+
+  return (m_fences++);
+}
+
+uint16_t
+GPS_Geofence::add_polygon(const position_t* latitude,
+                          const position_t* longitude,
+                          uint8_t count)
+{
+  fence_t* fence;
+  position_t south, west, north, east;
+
+
+  if (m_fences == m_max_fences ||
+      count < 3 ||
+      m_vertices + count > m_max_vertices)
+    return (NONE);
+
+  south = north = latitude[0];
+  west = east = longitude[0];
+  for (uint8_t i = 1; i < count; i++)
+    {
+      if (latitude[i] < south) south = latitude[i];
+      if (latitude[i] > north) north = latitude[i];
+      if (longitude[i] < west) west = longitude[i];
+      if (longitude[i] > east) east = longitude[i];
+    }
+
+  if (((uint32_t)(north - south) >> UNIT_SHIFT) > UNIT_MAX ||
+      ((uint32_t)(east - west) >> UNIT_SHIFT) > UNIT_MAX)
+    return (NONE);
+
+  fence = &m_fence[m_fences];
+  fence->latitude = south;
+  fence->longitude = west;
+  fence->polygon.height = (uint32_t)(north - south) >> UNIT_SHIFT;
+  fence->polygon.width = (uint32_t)(east - west) >> UNIT_SHIFT;
+  fence->first = m_vertices;
+  fence->count = count;
+
+  for (uint8_t i = 0; i < count; i++, m_vertices++)
+    {
+      m_vertex[m_vertices].latitude =
+        (uint32_t)(latitude[i] - south) >> UNIT_SHIFT;
+      m_vertex[m_vertices].longitude =
+        (uint32_t)(longitude[i] - west) >> UNIT_SHIFT;
+    }
+
+  return (m_fences++);
+}
+
+void
+GPS_Geofence::bounds(fence_t* fence,
+                     position_t& south, position_t& west,
+                     position_t& north, position_t& east)
+{
+  uint32_t height, width;
+
+
+  if (fence->count == 0)
+    {
+      height = (uint32_t)fence->circle.radius << UNIT_SHIFT;
+
+      /* Widens toward the poles; at most half way around */
+      width = (fence->circle.radius * 32768UL) / fence->circle.cos;
+      if (width > (180000000UL >> UNIT_SHIFT))
+        width = (180000000UL >> UNIT_SHIFT);
+      width <<= UNIT_SHIFT;
+      south = fence->latitude - height;
+      north = fence->latitude + height;
+      west = fence->longitude - width;
+      east = fence->longitude + width;
+    }
+  else
+    {
+      south = fence->latitude;
+      west = fence->longitude;
+      north = south + ((uint32_t)fence->polygon.height << UNIT_SHIFT);
+      east = west + ((uint32_t)fence->polygon.width << UNIT_SHIFT);
+    }
+}
+
+bool
+GPS_Geofence::index()
+{
+  position_t south, west, north, east;
+  position_t min_lat, min_lon, max_lat, max_lon;
+  uint16_t ncells = m_rows * m_cols;
+  uint16_t total;
+
+
+  memset(m_inside, 0, (m_max_fences + 7) / 8);
+  memset(m_cells, 0, (ncells + 1) * sizeof(uint16_t));
+  m_cell = NONE;
+
+  if (m_fences == 0)
+    return (true);
+
+  /* Grid covers all fences */
+  bounds(&m_fence[0], min_lat, min_lon, max_lat, max_lon);
+  for (uint16_t f = 1; f < m_fences; f++)
+    {
+      bounds(&m_fence[f], south, west, north, east);
+      if (south < min_lat) min_lat = south;
+      if (west < min_lon) min_lon = west;
+      if (north > max_lat) max_lat = north;
+      if (east > max_lon) max_lon = east;
+    }
+
+  m_origin_latitude = min_lat;
+  m_origin_longitude = min_lon;
+  m_cell_height = (uint32_t)(max_lat - min_lat) / m_rows + 1;
+  m_cell_width = (uint32_t)(max_lon - min_lon) / m_cols + 1;
+
+  /* Count references per cell */
+  for (uint16_t f = 0; f < m_fences; f++)
+    {
+      bounds(&m_fence[f], south, west, north, east);
+      uint8_t r0 = (uint32_t)(south - min_lat) / m_cell_height;
+      uint8_t r1 = (uint32_t)(north - min_lat) / m_cell_height;
+      uint8_t c0 = (uint32_t)(west - min_lon) / m_cell_width;
+      uint8_t c1 = (uint32_t)(east - min_lon) / m_cell_width;
+      for (uint8_t r = r0; r <= r1; r++)
+        for (uint8_t c = c0; c <= c1; c++)
+          m_cells[r * m_cols + c]++;
+    }
+
+  /* Cumulative counts; m_cells[c] is end of cell c */
+  total = 0;
+  for (uint16_t c = 0; c < ncells; c++)
+    {
+      if ((uint32_t)total + m_cells[c] > m_max_entries)
+        {
+          memset(m_cells, 0, (ncells + 1) * sizeof(uint16_t));
+          return (false);
+        }
+      total += m_cells[c];
+      m_cells[c] = total;
+    }
+  m_cells[ncells] = total;
+
+  /* Fill backwards; m_cells[c] ends as start of cell c */
+  for (uint16_t f = m_fences; f-- > 0; )
+    {
+      bounds(&m_fence[f], south, west, north, east);
+      uint8_t r0 = (uint32_t)(south - min_lat) / m_cell_height;
+      uint8_t r1 = (uint32_t)(north - min_lat) / m_cell_height;
+      uint8_t c0 = (uint32_t)(west - min_lon) / m_cell_width;
+      uint8_t c1 = (uint32_t)(east - min_lon) / m_cell_width;
+      for (uint8_t r = r0; r <= r1; r++)
+        for (uint8_t c = c0; c <= c1; c++)
+          m_entry[--m_cells[r * m_cols + c]] = f;
+    }
+
+  return (true);
+}
+
+uint16_t
+GPS_Geofence::cell(position_t latitude, position_t longitude)
+{
+  uint32_t r, c;
+
+
+  if (latitude < m_origin_latitude || longitude < m_origin_longitude)
+    return (NONE);
+
+  r = (uint32_t)(latitude - m_origin_latitude) / m_cell_height;
+  c = (uint32_t)(longitude - m_origin_longitude) / m_cell_width;
+  if (r >= m_rows || c >= m_cols)
+    return (NONE);
+
+  return (r * m_cols + c);
+}
+
+bool
+GPS_Geofence::contains(fence_t* fence,
+                       position_t latitude, position_t longitude)
+{
+  int32_t y, x;
+
+
+  y = (latitude - fence->latitude) >> UNIT_SHIFT;
+  x = (longitude - fence->longitude) >> UNIT_SHIFT;
+
+  if (fence->count == 0)
+    {
+      int32_t r = fence->circle.radius;
+      int32_t w = (r * 32768L) / fence->circle.cos;
+
+      /* Bounding box first, keeps products within 32 bits; the box
+       * widens toward the poles as in bounds() */
+      if (y > r || y < -r || x > w || x < -w)
+        return (false);
+      x = (x * fence->circle.cos) >> 15;
+      if (x > r || x < -r)
+        return (false);
+      return ((uint32_t)(x * x) + (uint32_t)(y * y) <= (uint32_t)(r * r));
+    }
+
+  if (y < 0 || y > fence->polygon.height ||
+      x < 0 || x > fence->polygon.width)
+    return (false);
+
+  /* Even-odd rule; vertex offsets and position are within 0..UNIT_MAX */
+  vertex_t* v = &m_vertex[fence->first];
+  bool in = false;
+  for (uint8_t i = 0, j = fence->count - 1; i < fence->count; j = i++)
+    {
+      int32_t yi = v[i].latitude, yj = v[j].latitude;
+      if ((yi > y) != (yj > y))
+        {
+          int32_t xi = v[i].longitude, xj = v[j].longitude;
+          int32_t cross = (x - xi) * (yj - yi) - (xj - xi) * (y - yi);
+          if (yj > yi ? cross < 0 : cross > 0)
+            in = !in;
+        }
+    }
+
+  return (in);
+}
+
+void
+GPS_Geofence::test(uint16_t cell, position_t latitude, position_t longitude,
+                   bool only_inside)
+{
+  for (uint16_t e = m_cells[cell]; e < m_cells[cell + 1]; e++)
+    {
+      uint16_t f = m_entry[e];
+      bool was = inside(f);
+
+      if (only_inside && !was)
+        continue;
+
+      m_tested++;
+      if (contains(&m_fence[f], latitude, longitude) == was)
+        continue;
+
+      m_inside[f >> 3] ^= _BV(f & 7);
+      if (was)
+        on_exit(f);
+      else
+        on_enter(f);
+    }
+}
+
+void
+GPS_Geofence::evaluate(position_t latitude, position_t longitude)
+{
+  uint16_t current = cell(latitude, longitude);
+
+
+  m_tested = 0;
+
+  /* Fences we may have left were referenced from previous cell */
+  if (m_cell != NONE && m_cell != current)
+    test(m_cell, latitude, longitude, true);
+
+  if (current != NONE)
+    test(current, latitude, longitude, false);
+
+  m_cell = current;
+}
+
+void
+GPS_Geofence::update(GPS& gps)
+{
+  GPS::fix_t fix;
+
+
+  if (!gps.valid())
+    return;
+
+  gps.get(fix);
+  evaluate(fix.latitude, fix.longitude);
+}
+
+void
+GPS_Geofence::on_enter(uint16_t fence)
+{
+  UNUSED(fence);
+
+  /* May be implemented by subsclasses */
+}
+
+void
+GPS_Geofence::on_exit(uint16_t fence)
+{
+  UNUSED(fence);
+
+  /* May be implemented by subsclasses */
+}
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file ?/GPS_Geofence.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_GEOFENCE_HH
+#define COSA_GPS_GEOFENCE_HH
+
+#include "GPS.hh"
+
+#ifndef GPS_TIME_ONLY
+
+/**
+ * GPS Geofence
+ *
+ * Circular and polygon fences stored in a compact fixed-point format
+ * and bucketed in a uniform latitude/longitude grid so that each fix
+ * only tests the fences overlapping its cell. Storage is supplied by
+ * GPS_Geofences<> (no heap). Subclass and implement on_enter()/on_exit()
+ * to receive events; attach to a GPS to be fed each committed fix, or
+ * call update()/evaluate() directly.
+ *
+ * Distances are kept in units of 16 millionths of a degree (about 1.8m
+ * of latitude). A circle radius and a polygon extent are limited to
+ * 32767 units (about 58km).
+ */
+
+class GPS_Geofence : public GPS::Listener {
+public:
+  typedef GPS::position_t position_t;
+
+  /* Fence distance unit is (1 << UNIT_SHIFT) millionths of a degree */
+  static const uint8_t UNIT_SHIFT = 4;
+
+  /* Maximum radius/extent in units */
+  static const uint16_t UNIT_MAX = 32767;
+
+  /* No fence/no cell */
+  static const uint16_t NONE = 0xffff;
+
+  /* Polygon vertex, offset from the polygon south-west corner in units */
+  struct vertex_t {
+    int16_t latitude;
+    int16_t longitude;
+  };
+
+  /* Fence */
+  struct fence_t {
+    /* Circle center or polygon south-west corner */
+    position_t latitude;
+    position_t longitude;
+    union {
+      struct {
+        uint16_t radius;      // units
+        uint16_t cos;         // Q15 cosine of center latitude
+      } circle;
+      struct {
+        uint16_t height;      // latitude extent in units
+        uint16_t width;       // longitude extent in units
+      } polygon;
+    };
+    uint16_t first;           // polygon first vertex
+    uint8_t count;            // polygon vertices, 0 for circle
+  };
+
+  /**
+   * Construct GPS_Geofence on given storage. Use GPS_Geofences<>.
+   */
+  GPS_Geofence(fence_t* fences, uint16_t max_fences,
+               vertex_t* vertices, uint16_t max_vertices,
+               uint8_t* inside,
+               uint16_t* cells, uint8_t rows, uint8_t cols,
+               uint16_t* entries, uint16_t max_entries);
+
+  /**
+   * Remove all fences
+   */
+  void clear();
+
+  /**
+   * Add circular fence.
+   * @param[in] latitude center in millionths of a degree
+   * @param[in] longitude center in millionths of a degree
+   * @param[in] radius in meters
+   * @return fence number or NONE if full or too large
+   */
+  uint16_t add_circle(position_t latitude, position_t longitude,
+                      uint32_t radius);
+
+  /**
+   * Add polygon fence.
+   * @param[in] latitude vertex latitudes in millionths of a degree
+   * @param[in] longitude vertex longitudes in millionths of a degree
+   * @param[in] count number of vertices (3..255)
+   * @return fence number or NONE if full or too large
+   */
+  uint16_t add_polygon(const position_t* latitude,
+                       const position_t* longitude,
+                       uint8_t count);
+
+  /**
+   * Build grid index. Must be called after fences have been added and
+   * before update()/evaluate().
+   * @return true if index fits storage
+   */
+  bool index();
+
+  /**
+   * Evaluate committed fix from given gps.
+   * @param[in] gps to evaluate
+   */
+  void update(GPS& gps);
+
+  /**
+   * @override GPS::Listener
+   * Evaluate committed fix.
+   * @param[in] gps
+   */
+  virtual void on_fix(GPS& gps)
+  {
+    update(gps);
+  }
+
+  /**
+   * Evaluate position; on_enter()/on_exit() are called for fences
+   * whose state changed.
+   * @param[in] latitude in millionths of a degree
+   * @param[in] longitude in millionths of a degree
+   */
+  void evaluate(position_t latitude, position_t longitude);
+
+  /**
+   * Is last evaluated position inside given fence?
+   * @param[in] fence number
+   * @return inside
+   */
+  bool inside(uint16_t fence)
+    __attribute__((always_inline))
+  {
+    return ((m_inside[fence >> 3] & _BV(fence & 7)) != 0);
+  }
+
+  /**
+   * Get number of fences
+   * @return fences
+   */
+  uint16_t fences()
+    __attribute__((always_inline))
+  {
+    return (m_fences);
+  }
+
+  /**
+   * Get number of fences tested in last evaluation
+   * @return tested
+   */
+  uint16_t tested()
+    __attribute__((always_inline))
+  {
+    return (m_tested);
+  }
+
+protected:
+  /**
+   * Called when position enters given fence. May be implemented by
+   * subclasses.
+   * @param[in] fence number
+   */
+  virtual void on_enter(uint16_t fence);
+
+  /**
+   * Called when position exits given fence. May be implemented by
+   * subclasses.
+   * @param[in] fence number
+   */
+  virtual void on_exit(uint16_t fence);
+
+  /* Fence storage */
+  fence_t* m_fence;
+  uint16_t m_max_fences;
+  uint16_t m_fences;
+
+  /* Polygon vertex storage */
+  vertex_t* m_vertex;
+  uint16_t m_max_vertices;
+  uint16_t m_vertices;
+
+  /* Inside bitmap, one bit per fence */
+  uint8_t* m_inside;
+
+  /* Grid; m_cell[rows * cols + 1] start offsets into m_entry */
+  uint16_t* m_cells;
+  uint8_t m_rows;
+  uint8_t m_cols;
+  uint16_t* m_entry;
+  uint16_t m_max_entries;
+
+  /* Grid origin (south-west) and cell size in millionths of a degree */
+  position_t m_origin_latitude;
+  position_t m_origin_longitude;
+  uint32_t m_cell_height;
+  uint32_t m_cell_width;
+
+  /* Cell of last evaluated position */
+  uint16_t m_cell;
+
+  /* Fences tested in last evaluation */
+  uint16_t m_tested;
+
+  /* Get fence bounding box in millionths of a degree */
+  void bounds(fence_t* fence,
+              position_t& south, position_t& west,
+              position_t& north, position_t& east);
+
+  /* Get cell for position, NONE if outside grid */
+  uint16_t cell(position_t latitude, position_t longitude);
+
+  /* Test position against fence */
+  bool contains(fence_t* fence, position_t latitude, position_t longitude);
+
+  /* Test fences in cell and raise events on change */
+  void test(uint16_t cell, position_t latitude, position_t longitude,
+            bool only_inside);
+};
+
+/**
+ * GPS Geofence with static storage.
+ * @param[in] FENCES max number of fences
+ * @param[in] VERTICES max number of polygon vertices (all polygons)
+ * @param[in] ROWS grid rows (latitude)
+ * @param[in] COLS grid columns (longitude)
+ * @param[in] ENTRIES max number of fence references in grid
+ */
+template<uint16_t FENCES, uint16_t VERTICES,
+         uint8_t ROWS, uint8_t COLS, uint16_t ENTRIES>
+class GPS_Geofences : public GPS_Geofence {
+public:
+  GPS_Geofences() :
+    GPS_Geofence(m_fence_buf, FENCES, m_vertex_buf, VERTICES, m_inside_buf,
+                 m_cells_buf, ROWS, COLS, m_entry_buf, ENTRIES)
+  {}
+
+private:
+  fence_t m_fence_buf[FENCES];
+  vertex_t m_vertex_buf[VERTICES > 0 ? VERTICES : 1];
+  uint8_t m_inside_buf[(FENCES + 7) / 8];
+  uint16_t m_cells_buf[ROWS * COLS + 1];
+  uint16_t m_entry_buf[ENTRIES];
+};
+#endif
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @file ?/GPS_Kalman.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Kalman.hh"
+#include "GPS_Track.hh"
+
+#ifndef GPS_TIME_ONLY
+
+/* Q8 velocity in millionths of a degree per second per 100th of a knot,
+ * 11.831 (a millionth of a degree of latitude is 0.1113m) */
+#define VELOCITY(speed) (((int32_t) (speed) * 12115L) / 1024)
+
+/* Q8 variance of velocity measurement, (1 millionth of a degree/s)^2 */
+#define VELOCITY_NOISE 256
+
+/* Largest innovation before the filter restarts; Q8 */
+#define INNOVATION_MAX (1L << 24)
+
+void
+GPS_Kalman::on_fix(GPS& gps)
+{
+  GPS::fix_t fix;
+
+
+  gps.get(fix);
+  update(fix);
+}
+
+void
+GPS_Kalman::measure(const GPS::fix_t& fix, int64_t r[3], int32_t v[2])
+{
+  int32_t hdop = (fix.hdop < 50 ? 50 : fix.hdop);
+  int32_t speed = VELOCITY(fix.speed);
+
+
+  /* User range error 5m horizontal, 7.5m vertical, scaled by hdop */
+  r[NORTH] = (int64_t) hdop * hdop * 52;
+  r[EAST] = (r[NORTH] << 30) / ((int32_t) m_cos * m_cos);
+  r[UP] = (int64_t) hdop * hdop * 14400;
+
+  v[NORTH] = ((int64_t) speed * GPS::cos_course(fix.course)) / 32768;
+  v[EAST] = ((int64_t) speed * GPS::cos_course(fix.course - 9000)) / m_cos;
+}
+
+void
+GPS_Kalman::start(const GPS::fix_t& fix)
+{
+  int64_t r[3];
+  int32_t v[2];
+
+
+  m_cos = GPS::cos_latitude(fix.latitude);
+  if (m_cos < 64)
+    m_cos = 64;
+  measure(fix, r, v);
+
+  m_axis[NORTH].x = (int64_t) fix.latitude * 256;
+  m_axis[EAST].x = (int64_t) fix.longitude * 256;
+  m_axis[UP].x = (int64_t) fix.altitude * 256;
+  for (uint8_t i = NORTH; i <= UP; i++)
+    {
+      m_axis[i].p00 = r[i];
+      m_axis[i].p01 = 0;
+    }
+  m_axis[NORTH].v = v[NORTH];
+  m_axis[NORTH].p11 = VELOCITY_NOISE;
+  m_axis[EAST].v = v[EAST];
+  m_axis[EAST].p11 = (VELOCITY_NOISE * (1LL << 30)) / ((int32_t) m_cos * m_cos);
+  m_axis[UP].v = 0;
+  m_axis[UP].p11 = 100L * 100L * 256;
+
+  m_valid = true;
+}
+
+void
+GPS_Kalman::update(const GPS::fix_t& fix)
+{
+  uint32_t ms = GPS_Track::time_to_millis(fix.time);
+  uint32_t dt = ms - m_ms;
+  int64_t r[3];
+  int32_t v[2];
+  int64_t q;
+
+
+  if (fix.satellites == 0)
+    return;
+
+  /* Restart after a gap, a day change or a time step backwards */
+  if (!m_valid || fix.date != m_fix.date || dt > GPS_KALMAN_GAP)
+    {
+      m_ms = ms;
+      m_fix = fix;
+      start(fix);
+      return;
+    }
+  m_ms = ms;
+  m_fix = fix;
+
+  m_cos = GPS::cos_latitude(fix.latitude);
+  if (m_cos < 64)
+    m_cos = 64;
+  measure(fix, r, v);
+
+  /* Q8 acceleration variance; horizontal in millionths of a degree */
+  q = (int64_t) m_acceleration * m_acceleration * 256;
+  if (dt != 0)
+    {
+      predict(m_axis[NORTH], dt, (q * 8464) >> 20);
+      predict(m_axis[EAST], dt, ((q * 8464) >> 20) * (1LL << 30) /
+              ((int32_t) m_cos * m_cos));
+      predict(m_axis[UP], dt, q);
+    }
+
+  for (uint8_t i = NORTH; i <= UP; i++)
+    {
+      int32_t z = (i == NORTH ? fix.latitude :
+                   i == EAST ? fix.longitude :
+                   fix.altitude);
+      int64_t y = (int64_t) z * 256 - m_axis[i].x;
+
+      if (y > INNOVATION_MAX || y < -INNOVATION_MAX)
+        {
+          start(fix);
+          return;
+        }
+      position(m_axis[i], z, r[i]);
+    }
+
+  velocity(m_axis[NORTH], v[NORTH], VELOCITY_NOISE);
+  velocity(m_axis[EAST], v[EAST],
+           (VELOCITY_NOISE * (1LL << 30)) / ((int32_t) m_cos * m_cos));
+}
+
+void
+GPS_Kalman::predict(axis_t& axis, uint32_t dt, int64_t q)
+{
+  int64_t t2 = (int64_t) dt * dt;
+  int64_t qt2 = q * t2 / 1000000;
+
+
+  /* Discrete white noise acceleration; dt in milliseconds */
+  axis.x += (int64_t) axis.v * dt / 1000;
+  axis.p00 += (2 * axis.p01 * dt + axis.p11 * t2 / 1000) / 1000 +
+    qt2 * t2 / 4000000;
+  axis.p01 += axis.p11 * dt / 1000 + qt2 * dt / 2000;
+  axis.p11 += qt2;
+}
+
+void
+GPS_Kalman::position(axis_t& axis, int32_t z, int64_t r)
+{
+  int64_t s = axis.p00 + r;
+  int64_t y = (int64_t) z * 256 - axis.x;
+
+
+  axis.x += axis.p00 * y / s;
+  axis.v += axis.p01 * y / s;
+  axis.p11 -= axis.p01 * axis.p01 / s;
+  axis.p01 = axis.p01 * r / s;
+  axis.p00 = axis.p00 * r / s;
+}
+
+void
+GPS_Kalman::velocity(axis_t& axis, int32_t z, int64_t r)
+{
+  int64_t s = axis.p11 + r;
+  int64_t y = z - axis.v;
+
+
+  axis.x += axis.p01 * y / s;
+  axis.v += axis.p11 * y / s;
+  axis.p00 -= axis.p01 * axis.p01 / s;
+  axis.p01 = axis.p01 * r / s;
+  axis.p11 = axis.p11 * r / s;
+}
+
+/* Integer square root */
+static uint32_t
+isqrt(uint64_t x)
+{
+  uint64_t bit = 1ULL << 62;
+  uint64_t res = 0;
+
+
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0)
+    {
+      if (x >= res + bit)
+        {
+          x -= res + bit;
+          res = (res >> 1) + bit;
+        }
+      else
+        res >>= 1;
+      bit >>= 2;
+    }
+
+  return (res);
+}
+
+GPS_Kalman::speed_t
+GPS_Kalman::speed()
+{
+  int64_t north = m_axis[NORTH].v;
+  int64_t east = ((int64_t) m_axis[EAST].v * m_cos) / 32768;
+
+
+  return ((isqrt(north * north + east * east) * 1024) / 12115);
+}
+
+GPS_Kalman::course_t
+GPS_Kalman::course()
+{
+  int32_t north = m_axis[NORTH].v;
+  int32_t east = ((int64_t) m_axis[EAST].v * m_cos) / 32768;
+  uint32_t y = (east < 0 ? -east : east);
+  uint32_t x = (north < 0 ? -north : north);
+  uint32_t a;
+  int32_t r;
+
+
+  if (x == 0 && y == 0)
+    return (0);
+
+  /* atan(r) ~ 45r + 15.6r(1 - r) degrees for r in 0..1, Q15 */
+  if (y <= x)
+    {
+      r = ((uint64_t) y << 15) / x;
+      a = (4500L * r + ((1564L * r) >> 15) * (32768 - r)) >> 15;
+    }
+  else
+    {
+      r = ((uint64_t) x << 15) / y;
+      a = 9000 - ((4500L * r + ((1564L * r) >> 15) * (32768 - r)) >> 15);
+    }
+
+  /* Quadrant; course is clockwise from north */
+  if (north < 0)
+    a = 18000 - a;
+  if (east < 0)
+    a = (36000 - a) % 36000;
+
+  return (a);
+}
+
+void
+GPS_Kalman::get(GPS::fix_t& fix)
+{
+  fix = m_fix;
+  fix.latitude = latitude();
+  fix.longitude = longitude();
+  fix.altitude = altitude();
+  fix.speed = speed();
+  fix.course = course();
+}
+#endif
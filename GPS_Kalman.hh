@@ -0,0 +1,178 @@
+/**
+ * @file ?/GPS_Kalman.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_KALMAN_HH
+#define COSA_GPS_KALMAN_HH
+
+#include "GPS.hh"
+
+#ifndef GPS_TIME_ONLY
+
+/* Gap in milliseconds after which the filter restarts from the fix */
+#define GPS_KALMAN_GAP 2000
+
+/**
+ * GPS Kalman
+ *
+ * Constant velocity Kalman filter over committed fixes. Latitude,
+ * longitude and altitude are filtered as independent axes with state
+ * position and velocity; positions are measured with noise from hdop,
+ * and horizontal velocity from speed and course. Attach to a GPS and
+ * read the smoothed fix beside the raw one.
+ *
+ * State and covariance are fixed point (Q8) with 64-bit intermediates.
+ * An update is three axes of a prediction and one or two scalar
+ * measurement updates, about 25 64-bit divisions; this is well within
+ * the 1.6M cycles of a 10 Hz epoch on a 16 MHz AVR.
+ */
+
+class GPS_Kalman : public GPS::Listener {
+public:
+  typedef GPS::position_t position_t;
+  typedef GPS::altitude_t altitude_t;
+  typedef GPS::course_t course_t;
+  typedef GPS::speed_t speed_t;
+
+  /**
+   * Construct filter.
+   * @param[in] acceleration expected in cm/s^2 (process noise)
+   */
+  GPS_Kalman(uint16_t acceleration = 100) :
+    GPS::Listener(),
+    m_acceleration(acceleration),
+    m_valid(false)
+  {}
+
+  /**
+   * @override GPS::Listener
+   * Filter committed fix.
+   * @param[in] gps
+   */
+  virtual void on_fix(GPS& gps);
+
+  /**
+   * Filter fix.
+   * @param[in] fix
+   */
+  void update(const GPS::fix_t& fix);
+
+  /**
+   * Restart filter from next fix.
+   */
+  void reset()
+    __attribute__((always_inline))
+  {
+    m_valid = false;
+  }
+
+  /**
+   * Is filter state valid?
+   * @return valid
+   */
+  bool valid()
+    __attribute__((always_inline))
+  {
+    return (m_valid);
+  }
+
+  /**
+   * Get smoothed latitude
+   * @return latitude in millionths of a degree
+   */
+  position_t latitude()
+    __attribute__((always_inline))
+  {
+    return (m_axis[NORTH].x / 256);
+  }
+
+  /**
+   * Get smoothed longitude
+   * @return longitude in millionths of a degree
+   */
+  position_t longitude()
+    __attribute__((always_inline))
+  {
+    return (m_axis[EAST].x / 256);
+  }
+
+  /**
+   * Get smoothed altitude
+   * @return altitude in centimeters
+   */
+  altitude_t altitude()
+    __attribute__((always_inline))
+  {
+    return (m_axis[UP].x / 256);
+  }
+
+  /**
+   * Get smoothed speed
+   * @return speed in 100ths of a knot
+   */
+  speed_t speed();
+
+  /**
+   * Get smoothed course
+   * @return course in 100ths of a degree
+   */
+  course_t course();
+
+  /**
+   * Get smoothed fix; date, time, satellites and hdop are those of the
+   * latest fix.
+   * @param[out] fix
+   */
+  void get(GPS::fix_t& fix);
+
+protected:
+  /* Axis state; Q8 position, velocity per second and covariance */
+  struct axis_t {
+    int64_t x;
+    int32_t v;
+    int64_t p00;
+    int64_t p01;
+    int64_t p11;
+  };
+
+  enum { NORTH, EAST, UP };
+
+  axis_t m_axis[3];
+  uint16_t m_acceleration;
+  uint16_t m_cos;
+  uint32_t m_ms;
+  GPS::fix_t m_fix;
+  bool m_valid;
+
+  /* Start filter from fix */
+  void start(const GPS::fix_t& fix);
+
+  /* Measurements of fix; position noise, horizontal velocity Q8 */
+  void measure(const GPS::fix_t& fix, int64_t r[3], int32_t v[2]);
+
+  /* Axis prediction over dt milliseconds with acceleration noise q */
+  static void predict(axis_t& axis, uint32_t dt, int64_t q);
+
+  /* Axis position measurement z with noise r */
+  static void position(axis_t& axis, int32_t z, int64_t r);
+
+  /* Axis velocity measurement z with noise r */
+  static void velocity(axis_t& axis, int32_t z, int64_t r);
+};
+#endif
+#endif
@@ -17,7 +17,6 @@
  *
  */
 
-#include <ctype.h>
 #include "Cosa/RTT.hh"
 #include "Cosa/Trace.hh"
 
@@ -29,9 +28,27 @@
  * needed to provide all the data exposed by the base class GPS.  Sentences
  * may arrive in any order requiring that data is temporarily accumulated
  * here until all sentences needed for an update to GPS have arrived.
- * We know we have associated sentences when the time fields match.
+ *
+ * Sentences are assembled into epochs keyed by UTC time. A sentence with
+ * a time field ($GPRMC, $GPGGA) starts a new epoch when its time differs
+ * from the current one; sentences without time ($GPGSA, $GPGSV) belong
+ * to the current epoch. The epoch is committed as soon as all required
+ * sentences have arrived. An epoch that is replaced or is older than
+ * GPS_NMEA_EPOCH_TIMEOUT without completing is counted as timed out.
+ * A complete epoch is checked against the commit gate (see gate()) and
+ * rejected epochs are counted and kept for diagnostics.
+ *
+ * With baud rate detection enabled (see detect()) received characters
+ * are counted in windows of GPS_NMEA_BAUD_WINDOW. A window with garbage
+ * and no valid sentence means the receiver is at another rate; the
+ * candidate rates are then tried, a window each, until one is clean.
  */
 
+/* Baud rate candidates, most likely first */
+static const uint32_t BAUDRATES[] __PROGMEM = {
+  9600, 115200, 57600, 38400, 19200, 4800
+};
+
 GPS_NMEA::GPS_NMEA(IOStream::Device *device) :
   GPS(),
   m_active(false),
@@ -41,21 +58,55 @@ GPS_NMEA::GPS_NMEA(IOStream::Device *device) :
   m_field_number(0),
   m_field_offset(0),
   m_checksum_field(false),
+  m_field_value(0),
+  m_field_places(-1),
+  m_field_negative(false),
+  m_baud_configured(0),
+  m_baud_rate(0),
+  m_baud_state(BAUD_OFF),
+  m_baud_index(0),
+  m_baud_chars(0),
+  m_baud_errors(0),
+  m_baud_valid(0),
+  m_baud_resyncs(0),
+  m_baud_lost(0),
+  m_baud_recovery(0),
+  m_epoch_required(EPOCH_DEFAULT),
+  m_epoch_sentences(0),
+  m_epoch_time(0),
+  m_epoch_start(0),
+  m_epoch_timeouts(0),
+  m_begin(0),
+  m_ttff(0),
+  m_ttff_measured(false),
+  m_commits(0),
   m_tmp_date(0),
-  m_tmp_gprmc_time(0)
+  m_tmp_time(0)
 #ifndef GPS_TIME_ONLY
   ,
-  m_tmp_gpgga_time(1),
   m_tmp_latitude(0),
   m_tmp_longitude(0),
   m_tmp_altitude(0),
   m_tmp_course(0),
   m_tmp_speed(0),
   m_tmp_satellites(0),
-  m_tmp_hdop(0)
+  m_tmp_hdop(0),
+  m_gate_speed(0),
+  m_gate_hdop(0),
+  m_gate_gap(GPS_NMEA_GATE_GAP),
+  m_rejects(0),
+  m_reject(REJECT_NONE),
+  m_gate_run(0),
+  m_gate_run_time(0)
 #endif
 {
   m_device = device;
+#ifdef GPS_SATELLITE_TABLE
+  memset(m_satellite_table, 0, sizeof(m_satellite_table));
+  m_satellite_front = 0;
+  m_gsv_next = 0;
+  m_gsa_valid = false;
+#endif
 }
 
 bool
@@ -65,10 +116,24 @@ GPS_NMEA::begin()
     return (false);
 
   m_active = true;
+  ttff_restart();
 
   return (true);
 }
 
+void
+GPS_NMEA::ttff_restart()
+{
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+  {
+    m_begin = RTT::millis();
+    m_ttff = 0;
+    m_ttff_measured = false;
+  }
+}
+
 void
 GPS_NMEA::end()
 {
@@ -90,10 +155,10 @@ GPS_NMEA::reset(void)
   m_field_number = 0;
   m_field_offset = 0;
   m_checksum_field = false;
+  m_epoch_sentences = 0;
   m_tmp_date = 0;
-  m_tmp_gprmc_time = 0;
+  m_tmp_time = 0;
 #ifndef GPS_TIME_ONLY
-  m_tmp_gpgga_time = 1;
   m_tmp_latitude = 0;
   m_tmp_longitude = 0;
   m_tmp_altitude = 0;
@@ -101,6 +166,12 @@ GPS_NMEA::reset(void)
   m_tmp_speed = 0;
   m_tmp_satellites = 0;
   m_tmp_hdop = 0;
+  m_gate_run = 0;
+#endif
+#ifdef GPS_SATELLITE_TABLE
+  memset(m_satellite_table, 0, sizeof(m_satellite_table));
+  m_gsv_next = 0;
+  m_gsa_valid = false;
 #endif
 
   GPS::reset();
@@ -118,32 +189,168 @@ GPS_NMEA::end_tracing()
   m_tracing = false;
 }
 
-#ifndef GPS_INTERRUPT_IMPL
 void
-GPS_NMEA::consume(void)
+GPS_NMEA::detect(uint32_t rate)
 {
-  while (m_device->available())
-    feedchar(m_device->getchar());
-}
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
 #endif
+  {
+    m_baud_configured = rate;
+    m_baud_rate = rate;
+    m_baud_state = (rate == 0 ? BAUD_OFF : BAUD_LOCKED);
+    m_baud_chars = 0;
+    m_baud_errors = 0;
+    m_baud_valid = 0;
+  }
+}
 
-#ifdef GPS_INTERRUPT_IMPL
-int
-GPS_NMEA::putchar(char c)
-#else
 void
-GPS_NMEA::feedchar(char c)
+GPS_NMEA::resync()
+{
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
 #endif
+  {
+    m_sentence = SENTENCE_INVALID;
+    m_epoch_sentences = 0;
+    if (m_baud_state == BAUD_LOCKED)
+      {
+        m_baud_resyncs++;
+        m_baud_lost = RTT::millis();
+        m_baud_state = BAUD_HUNTING;
+        m_baud_index = 0;
+        m_baud_chars = 0;
+        m_baud_errors = 0;
+        m_baud_valid = 0;
+      }
+  }
+}
+
+bool
+GPS_NMEA::device_baudrate(uint32_t rate)
+{
+  UNUSED(rate);
+
+  /* Must be implemented for baud rate detection */
+  return (false);
+}
+
+bool
+GPS_NMEA::receiver_baudrate(uint32_t rate)
+{
+  UNUSED(rate);
+
+  /* May be implemented by subclasses */
+  return (false);
+}
+
+void
+GPS_NMEA::baud_switch(uint32_t rate)
+{
+  device_baudrate(rate);
+  m_baud_rate = rate;
+  m_baud_chars = 0;
+  m_baud_errors = 0;
+  m_baud_valid = 0;
+
+  /* Drop partial sentence */
+  m_sentence = SENTENCE_INVALID;
+}
+
+void
+GPS_NMEA::baud_locked()
+{
+  /* Switch receiver back to the configured rate, once */
+  if (m_baud_state == BAUD_HUNTING &&
+      m_baud_rate != m_baud_configured &&
+      receiver_baudrate(m_baud_configured))
+    {
+      m_baud_state = BAUD_RESTORING;
+      baud_switch(m_baud_configured);
+      return;
+    }
+
+  m_baud_state = BAUD_LOCKED;
+  m_baud_recovery = RTT::since(m_baud_lost);
+  m_baud_chars = 0;
+  m_baud_errors = 0;
+  m_baud_valid = 0;
+}
+
+void
+GPS_NMEA::baud_window()
+{
+  bool clean = (m_baud_valid > 0 || m_baud_errors == 0);
+  uint32_t rate;
+
+
+  switch (m_baud_state)
+    {
+    case BAUD_LOCKED:
+      if (m_baud_valid > 0 || m_baud_errors < GPS_NMEA_BAUD_ERRORS)
+        {
+          m_baud_chars = 0;
+          m_baud_errors = 0;
+          m_baud_valid = 0;
+          return;
+        }
+      m_baud_resyncs++;
+      m_baud_lost = RTT::millis();
+      m_baud_state = BAUD_HUNTING;
+      m_baud_index = 0;
+      break;
+
+    case BAUD_RESTORING:
+      /* Receiver did not follow; search again and stay where found.
+       * Sentences buffered at the previous rate may still be valid so
+       * any garbage fails */
+      if (m_baud_errors > 0)
+        {
+          m_baud_state = BAUD_SEARCHING;
+          break;
+        }
+      baud_locked();
+      return;
+
+    default:
+      if (clean)
+        {
+          baud_locked();
+          return;
+        }
+      break;
+    }
+
+  /* Next candidate, skipping the rate just tried */
+  do
+    {
+      rate = pgm_read_dword(&BAUDRATES[m_baud_index]);
+      if (++m_baud_index == membersof(BAUDRATES))
+        m_baud_index = 0;
+    } while (rate == m_baud_rate);
+  baud_switch(rate);
+}
+
+inline void
+GPS_NMEA::parse(char c)
 {
-  if (c != '\r' && c != '\n' && (c < ' ' || c > '~'))
+  bool garbage = (c != '\r' && c != '\n' && (c < ' ' || c > '~'));
+
+
+  if (m_baud_state != BAUD_OFF)
+    {
+      if (garbage)
+        m_baud_errors++;
+      if (++m_baud_chars == GPS_NMEA_BAUD_WINDOW)
+        baud_window();
+    }
+
+  if (garbage)
     {
       if (m_tracing)
         trace << PSTR("_");
-#ifdef GPS_INTERRUPT_IMPL
-      return (c);
-#else
       return;
-#endif
     }
 
   if (m_tracing)
@@ -165,8 +372,8 @@ GPS_NMEA::feedchar(char c)
           m_sentence = SENTENCE_OTHER;  // unknown at this point
           m_parity = 0;
           m_field_number = 0;
-          m_field_offset = 0;
           m_checksum_field = false;
+          next_field();
           break;
 
         case ',':
@@ -175,8 +382,8 @@ GPS_NMEA::feedchar(char c)
           m_field[m_field_offset] = '\0';
           process_field();
           m_field_number++;
-          m_field_offset = 0;
           m_checksum_field = c == '*';
+          next_field();
           break;
 
         case '\r':
@@ -189,8 +396,30 @@ GPS_NMEA::feedchar(char c)
           break;
 
         default:
-          if (!m_checksum_field)
-            m_parity ^= c;
+          /* Decode numeric value as received; hex in checksum */
+          if (m_checksum_field)
+            m_field_value = (m_field_value << 4) |
+              ((c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10) & 0xf);
+          else
+            {
+              m_parity ^= c;
+              if (c >= '0' && c <= '9')
+                {
+                  if (m_field_places < GPS_NMEA_FIELD_PLACES)
+                    {
+                      m_field_value = m_field_value * 10 + (c - '0');
+                      if (m_field_places >= 0)
+                        m_field_places++;
+                    }
+                }
+              else if (c == '.')
+                {
+                  if (m_field_places < 0)
+                    m_field_places = 0;
+                }
+              else if (c == '-')
+                m_field_negative = true;
+            }
 
           if (m_field_offset < sizeof(m_field) - 1)
             m_field[m_field_offset++] = c;
@@ -202,27 +431,71 @@ GPS_NMEA::feedchar(char c)
             }
         }
     }
+}
 
-#ifdef GPS_INTERRUPT_IMPL
+#ifndef GPS_INTERRUPT_IMPL
+void
+GPS_NMEA::consume(void)
+{
+  while (consume(0xffff) == 0xffff)
+    ;
+}
+
+uint16_t
+GPS_NMEA::consume(uint16_t budget)
+{
+  char buf[GPS_NMEA_BLOCK];
+  uint16_t count = 0;
+  int n;
+
+
+  /* Read in blocks; parse without a call per character */
+  while (count < budget)
+    {
+      n = budget - count;
+      if (n > (int) sizeof(buf))
+        n = sizeof(buf);
+      n = m_device->read(buf, n);
+      if (n <= 0)
+        break;
+      feed(buf, n);
+      count += n;
+    }
+
+  return (count);
+}
+
+void
+GPS_NMEA::feedchar(char c)
+{
+  parse(c);
+}
+
+void
+GPS_NMEA::feed(const char* buf, size_t size)
+{
+  while (size-- > 0)
+    parse(*buf++);
+}
+#else
+int
+GPS_NMEA::putchar(char c)
+{
+  parse(c);
   return (c);
-#endif
 }
+#endif
 
 #ifndef GPS_TIME_ONLY
 GPS_NMEA::position_t
-GPS_NMEA::parse_position(char *p)
+GPS_NMEA::degrees(uint32_t scaled)
 {
   position_t result;
-  uint32_t scaled;
   uint32_t hundred_thousandths_of_minutes;
 
 
   /* Result is millionths of a degree */
 
-  /* DDMM.MMMMM */
-
-  scaled = parse_and_scale(p, 5);
-
   /* DDMMMMMMM */
 
   /* Get minutes */
@@ -239,33 +512,18 @@ GPS_NMEA::parse_position(char *p)
 #endif
 
 int32_t
-GPS_NMEA::parse_and_scale(char *p, uint8_t places)
+GPS_NMEA::field_value(uint8_t places)
 {
-  uint32_t result = 0;
-  bool negative;
-
-
-  while (*p && (*p == ' ' || *p == '\t'))
-    p++;
-
-  negative = (*p == '-');
-  if (negative)
-    p++;
-
-  while (isdigit(*p))
-    result = (result * 10) + (*(p++) - '0');
+  uint32_t result = m_field_value;
+  int8_t have = (m_field_places < 0 ? 0 : m_field_places);
 
-  if (*p == '.')
-    p++;
 
-  while (places--)
-    {
-      result *= 10;
-      if (isdigit(*p))
-        result += (*(p++) - '0');
-    }
+  for (; have < places; have++)
+    result *= 10;
+  for (; have > places; have--)
+    result /= 10;
 
-  if (negative)
+  if (m_field_negative)
     result = -result;
 
   return result;
@@ -308,6 +566,13 @@ GPS_NMEA::process_field()
           if (!strcmp((char*)m_field, "GPGGA"))
             m_sentence = SENTENCE_GPGGA;
           else
+#endif
+#ifdef GPS_SATELLITE_TABLE
+          if (!strcmp((char*)m_field, "GPGSA"))
+            m_sentence = SENTENCE_GPGSA;
+          else if (!strcmp((char*)m_field, "GPGSV"))
+            m_sentence = SENTENCE_GPGSV;
+          else
 #endif
             field(m_field_number, (char*)m_field);  // Subclasses may implement other sentences
         }
@@ -320,17 +585,18 @@ GPS_NMEA::process_field()
       switch (m_field_number)
         {
         case 1:  // Time
-          m_tmp_gprmc_time = parse_and_scale((char*)m_field, 3);
+          m_tmp_time = field_value(3);
           break;
 
         case 2: // Validity
+          /* No fix; still framed, as a sentence without data */
           if (m_field[0] != 'A')
-            m_sentence = SENTENCE_INVALID;
+            m_sentence = SENTENCE_OTHER;
           break;
 
         case 3: // Latitude
 #ifndef GPS_TIME_ONLY
-          m_tmp_latitude = parse_position((char*)m_field);
+          m_tmp_latitude = degrees(field_value(5));
 #endif
           break;
 
@@ -343,7 +609,7 @@ GPS_NMEA::process_field()
 
         case 5: // Longitude
 #ifndef GPS_TIME_ONLY
-          m_tmp_longitude = parse_position((char*)m_field);
+          m_tmp_longitude = degrees(field_value(5));
 #endif
           break;
 
@@ -356,18 +622,18 @@ GPS_NMEA::process_field()
 
         case 7: // Speed
 #ifndef GPS_TIME_ONLY
-          m_tmp_speed = parse_and_scale((char*)m_field, 2);
+          m_tmp_speed = field_value(2);
 #endif
           break;
 
         case 8: // Course
 #ifndef GPS_TIME_ONLY
-          m_tmp_course = parse_and_scale((char*)m_field, 2);
+          m_tmp_course = field_value(2);
 #endif
           break;
 
         case 9: // Date
-          m_tmp_date = strtoul((char*)m_field, NULL, 10);
+          m_tmp_date = field_value();
           break;
 
         case 10: // magnetic variation
@@ -388,11 +654,11 @@ GPS_NMEA::process_field()
       switch (m_field_number)
         {
         case 1:  // Time
-          m_tmp_gpgga_time = parse_and_scale((char*)m_field, 3);
+          m_tmp_time = field_value(3);
           break;
 
         case 2: // Latitude
-          m_tmp_latitude = parse_position((char*)m_field);
+          m_tmp_latitude = degrees(field_value(5));
           break;
 
         case 3: // North/South
@@ -401,7 +667,7 @@ GPS_NMEA::process_field()
           break;
 
         case 4: // Longitude
-          m_tmp_longitude = parse_position((char*)m_field);
+          m_tmp_longitude = degrees(field_value(5));
           break;
 
         case 5: // East/West
@@ -411,19 +677,19 @@ GPS_NMEA::process_field()
 
         case 6: // Fix valid?
           if (m_field[0] == '0')
-            m_sentence = SENTENCE_INVALID;
+            m_sentence = SENTENCE_OTHER;
           break;
 
         case 7: // Satellites
-          m_tmp_satellites = strtoul((char*)m_field, NULL, 10);
+          m_tmp_satellites = field_value();
           break;
 
         case 8: // HDOP
-          m_tmp_hdop = parse_and_scale((char*)m_field, 2);
+          m_tmp_hdop = field_value(2);
           break;
 
         case 9: // Altitude
-          m_tmp_altitude = parse_and_scale((char*)m_field, 2);
+          m_tmp_altitude = field_value(2);
           break;
 
         case 10: // Altitude units
@@ -437,6 +703,14 @@ GPS_NMEA::process_field()
           m_sentence = SENTENCE_INVALID;
           break;
         }
+      break;
+#endif
+
+#ifdef GPS_SATELLITE_TABLE
+    case SENTENCE_GPGSA:
+    case SENTENCE_GPGSV:
+      process_satellite_field();
+      break;
 #endif
 
     default:
@@ -454,36 +728,430 @@ GPS_NMEA::process_sentence()
 
 
   /* Last field is the checksum */
-  checksum = strtoul((char*)m_field, NULL, 16);
+  checksum = m_field_value;
 
-  if (checksum == m_parity)
+  if (m_checksum_field && checksum == m_parity)
     {
-#ifdef GPS_TIME_ONLY
-      if (m_sentence == SENTENCE_GPRMC)
-#else
-      if (m_tmp_gprmc_time == m_tmp_gpgga_time &&
-          m_tmp_satellites >= GPS_MINIMUM_SATELLITES)
-#endif
+      if (m_baud_state != BAUD_OFF)
+        m_baud_valid++;
+
+      switch (m_sentence)
         {
-          m_date = m_tmp_date;
-          m_time = m_tmp_gprmc_time;
+        case SENTENCE_GPRMC:
+#ifndef GPS_TIME_ONLY
+          /* Publish time without waiting for the position */
+          m_early_date = m_tmp_date;
+          m_early_time = m_tmp_time;
+          m_last_time_update = RTT::millis();
+#endif
+          epoch(EPOCH_RMC, true);
+          break;
+
 #ifndef GPS_TIME_ONLY
-          m_latitude = m_tmp_latitude;
-          m_longitude = m_tmp_longitude;
-          m_altitude = m_tmp_altitude;
-          m_course = m_tmp_course;
-          m_speed = m_tmp_speed;
-          m_satellites = m_tmp_satellites;
-          m_hdop = m_tmp_hdop;
+        case SENTENCE_GPGGA:
+          epoch(EPOCH_GGA, true);
+          break;
 #endif
-          m_last_update = RTT::millis();
 
-          m_tmp_gprmc_time = 0;
+#ifdef GPS_SATELLITE_TABLE
+        case SENTENCE_GPGSA:
+          m_gsa_valid = true;
+          epoch(EPOCH_GSA, false);
+          break;
+
+        case SENTENCE_GPGSV:
+          if (m_gsv_next == 0)
+            break;
+          if (m_gsv_message == m_gsv_total)
+            {
+              publish_satellite_table();
+              epoch(EPOCH_GSV, false);
+            }
+          else
+            m_gsv_next++;
+          break;
+#endif
+
+        default:
+          break;
         }
 
       /* Subclass may implement sentence() to handle other sentences */
       sentence(true);
     }
   else
-    sentence(false);
+    {
+      if (m_baud_state != BAUD_OFF)
+        m_baud_errors++;
+
+#ifdef GPS_SATELLITE_TABLE
+      /* Drop partial sequence */
+      if (m_sentence == SENTENCE_GPGSV)
+        m_gsv_next = 0;
+      else if (m_sentence == SENTENCE_GPGSA)
+        m_gsa_valid = false;
+#endif
+      sentence(false);
+    }
 }
+
+void
+GPS_NMEA::epoch(uint8_t sentence, bool timed)
+{
+  uint32_t now = RTT::millis();
+#ifndef GPS_TIME_ONLY
+  uint8_t reason;
+#endif
+
+
+  /* Close current epoch if replaced by a new time or too old */
+  if (m_epoch_sentences != 0 &&
+      ((timed && m_tmp_time != m_epoch_time) ||
+       (now - m_epoch_start) > GPS_NMEA_EPOCH_TIMEOUT))
+    {
+      if ((m_epoch_sentences & m_epoch_required) != m_epoch_required)
+        m_epoch_timeouts++;
+      m_epoch_sentences = 0;
+    }
+
+  if (m_epoch_sentences == 0)
+    {
+      /* Sentence without time can't start an epoch */
+      if (!timed)
+        return;
+      m_epoch_time = m_tmp_time;
+      m_epoch_start = now;
+    }
+
+  m_epoch_sentences |= sentence;
+
+  if ((m_epoch_sentences & EPOCH_COMMITTED) ||
+      (m_epoch_sentences & m_epoch_required) != m_epoch_required)
+    return;
+
+  m_epoch_sentences |= EPOCH_COMMITTED;
+
+#ifndef GPS_TIME_ONLY
+  reason = gate();
+  if (reason != REJECT_NONE)
+    {
+      reject(reason);
+      return;
+    }
+#endif
+
+  commit();
+}
+
+#ifndef GPS_TIME_ONLY
+uint8_t
+GPS_NMEA::gate()
+{
+  uint32_t now = RTT::millis();
+  uint32_t dt;
+
+
+  if (m_epoch_required & EPOCH_GGA)
+    {
+      if (m_tmp_satellites < GPS_MINIMUM_SATELLITES)
+        return (REJECT_SATELLITES);
+      if (m_gate_hdop != 0 && m_tmp_hdop > m_gate_hdop)
+        return (REJECT_HDOP);
+    }
+
+  if (m_gate_speed == 0 || !valid())
+    return (REJECT_NONE);
+  dt = now - m_last_update;
+  if (dt > m_gate_gap || reachable(m_latitude, m_longitude, dt))
+    {
+      m_gate_run = 0;
+      return (REJECT_NONE);
+    }
+
+  /* Rejected epochs that agree with each other outvote the reference,
+   * e.g. after a bad first fix */
+  if (m_gate_run != 0 && m_reject == REJECT_SPEED &&
+      reachable(m_rejected.latitude, m_rejected.longitude,
+                now - m_gate_run_time))
+    m_gate_run++;
+  else
+    m_gate_run = 1;
+  m_gate_run_time = now;
+  if (m_gate_run >= GPS_NMEA_GATE_RESEED)
+    {
+      m_gate_run = 0;
+      return (REJECT_NONE);
+    }
+
+  return (REJECT_SPEED);
+}
+
+bool
+GPS_NMEA::reachable(position_t latitude, position_t longitude, uint32_t dt)
+{
+  uint32_t limit;
+  uint32_t north;
+  uint32_t east;
+  int32_t d;
+
+
+  /* Distance allowed; a 100th of a knot is 1/21640 millionths of a
+   * degree of latitude per millisecond */
+  limit = (m_gate_speed * (dt / 10)) / 2164 + GPS_NMEA_GATE_MARGIN;
+  if (limit > 46000)
+    return (true);
+
+  /* Longitude difference the short way, across the antimeridian */
+  d = m_tmp_longitude - longitude;
+  if (d > 180000000L)
+    d -= 360000000L;
+  else if (d < -180000000L)
+    d += 360000000L;
+
+  north = labs(m_tmp_latitude - latitude);
+  east = labs(d);
+  if (north > limit || east > 0x7fffffffL / 32768)
+    return (false);
+  east = (east * cos_latitude(latitude)) >> 15;
+
+  return (east <= limit && north * north + east * east <= limit * limit);
+}
+
+void
+GPS_NMEA::reject(uint8_t reason)
+{
+  m_rejected.date = m_tmp_date;
+  m_rejected.time = m_epoch_time;
+  m_rejected.latitude = m_tmp_latitude;
+  m_rejected.longitude = m_tmp_longitude;
+  m_rejected.altitude = m_tmp_altitude;
+  m_rejected.course = m_tmp_course;
+  m_rejected.speed = m_tmp_speed;
+  m_rejected.satellites = m_tmp_satellites;
+  m_rejected.hdop = m_tmp_hdop;
+  m_reject = reason;
+  m_rejects++;
+}
+
+uint8_t
+GPS_NMEA::rejected(fix_t& fix)
+{
+  uint8_t reason;
+
+
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+  {
+    fix = m_rejected;
+    reason = m_reject;
+  }
+
+  return (reason);
+}
+#endif
+
+void
+GPS_NMEA::commit()
+{
+  m_date = m_tmp_date;
+  m_time = m_epoch_time;
+#ifndef GPS_TIME_ONLY
+  m_latitude = m_tmp_latitude;
+  m_longitude = m_tmp_longitude;
+  m_altitude = m_tmp_altitude;
+  m_course = m_tmp_course;
+  m_speed = m_tmp_speed;
+  m_satellites = m_tmp_satellites;
+  m_hdop = m_tmp_hdop;
+#endif
+  m_last_update = RTT::millis();
+#ifndef GPS_TIME_ONLY
+  m_last_time_update = m_last_update;
+  m_early_date = m_date;
+  m_early_time = m_time;
+#endif
+  if (!m_ttff_measured)
+    {
+      m_ttff = m_last_update - m_begin;
+      m_ttff_measured = true;
+    }
+  m_commits++;
+
+  notify();
+}
+
+#ifdef GPS_SATELLITE_TABLE
+void
+GPS_NMEA::process_satellite_field()
+{
+  satellite_table_t* back = &m_satellite_table[m_satellite_front ^ 1];
+  uint8_t prn;
+
+
+  if (m_sentence == SENTENCE_GPGSA)
+    {
+      switch (m_field_number)
+        {
+        case 1: // Mode
+          memset(back->used, 0, sizeof(back->used));
+          m_gsa_valid = false;
+          break;
+
+        case 2: // Fix type
+          back->fix = field_value();
+          break;
+
+        case 15: // PDOP
+          back->pdop = field_value(2);
+          break;
+
+        case 16: // HDOP
+          back->hdop = field_value(2);
+          break;
+
+        case 17: // VDOP
+          back->vdop = field_value(2);
+          break;
+
+        default: // PRNs used in fix, fields 3-14
+          if (m_field_number > 17)
+            m_sentence = SENTENCE_INVALID;
+          else
+            {
+              prn = field_value() - 1;
+              if (prn < GPS_NMEA_PRN_MAX)
+                back->used[prn >> 3] |= _BV(prn & 7);
+            }
+          break;
+        }
+      return;
+    }
+
+  /* $GPGSV */
+  switch (m_field_number)
+    {
+    case 1: // Number of messages
+      m_gsv_messages = field_value();
+      break;
+
+    case 2: // Message number
+      m_gsv_message = field_value();
+      if (m_gsv_message == 1)
+        {
+          back->count = 0;
+          memset(back->visible, 0, sizeof(back->visible));
+          m_gsv_total = m_gsv_messages;
+          m_gsv_next = 1;
+        }
+      else if (m_gsv_message != m_gsv_next || m_gsv_messages != m_gsv_total)
+        m_gsv_next = 0;
+      break;
+
+    case 3: // Satellites in view
+      break;
+
+    default: // PRN, elevation, azimuth, SNR per satellite
+      if (m_gsv_next == 0)
+        break;
+
+      switch ((m_field_number - 4) & 3)
+        {
+        case 0:
+          prn = field_value();
+          m_gsv_skip = (prn == 0 || back->count == GPS_NMEA_SATELLITES_MAX);
+          if (m_gsv_skip)
+            break;
+          back->satellite[back->count].prn = prn;
+          back->satellite[back->count].elevation = 0;
+          back->satellite[back->count].used = 0;
+          back->satellite[back->count].azimuth = 0;
+          back->satellite[back->count].snr = 0;
+          back->count++;
+          prn--;
+          if (prn < GPS_NMEA_PRN_MAX)
+            back->visible[prn >> 3] |= _BV(prn & 7);
+          break;
+
+        case 1:
+          if (!m_gsv_skip)
+            back->satellite[back->count - 1].elevation =
+              field_value();
+          break;
+
+        case 2:
+          if (!m_gsv_skip)
+            back->satellite[back->count - 1].azimuth =
+              field_value();
+          break;
+
+        case 3:
+          if (!m_gsv_skip)
+            back->satellite[back->count - 1].snr =
+              field_value();
+          break;
+        }
+      break;
+    }
+}
+
+void
+GPS_NMEA::publish_satellite_table()
+{
+  satellite_table_t* back = &m_satellite_table[m_satellite_front ^ 1];
+
+
+  if (!m_gsa_valid)
+    {
+      memset(back->used, 0, sizeof(back->used));
+      back->fix = 0;
+      back->pdop = 0;
+      back->hdop = 0;
+      back->vdop = 0;
+    }
+
+  for (uint8_t i = 0; i < back->count; i++)
+    back->satellite[i].used = is_set(back->used, back->satellite[i].prn);
+
+  m_satellite_front ^= 1;
+  m_gsv_next = 0;
+  m_gsa_valid = false;
+}
+
+void
+GPS_NMEA::satellite_table(satellite_table_t& table)
+{
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+    table = m_satellite_table[m_satellite_front];
+}
+
+bool
+GPS_NMEA::visible(uint8_t prn)
+{
+  bool res;
+
+
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+    res = is_set(m_satellite_table[m_satellite_front].visible, prn);
+
+  return (res);
+}
+
+bool
+GPS_NMEA::used(uint8_t prn)
+{
+  bool res;
+
+
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+    res = is_set(m_satellite_table[m_satellite_front].used, prn);
+
+  return (res);
+}
+#endif
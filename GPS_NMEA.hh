@@ -24,6 +24,53 @@
 
 #include "GPS.hh"
 
+/*
+ * Sentences parsed by GPS_NMEA as compiled, "1" if parsed. Used to
+ * select receiver output.
+ */
+#define GPS_NMEA_SENTENCE_RMC "1"
+#ifndef GPS_TIME_ONLY
+#define GPS_NMEA_SENTENCE_GGA "1"
+#else
+#define GPS_NMEA_SENTENCE_GGA "0"
+#endif
+#ifdef GPS_SATELLITE_TABLE
+#define GPS_NMEA_SENTENCE_GSA "1"
+#define GPS_NMEA_SENTENCE_GSV "1"
+#else
+#define GPS_NMEA_SENTENCE_GSA "0"
+#define GPS_NMEA_SENTENCE_GSV "0"
+#endif
+
+/* Decimals kept by incremental field decoding */
+#define GPS_NMEA_FIELD_PLACES 5
+
+/* Block size read by consume() */
+#define GPS_NMEA_BLOCK 16
+
+/* Incomplete epoch timeout in milliseconds */
+#define GPS_NMEA_EPOCH_TIMEOUT 1000
+
+/* Commit gate; gap in milliseconds after which speed is not checked,
+ * position noise allowed on top of the speed limit in millionths of a
+ * degree */
+#define GPS_NMEA_GATE_GAP 10000
+#define GPS_NMEA_GATE_MARGIN 90
+
+/* Commit gate; consecutive speed rejected epochs, consistent with each
+ * other, after which the last is committed as new reference */
+#define GPS_NMEA_GATE_RESEED 3
+
+/* Baud rate detection; characters per evaluation window, garbage
+ * characters and failed sentences in a window without valid sentences
+ * that indicate a mismatch */
+#define GPS_NMEA_BAUD_WINDOW 128
+#define GPS_NMEA_BAUD_ERRORS 16
+
+/* Satellite table (GPS_SATELLITE_TABLE) */
+#define GPS_NMEA_SATELLITES_MAX 16
+#define GPS_NMEA_PRN_MAX 96
+
 /**
  * GPS NMEA (generic)
  *
@@ -36,6 +83,33 @@ class GPS_NMEA : public GPS
 #endif
 {
 public:
+  /* Sentences of an epoch */
+  enum {
+    EPOCH_RMC = 0x01,
+#ifndef GPS_TIME_ONLY
+    EPOCH_GGA = 0x02,
+#endif
+#ifdef GPS_SATELLITE_TABLE
+    EPOCH_GSA = 0x04,           // $GPGSA
+    EPOCH_GSV = 0x08,           // complete $GPGSV sequence
+#endif
+#ifdef GPS_TIME_ONLY
+    EPOCH_DEFAULT = EPOCH_RMC
+#else
+    EPOCH_DEFAULT = EPOCH_RMC | EPOCH_GGA
+#endif
+  };
+
+#ifndef GPS_TIME_ONLY
+  /* Reason a complete epoch was not committed */
+  enum {
+    REJECT_NONE,
+    REJECT_SATELLITES,          // below GPS_MINIMUM_SATELLITES
+    REJECT_HDOP,                // above gate hdop
+    REJECT_SPEED                // implied speed above gate speed
+  };
+#endif
+
   /**
    * Construct GPS_NMEA
    */
@@ -71,9 +145,226 @@ public:
    */
   virtual void end_tracing();
 
+  /**
+   * Set sentences required to commit an epoch.
+   * @param[in] sentences EPOCH_* mask, must include a sentence with time
+   */
+  void require(uint8_t sentences)
+    __attribute__((always_inline))
+  {
+    m_epoch_required = sentences;
+  }
+
+  /**
+   * Get sentences required to commit an epoch.
+   * @return EPOCH_* mask
+   */
+  uint8_t required()
+    __attribute__((always_inline))
+  {
+    return (m_epoch_required);
+  }
+
+  /**
+   * Get number of epochs dropped incomplete.
+   * @return timeouts
+   */
+  uint16_t epoch_timeouts()
+    __attribute__((always_inline))
+  {
+    return (m_epoch_timeouts);
+  }
+
+  /**
+   * Get time to first fix, from begin() to the first committed fix.
+   * @return milliseconds, 0 if no fix yet
+   */
+  uint32_t ttff()
+    __attribute__((always_inline))
+  {
+    return (m_ttff);
+  }
+
+  /**
+   * Has time to first fix been measured since begin()?
+   * @return measured
+   */
+  bool ttff_measured()
+    __attribute__((always_inline))
+  {
+    return (m_ttff_measured);
+  }
+
+  /**
+   * Get number of fixes committed (wraps).
+   * @return commits
+   */
+  uint16_t commits()
+    __attribute__((always_inline))
+  {
+    return (m_commits);
+  }
+
+  /**
+   * Enable baud rate detection. When the received characters are
+   * mostly garbage (e.g. the receiver rebooted to its default rate
+   * after a brownout) the candidate rates are tried on the device
+   * (see device_baudrate()) until the data is clean again, and the
+   * receiver is then switched back to the configured rate (see
+   * receiver_baudrate()). Detection is driven by received characters.
+   * @param[in] rate configured rate of device and receiver, 0 to disable
+   */
+  void detect(uint32_t rate);
+
+  /**
+   * Get current device baud rate.
+   * @return rate, 0 if detection is disabled
+   */
+  uint32_t baudrate()
+    __attribute__((always_inline))
+  {
+    return (m_baud_rate);
+  }
+
+  /**
+   * Is the device rate being searched for?
+   * @return hunting
+   */
+  bool hunting()
+    __attribute__((always_inline))
+  {
+    return (m_baud_state > BAUD_LOCKED);
+  }
+
+  /**
+   * Get number of baud rate mismatches detected.
+   * @return mismatches
+   */
+  uint16_t resyncs()
+    __attribute__((always_inline))
+  {
+    return (m_baud_resyncs);
+  }
+
+  /**
+   * Get time taken by the latest recovery, from mismatch detected to
+   * clean data at the final rate.
+   * @return milliseconds, 0 if none
+   */
+  uint32_t recovery()
+    __attribute__((always_inline))
+  {
+    return (m_baud_recovery);
+  }
+
+#ifndef GPS_TIME_ONLY
+  /**
+   * Set commit gate. A complete epoch is rejected if its hdop is above
+   * the limit (when $GPGGA is required), or if the distance from the
+   * last committed fix implies a speed above the limit. Speed is not
+   * checked after a gap without commits, so that the gate recovers
+   * from a real jump. A run of GPS_NMEA_GATE_RESEED speed rejected
+   * epochs within the limit of each other means the committed fix is
+   * the outlier; the last of the run is committed.
+   * @param[in] speed limit in 100ths of a knot, 0 for none
+   * @param[in] hdop limit in 100ths, 0 for none
+   * @param[in] gap milliseconds
+   */
+  void gate(speed_t speed, hdop_t hdop, uint16_t gap = GPS_NMEA_GATE_GAP)
+    __attribute__((always_inline))
+  {
+    m_gate_speed = speed;
+    m_gate_hdop = hdop;
+    m_gate_gap = gap;
+  }
+
+  /**
+   * Get number of complete epochs rejected.
+   * @return rejects
+   */
+  uint16_t rejects()
+    __attribute__((always_inline))
+  {
+    return (m_rejects);
+  }
+
+  /**
+   * Get latest rejected fix, for diagnostics.
+   * @param[out] fix
+   * @return REJECT_* reason, REJECT_NONE if none
+   */
+  uint8_t rejected(fix_t& fix);
+#endif
+
 #ifndef GPS_INTERRUPT_IMPL
+  /**
+   * Read and parse available characters from device, in blocks of
+   * GPS_NMEA_BLOCK.
+   */
   virtual void consume();
+
+  /**
+   * Read and parse at most budget characters from device.
+   * @param[in] budget maximum number of characters
+   * @return number of characters parsed
+   */
+  virtual uint16_t consume(uint16_t budget);
+
+  /**
+   * Parse character.
+   * @param[in] c character
+   */
   virtual void feedchar(char c);
+
+  /**
+   * Parse block of characters.
+   * @param[in] buf characters
+   * @param[in] size number of characters
+   */
+  virtual void feed(const char* buf, size_t size);
+#endif
+
+#ifdef GPS_SATELLITE_TABLE
+  /* Satellite from $GPGSV, used flag from $GPGSA; 4 bytes */
+  struct satellite_t {
+    uint8_t prn;
+    uint8_t elevation:7;        // degrees
+    uint8_t used:1;             // used in fix
+    uint16_t azimuth:9;         // degrees
+    uint16_t snr:7;             // dB, 0 if not tracked
+  } __attribute__((packed));
+
+  /* Satellites in view from one complete $GPGSV sequence */
+  struct satellite_table_t {
+    uint8_t count;
+    uint8_t fix;                // $GPGSA fix 1=none, 2=2D, 3=3D, 0 unknown
+    uint16_t pdop;              // 100ths
+    uint16_t hdop;              // 100ths
+    uint16_t vdop;              // 100ths
+    satellite_t satellite[GPS_NMEA_SATELLITES_MAX];
+    uint8_t visible[GPS_NMEA_PRN_MAX / 8];  // bitmap by PRN-1
+    uint8_t used[GPS_NMEA_PRN_MAX / 8];     // bitmap by PRN-1
+  };
+
+  /**
+   * Get copy of latest complete satellite table.
+   * @param[out] table
+   */
+  void satellite_table(satellite_table_t& table);
+
+  /**
+   * Is satellite in view (latest complete table)?
+   * @param[in] prn satellite PRN
+   * @return visible
+   */
+  bool visible(uint8_t prn);
+
+  /**
+   * Is satellite used in fix (latest complete table)?
+   * @param[in] prn satellite PRN
+   * @return used
+   */
+  bool used(uint8_t prn);
 #endif
 
 protected:
@@ -95,12 +386,18 @@ protected:
 #endif
 
 #ifndef GPS_TIME_ONLY
-  /* Parse position */
-  position_t parse_position(char *p);
+  /* Position DDMMmmmmm (minutes with 5 places) to millionths of a degree */
+  static position_t degrees(uint32_t ddmm);
 #endif
 
-  /* Parse and scale */
-  int32_t parse_and_scale(char *p, uint8_t places);
+  /**
+   * Get value of current numeric field, decoded as the characters were
+   * received, scaled by 10^places (max GPS_NMEA_FIELD_PLACES); extra
+   * decimals are truncated. May be used from field().
+   * @param[in] places decimals
+   * @return value
+   */
+  int32_t field_value(uint8_t places = 0);
 
   /**
    * GPS_NMEA processes only two sentences, $GPRMC and $GPGGA.  A subclass may
@@ -110,6 +407,47 @@ protected:
   virtual void field(uint8_t field_number, char* new_field);
   virtual void sentence(bool valid);
 
+  /**
+   * Drop partial sentence and epoch, e.g. when the stream is suspect;
+   * with baud rate detection enabled the rate is searched again.
+   */
+  void resync();
+
+  /**
+   * Drop the sentence being received without completing it, e.g. when
+   * the rest of the line is consumed by a subclass.
+   */
+  void drop()
+    __attribute__((always_inline))
+  {
+    m_sentence = SENTENCE_INVALID;
+  }
+
+  /**
+   * Restart time to first fix measurement, e.g. after a cold start.
+   */
+  void ttff_restart();
+
+  /**
+   * Set device (host serial port) baud rate; called by baud rate
+   * detection. Pending output should be drained before the change.
+   * Must be implemented for detection, e.g. by calling uart.begin(rate).
+   * With GPS_INTERRUPT_IMPL it is called from the interrupt handler.
+   * @param[in] rate
+   * @return true if set
+   */
+  virtual bool device_baudrate(uint32_t rate);
+
+  /**
+   * Command receiver to switch to rate; called by baud rate detection
+   * after locking on a rate other than the configured one, before the
+   * device is switched. Generic NMEA has no such command; may be
+   * implemented by subclasses.
+   * @param[in] rate
+   * @return true if written
+   */
+  virtual bool receiver_baudrate(uint32_t rate);
+
   /**
    * Print latest gps_nmea information to
    * given stream.
@@ -128,6 +466,11 @@ private:
 #ifndef GPS_TIME_ONLY
     ,
     SENTENCE_GPGGA
+#endif
+#ifdef GPS_SATELLITE_TABLE
+    ,
+    SENTENCE_GPGSA,
+    SENTENCE_GPGSV
 #endif
   } __attribute__((packed));
 
@@ -140,17 +483,86 @@ private:
   GPS_VOLATILE uint8_t m_field_offset;
   GPS_VOLATILE bool m_checksum_field;
 
+  /* Field decoded as received; value, decimals (-1 before point), sign */
+  GPS_VOLATILE uint32_t m_field_value;
+  GPS_VOLATILE int8_t m_field_places;
+  GPS_VOLATILE bool m_field_negative;
+
+  /* Start decoding next field */
+  void next_field()
+  {
+    m_field_offset = 0;
+    m_field_value = 0;
+    m_field_places = -1;
+    m_field_negative = false;
+  }
+
   /* Process field buffer */
   void process_field();
 
   /* Process sentence */
   void process_sentence();
 
+  /* Parse character */
+  void parse(char c);
+
+  /* Baud rate detection state */
+  enum {
+    BAUD_OFF,
+    BAUD_LOCKED,                // receiving at m_baud_rate
+    BAUD_HUNTING,               // trying candidate rates
+    BAUD_RESTORING,             // receiver switched to configured rate
+    BAUD_SEARCHING              // trying candidates after failed restore
+  };
+
+  GPS_VOLATILE uint32_t m_baud_configured;
+  GPS_VOLATILE uint32_t m_baud_rate;
+  GPS_VOLATILE uint8_t m_baud_state;
+  GPS_VOLATILE uint8_t m_baud_index;
+  GPS_VOLATILE uint8_t m_baud_chars;
+  GPS_VOLATILE uint8_t m_baud_errors;
+  GPS_VOLATILE uint8_t m_baud_valid;
+  GPS_VOLATILE uint16_t m_baud_resyncs;
+  GPS_VOLATILE uint32_t m_baud_lost;
+  GPS_VOLATILE uint32_t m_baud_recovery;
+
+  /* Evaluate a full window of received characters */
+  void baud_window();
+
+  /* Switch device to rate and restart window */
+  void baud_switch(uint32_t rate);
+
+  /* Rate is clean; restore configured rate or lock */
+  void baud_locked();
+
+  /* Epoch has been committed or rejected (m_epoch_sentences) */
+  static const uint8_t EPOCH_COMMITTED = 0x80;
+
+  /* Epoch state */
+  GPS_VOLATILE uint8_t m_epoch_required;
+  GPS_VOLATILE uint8_t m_epoch_sentences;
+  GPS_VOLATILE gps_time_t m_epoch_time;
+  GPS_VOLATILE uint32_t m_epoch_start;
+  GPS_VOLATILE uint16_t m_epoch_timeouts;
+
+  /* Time to first fix */
+  uint32_t m_begin;
+  GPS_VOLATILE uint32_t m_ttff;
+  GPS_VOLATILE bool m_ttff_measured;
+
+  /* Committed fixes */
+  GPS_VOLATILE uint16_t m_commits;
+
+  /* Add valid sentence to epoch, commit when complete */
+  void epoch(uint8_t sentence, bool timed);
+
+  /* Commit temporary data to GPS */
+  void commit();
+
   /* Temporary data */
   GPS_VOLATILE date_t m_tmp_date;
-  GPS_VOLATILE gps_time_t m_tmp_gprmc_time;
+  GPS_VOLATILE gps_time_t m_tmp_time;
 #ifndef GPS_TIME_ONLY
-  GPS_VOLATILE gps_time_t m_tmp_gpgga_time;
   GPS_VOLATILE position_t m_tmp_latitude;
   GPS_VOLATILE position_t m_tmp_longitude;
   GPS_VOLATILE altitude_t m_tmp_altitude;
@@ -159,5 +571,59 @@ private:
   GPS_VOLATILE satellites_t m_tmp_satellites;
   GPS_VOLATILE hdop_t m_tmp_hdop;
 #endif
+
+#ifndef GPS_TIME_ONLY
+  /* Commit gate */
+  speed_t m_gate_speed;
+  hdop_t m_gate_hdop;
+  uint16_t m_gate_gap;
+
+  /* Rejected epochs */
+  GPS_VOLATILE uint16_t m_rejects;
+  GPS_VOLATILE uint8_t m_reject;
+  fix_t m_rejected;
+
+  /* Speed rejected epochs consistent with each other; time of latest */
+  uint8_t m_gate_run;
+  uint32_t m_gate_run_time;
+
+  /* Check temporary data against gate */
+  uint8_t gate();
+
+  /* Is distance from position to temporary data possible in dt ms? */
+  bool reachable(position_t latitude, position_t longitude, uint32_t dt);
+
+  /* Keep temporary data as rejected fix */
+  void reject(uint8_t reason);
+#endif
+
+#ifdef GPS_SATELLITE_TABLE
+  /* Double buffered table; front is complete, back is being assembled */
+  satellite_table_t m_satellite_table[2];
+  GPS_VOLATILE uint8_t m_satellite_front;
+
+  /* $GPGSV sequence state; next expected message, 0 if none */
+  GPS_VOLATILE uint8_t m_gsv_next;
+  GPS_VOLATILE uint8_t m_gsv_total;
+  GPS_VOLATILE uint8_t m_gsv_message;
+  GPS_VOLATILE uint8_t m_gsv_messages;
+  GPS_VOLATILE bool m_gsv_skip;
+
+  /* $GPGSA received with valid checksum for back table */
+  GPS_VOLATILE bool m_gsa_valid;
+
+  /* Test PRN in bitmap */
+  static bool is_set(const uint8_t* bitmap, uint8_t prn)
+  {
+    prn--;
+    return (prn < GPS_NMEA_PRN_MAX && (bitmap[prn >> 3] & _BV(prn & 7)));
+  }
+
+  /* Process $GPGSV/$GPGSA field */
+  void process_satellite_field();
+
+  /* Publish back table */
+  void publish_satellite_table();
+#endif
 };
 #endif
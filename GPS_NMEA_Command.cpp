@@ -0,0 +1,143 @@
+/**
+ * @file ?/GPS_NMEA_Command.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "Cosa/Trace.hh"
+
+#include "GPS_NMEA_Command.hh"
+
+void
+GPS_NMEA_Command::putchar(char c)
+{
+  m_length++;
+  if (m_device == NULL)
+    return;
+
+  m_device->putchar(c);
+  if (m_tracing && c != '\r' && c != '\n')
+    trace << c;
+}
+
+void
+GPS_NMEA_Command::begin()
+{
+  if (m_tracing && m_device != NULL)
+    trace << endl << PSTR("-> ");
+  m_parity = 0;
+  putchar('$');
+}
+
+void
+GPS_NMEA_Command::print(char c)
+{
+  m_parity ^= c;
+  putchar(c);
+}
+
+void
+GPS_NMEA_Command::print_P(str_P s)
+{
+  const char* p = (const char*) s;
+  char c;
+
+
+  while ((c = pgm_read_byte(p++)) != 0)
+    print(c);
+}
+
+void
+GPS_NMEA_Command::field(int32_t value, uint8_t places, uint8_t digits)
+{
+  char buf[12];
+  uint32_t v;
+  uint8_t n = 0;
+  uint8_t width;
+
+
+  print(',');
+
+  if (value < 0)
+    {
+      print('-');
+      v = -(uint32_t) value;
+    }
+  else
+    v = value;
+
+  /* A 32-bit value has at most 10 digits; padding is bounded by buf */
+  if (places >= sizeof(buf))
+    places = sizeof(buf) - 1;
+  width = places + digits;
+  if (width > sizeof(buf) || width < places)
+    width = sizeof(buf);
+
+  /* Digits are produced least significant first */
+  do
+    {
+      buf[n++] = '0' + (v % 10);
+      v /= 10;
+    } while (v != 0 || n < width);
+
+  while (n-- > 0)
+    {
+      print(buf[n]);
+      if (n == places && places != 0)
+        print('.');
+    }
+}
+
+void
+GPS_NMEA_Command::end(uint8_t checksum)
+{
+  static const char hex[] __PROGMEM = "0123456789ABCDEF";
+
+
+  putchar('*');
+  putchar(pgm_read_byte(&hex[checksum >> 4]));
+  putchar(pgm_read_byte(&hex[checksum & 0xf]));
+  putchar('\r');
+  putchar('\n');
+  if (m_tracing && m_device != NULL)
+    trace << endl;
+}
+
+void
+GPS_NMEA_Command::end()
+{
+  end(m_parity);
+}
+
+void
+GPS_NMEA_Command::newline()
+{
+  putchar('\r');
+  putchar('\n');
+}
+
+void
+GPS_NMEA_Command::write(const constant_t& cmd)
+{
+  const char* p = (const char*) cmd.body;
+  char c;
+
+
+  begin();
+  while ((c = pgm_read_byte(p++)) != 0)
+    putchar(c);
+  end(cmd.checksum);
+}
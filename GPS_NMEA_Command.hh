@@ -0,0 +1,158 @@
+/**
+ * @file ?/GPS_NMEA_Command.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_NMEA_COMMAND_HH
+#define COSA_GPS_NMEA_COMMAND_HH
+
+#include "Cosa/IOStream.hh"
+
+/**
+ * Constant command; body (between '$' and '*') in program memory with
+ * checksum computed at compile time.
+ */
+#define GPS_NMEA_COMMAND(body)                                          \
+  GPS_NMEA_Command::constant_t(PSTR(body),                              \
+    GPS_NMEA_Command::constant<GPS_NMEA_Command::checksum(body)>::value)
+
+/**
+ * GPS NMEA Command
+ *
+ * Writes NMEA sentences to a device without an intermediate buffer.
+ * Constant commands carry a checksum computed at compile time; dynamic
+ * fields are streamed directly to the device while the checksum is
+ * accumulated. With a NULL device only the length is counted, e.g. to
+ * check the device has room for the sentence before writing it.
+ */
+
+class GPS_NMEA_Command {
+public:
+  /**
+   * Checksum (exclusive or) of sentence body.
+   * @param[in] s body
+   * @param[in] parity accumulated so far
+   * @return checksum
+   */
+  static constexpr uint8_t checksum(const char* s, uint8_t parity = 0)
+  {
+    return (*s == 0 ? parity : checksum(s + 1, parity ^ *s));
+  }
+
+  /* Force compile time evaluation */
+  template<uint8_t VALUE>
+  struct constant {
+    static const uint8_t value = VALUE;
+  };
+
+  /* Constant command */
+  struct constant_t {
+    constant_t(str_P b, uint8_t c) : body(b), checksum(c) {}
+    str_P body;
+    uint8_t checksum;
+  };
+
+  /**
+   * Construct command writer.
+   * @param[in] device to write to, NULL to count length only
+   * @param[in] tracing echo sentence to trace
+   */
+  GPS_NMEA_Command(IOStream::Device* device, bool tracing = false) :
+    m_device(device),
+    m_tracing(tracing),
+    m_parity(0),
+    m_length(0)
+  {}
+
+  /**
+   * Start sentence.
+   */
+  void begin();
+
+  /**
+   * Write character of sentence body.
+   * @param[in] c character
+   */
+  void print(char c);
+
+  /**
+   * Write string in program memory as part of sentence body.
+   * @param[in] s string
+   */
+  void print_P(str_P s);
+
+  /**
+   * Write field separator and decimal value.
+   * @param[in] value
+   * @param[in] places implied decimal places in value
+   * @param[in] digits minimum integer digits (zero padded); places and
+   *   digits together are limited to 12
+   */
+  void field(int32_t value, uint8_t places = 0, uint8_t digits = 1);
+
+  /**
+   * End sentence with accumulated checksum and CRLF.
+   */
+  void end();
+
+  /**
+   * End sentence with given checksum and CRLF.
+   * @param[in] checksum
+   */
+  void end(uint8_t checksum);
+
+  /**
+   * Write empty line (CRLF), e.g. to wake a receiver.
+   */
+  void newline();
+
+  /**
+   * Write constant command, using its precomputed checksum.
+   * @param[in] cmd constant command
+   */
+  void write(const constant_t& cmd);
+
+  /**
+   * Get checksum accumulated so far
+   * @return parity
+   */
+  uint8_t parity()
+    __attribute__((always_inline))
+  {
+    return (m_parity);
+  }
+
+  /**
+   * Get length written (or counted) so far
+   * @return length
+   */
+  uint8_t length()
+    __attribute__((always_inline))
+  {
+    return (m_length);
+  }
+
+protected:
+  IOStream::Device* m_device;
+  bool m_tracing;
+  uint8_t m_parity;
+  uint8_t m_length;
+
+  /* Write character outside checksum */
+  void putchar(char c);
+};
+#endif
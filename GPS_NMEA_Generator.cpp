@@ -0,0 +1,357 @@
+/**
+ * @file ?/GPS_NMEA_Generator.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "Cosa/IOBuffer.hh"
+#include "Cosa/RTT.hh"
+
+#include "GPS_NMEA_Generator.hh"
+
+/* Sentences of an epoch, in order of generation */
+enum {
+  NEXT_RMC,
+  NEXT_GGA,
+  NEXT_GSA,
+  NEXT_GSV,
+  NEXT_PMTK = NEXT_GSV + 3,
+  NEXT_DONE
+};
+
+/* Device passing on a limited number of characters */
+class Truncate : public IOStream::Device {
+public:
+  Truncate(IOStream::Device* device, uint8_t limit) :
+    m_device(device),
+    m_limit(limit)
+  {}
+
+  virtual int putchar(char c)
+  {
+    if (m_limit == 0)
+      return (c);
+    m_limit--;
+    return (m_device->putchar(c));
+  }
+
+protected:
+  IOStream::Device* m_device;
+  uint8_t m_limit;
+};
+
+GPS_NMEA_Generator::GPS_NMEA_Generator(clock_t start) :
+  m_start(start),
+  m_time(0),
+  m_started(false),
+  m_latitude(0),
+  m_longitude(0),
+  m_altitude(0),
+  m_speed(0),
+  m_course(0),
+  m_satellites(8),
+  m_noise(0),
+  m_rate(1000),
+  m_sentences(SENTENCE_DEFAULT),
+  m_errors(0),
+  m_probability(0),
+  m_epoch_latitude(0),
+  m_epoch_longitude(0),
+  m_next(NEXT_DONE),
+  m_written(0),
+  m_bytes(0),
+  m_injected(0),
+  m_random(0xace1)
+{
+}
+
+void
+GPS_NMEA_Generator::position(int32_t latitude, int32_t longitude,
+                             int32_t altitude)
+{
+  m_latitude = latitude;
+  m_longitude = longitude;
+  m_altitude = altitude;
+}
+
+uint16_t
+GPS_NMEA_Generator::random()
+{
+  /* xorshift */
+  m_random ^= m_random << 7;
+  m_random ^= m_random >> 9;
+  m_random ^= m_random << 8;
+  return (m_random);
+}
+
+bool
+GPS_NMEA_Generator::error(uint8_t error)
+{
+  if (!(m_errors & error) || (random() & 0xff) >= m_probability)
+    return (false);
+
+  m_injected++;
+  return (true);
+}
+
+void
+GPS_NMEA_Generator::epoch(uint32_t ms)
+{
+#ifndef GPS_TIME_ONLY
+  uint32_t elapsed = ms - m_time;
+
+  /* Move in steps of at most a second so that long gaps don't overflow */
+  while (m_started && m_speed != 0 && elapsed != 0)
+    {
+      uint32_t step = (elapsed > 1000 ? 1000 : elapsed);
+
+      /* Distance in decimeters; 100ths of a knot to cm/s is 0.5144 */
+      int32_t d = ((m_speed * 527) >> 10) * step / 10000;
+      int32_t north = (d * GPS::cos_course(m_course)) >> 15;
+      int32_t east = (d * GPS::cos_course(m_course - 9000)) >> 15;
+      uint16_t cos = GPS::cos_latitude(m_latitude);
+
+      /* A decimeter is 0.9 millionths of a degree of latitude */
+      north = (north * 921) / 1024;
+      east = (east * 921) / 1024;
+      m_latitude += north;
+      if (cos != 0)
+        m_longitude += (east * 32768L) / cos;
+      elapsed -= step;
+    }
+#endif
+
+  m_time = ms;
+  m_started = true;
+  m_next = NEXT_RMC;
+
+  /* Same noisy position for all sentences of the epoch */
+  m_epoch_latitude = m_latitude;
+  m_epoch_longitude = m_longitude;
+  if (m_noise != 0)
+    {
+      int32_t range = m_noise * 9L;
+      m_epoch_latitude += (int32_t) (random() % (2 * range + 1)) - range;
+      m_epoch_longitude += (int32_t) (random() % (2 * range + 1)) - range;
+    }
+}
+
+bool
+GPS_NMEA_Generator::sentence(IOStream::Device* out)
+{
+  uint8_t next;
+
+
+  /* Next selected sentence */
+  while (true)
+    {
+      if (m_next == NEXT_DONE)
+        return (false);
+      next = m_next++;
+
+      if (next == NEXT_RMC && (m_sentences & SENTENCE_RMC))
+        break;
+      if (next == NEXT_GGA && (m_sentences & SENTENCE_GGA))
+        break;
+      if (next == NEXT_GSA && (m_sentences & SENTENCE_GSA))
+        break;
+      if (next == NEXT_PMTK && (m_sentences & SENTENCE_PMTK))
+        break;
+      if (next >= NEXT_GSV && next < NEXT_PMTK &&
+          (m_sentences & SENTENCE_GSV) &&
+          next - NEXT_GSV < (m_satellites + 3) / 4)
+        break;
+    }
+
+  /* Binary noise between sentences */
+  if (error(ERROR_NOISE))
+    for (uint8_t n = 1 + (random() & 0xf); n > 0; n--)
+      {
+        out->putchar(0x80 | random());
+        m_bytes++;
+      }
+
+  {
+    uint8_t limit = (error(ERROR_TRUNCATE) ? 8 + (random() % 40) : 255);
+    Truncate device(out, limit);
+    GPS_NMEA_Command cmd(&device);
+
+    body(cmd, next);
+
+    if (error(ERROR_FIELD))
+      {
+        cmd.print(',');
+        for (uint8_t i = 0; i < 40; i++)
+          cmd.print('0' + (i % 10));
+      }
+
+    if (error(ERROR_CHECKSUM))
+      cmd.end(cmd.parity() ^ 0x5a);
+    else
+      cmd.end();
+
+    if (cmd.length() > limit)
+      {
+        out->putchar('\r');
+        out->putchar('\n');
+        m_bytes += limit + 2;
+      }
+    else
+      m_bytes += cmd.length();
+  }
+
+  m_written++;
+
+  return (true);
+}
+
+void
+GPS_NMEA_Generator::body(GPS_NMEA_Command& out, uint8_t next)
+{
+  time_t now(m_start + m_time / 1000);
+  int32_t time = (((now.hours * 100L) + now.minutes) * 100L + now.seconds)
+    * 1000L + (m_time % 1000);
+
+
+  out.begin();
+  switch (next)
+    {
+    case NEXT_RMC:
+      out.print_P(PSTR("GPRMC"));
+      out.field(time, 3, 6);
+      out.print(',');
+      out.print(m_satellites >= 3 ? 'A' : 'V');
+      position(out);
+      out.field(m_speed, 2);
+      out.field(m_course, 2);
+      out.field((now.date * 100L + now.month) * 100L + now.year, 0, 6);
+      out.print_P(PSTR(",,,A"));
+      break;
+
+    case NEXT_GGA:
+      out.print_P(PSTR("GPGGA"));
+      out.field(time, 3, 6);
+      position(out);
+      out.field(m_satellites >= 3 ? 1 : 0);  // quality
+      out.field(m_satellites, 0, 2);
+      out.field(9, 1);                        // hdop
+      out.field(m_altitude / 10, 1);
+      out.print_P(PSTR(",M,0.0,M,,"));
+      break;
+
+    case NEXT_GSA:
+      out.print_P(PSTR("GPGSA,A"));
+      out.field(m_satellites >= 4 ? 3 : (m_satellites == 3 ? 2 : 1));
+      for (uint8_t i = 1; i <= 12; i++)
+        if (i <= m_satellites)
+          out.field(i, 0, 2);
+        else
+          out.print(',');
+      out.field(15, 1);                       // pdop
+      out.field(9, 1);                        // hdop
+      out.field(12, 1);                       // vdop
+      break;
+
+    case NEXT_PMTK:
+      out.print_P(PSTR("PMTK001,0,3"));
+      break;
+
+    default:
+      {
+        /* GSV, four satellites per message */
+        uint8_t message = next - NEXT_GSV;
+
+        out.print_P(PSTR("GPGSV"));
+        out.field((m_satellites + 3) / 4);
+        out.field(message + 1);
+        out.field(m_satellites, 0, 2);
+        for (uint8_t i = message * 4 + 1;
+             i <= message * 4 + 4 && i <= m_satellites; i++)
+          {
+            out.field(i, 0, 2);               // prn
+            out.field((i * 7) % 90, 0, 2);    // elevation
+            out.field((i * 30) % 360, 0, 3);  // azimuth
+            out.field(25 + (random() % 20), 0, 2);
+          }
+      }
+      break;
+    }
+}
+
+void
+GPS_NMEA_Generator::position(GPS_NMEA_Command& out)
+{
+  int32_t value[2] = { m_epoch_latitude, m_epoch_longitude };
+
+
+  /* ddmm.mmmm,N,dddmm.mmmm,E from millionths of a degree */
+  for (uint8_t i = 0; i < 2; i++)
+    {
+      uint32_t v = (value[i] < 0 ? -value[i] : value[i]);
+      int32_t nmea = (v / 1000000) * 1000000 + ((v % 1000000) * 3 + 2) / 5;
+
+      out.field(nmea, 4, 4 + i);
+      out.print(',');
+      if (i == 0)
+        out.print(value[i] < 0 ? 'S' : 'N');
+      else
+        out.print(value[i] < 0 ? 'W' : 'E');
+    }
+}
+
+void
+GPS_NMEA_Generator::generate(IOStream::Device* out, uint16_t epochs)
+{
+  while (epochs-- > 0)
+    {
+      epoch();
+      while (sentence(out))
+        ;
+    }
+}
+
+#ifndef GPS_INTERRUPT_IMPL
+uint16_t
+GPS_NMEA_Generator::receivers(GPS_NMEA& gps, uint16_t epochs)
+{
+  IOBuffer<GPS_NMEA_GENERATOR_BUFFER> buffer;
+  uint32_t busy = 0;
+  uint64_t real = (uint64_t) epochs * m_rate * 1000UL;
+  uint64_t n;
+
+
+  /* Generation is not measured; parse each sentence in blocks */
+  for (uint16_t i = 0; i < epochs; i++)
+    {
+      epoch();
+      while (sentence(&buffer))
+        {
+          char buf[GPS_NMEA_BLOCK];
+          uint32_t start = RTT::micros();
+          int count;
+          while ((count = buffer.read(buf, sizeof(buf))) > 0)
+            gps.feed(buf, count);
+          busy += RTT::micros() - start;
+        }
+    }
+
+  if (busy == 0)
+    return (0xffff);
+  n = real / busy;
+
+  return (n > 0xffff ? 0xffff : n);
+}
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file ?/GPS_NMEA_Generator.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_NMEA_GENERATOR_HH
+#define COSA_GPS_NMEA_GENERATOR_HH
+
+#include "Cosa/IOStream.hh"
+#include "Cosa/Time.hh"
+
+#include "GPS.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_NMEA_Command.hh"
+
+/* Buffer used by receivers() */
+#define GPS_NMEA_GENERATOR_BUFFER 256
+
+/**
+ * GPS NMEA Generator
+ *
+ * Produces NMEA sentences from a simple trajectory model (position,
+ * speed and course) in simulated time, independent of real time, so
+ * that streams can be generated as fast as they are consumed. The mix
+ * of sentences and injected errors is configurable. Sentences are
+ * written one at a time to any IOStream::Device.
+ */
+
+class GPS_NMEA_Generator {
+public:
+  /* Sentences, as selected with PMTK314 */
+  enum {
+    SENTENCE_RMC = 0x01,
+    SENTENCE_GGA = 0x02,
+    SENTENCE_GSA = 0x04,
+    SENTENCE_GSV = 0x08,
+    SENTENCE_PMTK = 0x10,       // proprietary $PMTK001
+    SENTENCE_DEFAULT = 0x0f
+  };
+
+  /* Injected errors */
+  enum {
+    ERROR_CHECKSUM = 0x01,      // wrong checksum
+    ERROR_TRUNCATE = 0x02,      // line cut short
+    ERROR_NOISE = 0x04,         // binary noise before sentence
+    ERROR_FIELD = 0x08          // field longer than parser buffer
+  };
+
+  /**
+   * Construct generator.
+   * @param[in] start time of first epoch
+   */
+  GPS_NMEA_Generator(clock_t start = 0);
+
+  /**
+   * Set position.
+   * @param[in] latitude in millionths of a degree
+   * @param[in] longitude in millionths of a degree
+   * @param[in] altitude in centimeters
+   */
+  void position(int32_t latitude, int32_t longitude, int32_t altitude);
+
+  /**
+   * Set motion; position is advanced each epoch (full builds only).
+   * @param[in] speed in 100ths of a knot
+   * @param[in] course in 100ths of a degree
+   */
+  void motion(uint32_t speed, uint32_t course)
+    __attribute__((always_inline))
+  {
+    m_speed = speed;
+    m_course = course % 36000;
+  }
+
+  /**
+   * Set position noise.
+   * @param[in] meters maximum error, uniformly distributed
+   */
+  void noise(uint16_t meters)
+    __attribute__((always_inline))
+  {
+    m_noise = meters;
+  }
+
+  /**
+   * Set number of satellites in view and used.
+   * @param[in] satellites (0..12)
+   */
+  void satellites(uint8_t satellites)
+    __attribute__((always_inline))
+  {
+    m_satellites = (satellites > 12 ? 12 : satellites);
+  }
+
+  /**
+   * Set fix interval.
+   * @param[in] ms milliseconds between epochs
+   */
+  void rate(uint16_t ms)
+    __attribute__((always_inline))
+  {
+    m_rate = ms;
+  }
+
+  /**
+   * Get fix interval
+   * @return milliseconds
+   */
+  uint16_t rate()
+    __attribute__((always_inline))
+  {
+    return (m_rate);
+  }
+
+  /**
+   * Select sentences generated each epoch.
+   * @param[in] sentences SENTENCE_* mask
+   */
+  void sentences(uint8_t sentences)
+    __attribute__((always_inline))
+  {
+    m_sentences = sentences;
+  }
+
+  /**
+   * Get selected sentences
+   * @return SENTENCE_* mask
+   */
+  uint8_t sentences()
+    __attribute__((always_inline))
+  {
+    return (m_sentences);
+  }
+
+  /**
+   * Inject errors.
+   * @param[in] errors ERROR_* mask
+   * @param[in] probability per sentence and error, in 1/256
+   */
+  void errors(uint8_t errors, uint8_t probability)
+    __attribute__((always_inline))
+  {
+    m_errors = errors;
+    m_probability = probability;
+  }
+
+  /**
+   * Start next epoch, one fix interval after the current one.
+   */
+  void epoch()
+  {
+    epoch(m_started ? m_time + m_rate : 0);
+  }
+
+  /**
+   * Start epoch at given time; position moves for the time elapsed.
+   * @param[in] ms time since start
+   */
+  void epoch(uint32_t ms);
+
+  /**
+   * Write next sentence of current epoch.
+   * @param[in] out device
+   * @return true if written, false when epoch is complete
+   */
+  bool sentence(IOStream::Device* out);
+
+  /**
+   * Write given number of complete epochs.
+   * @param[in] out device, must have room for the sentences
+   * @param[in] epochs
+   */
+  void generate(IOStream::Device* out, uint16_t epochs);
+
+#ifndef GPS_INTERRUPT_IMPL
+  /**
+   * Estimate number of receivers at the current rate and sentence mix
+   * that one parser can sustain, by feeding generated epochs to the
+   * given parser and measuring parse time (RTT::micros).
+   * @param[in] gps parser
+   * @param[in] epochs to measure
+   * @return receivers
+   */
+  uint16_t receivers(GPS_NMEA& gps, uint16_t epochs);
+#endif
+
+  /**
+   * Get number of sentences written
+   * @return sentences
+   */
+  uint32_t written()
+    __attribute__((always_inline))
+  {
+    return (m_written);
+  }
+
+  /**
+   * Get number of bytes written
+   * @return bytes
+   */
+  uint32_t bytes()
+    __attribute__((always_inline))
+  {
+    return (m_bytes);
+  }
+
+  /**
+   * Get number of errors injected
+   * @return errors
+   */
+  uint32_t injected()
+    __attribute__((always_inline))
+  {
+    return (m_injected);
+  }
+
+protected:
+  /* Trajectory */
+  clock_t m_start;
+  uint32_t m_time;
+  bool m_started;
+  int32_t m_latitude;
+  int32_t m_longitude;
+  int32_t m_altitude;
+  uint32_t m_speed;
+  uint32_t m_course;
+  uint8_t m_satellites;
+  uint16_t m_noise;
+
+  /* Configuration */
+  uint16_t m_rate;
+  uint8_t m_sentences;
+  uint8_t m_errors;
+  uint8_t m_probability;
+
+  /* Epoch; position with noise and next sentence */
+  int32_t m_epoch_latitude;
+  int32_t m_epoch_longitude;
+  uint8_t m_next;
+
+  /* Statistics */
+  uint32_t m_written;
+  uint32_t m_bytes;
+  uint32_t m_injected;
+
+  /* Pseudo random state */
+  uint16_t m_random;
+
+  /* Get pseudo random number */
+  uint16_t random();
+
+  /* Error occurs? */
+  bool error(uint8_t error);
+
+  /* Write sentence body */
+  void body(GPS_NMEA_Command& out, uint8_t next);
+
+  /* Write position fields */
+  void position(GPS_NMEA_Command& out);
+};
+#endif
@@ -17,6 +17,7 @@
  *
  */
 
+#include <ctype.h>
 #include "Cosa/Trace.hh"
 #include "Cosa/RTT.hh"
 
@@ -27,7 +28,37 @@ GPS_NMEA_MT3339::GPS_NMEA_MT3339(IOStream::Device *device) :
   GPS_NMEA(device),
   m_sentence(SENTENCE_UNKNOWN),
   m_first_sentence_received(false),
-  m_ending(false)
+  m_ending(false),
+  m_queued(0),
+#ifdef GPS_INTERRUPT_IMPL
+  m_acks(0),
+  m_select(false),
+#endif
+  m_locus_logging(false),
+  m_locus_records(0),
+  m_locus_used(0),
+  m_locus(NULL),
+  m_epo(NULL),
+  m_binary_length(0),
+  m_assist_clock(0),
+  m_rate(1000),
+  m_health(HEALTH_OK),
+  m_health_start(0),
+  m_health_lost(0),
+  m_health_sentence(0),
+  m_health_max_gap(0),
+  m_health_sentences(0),
+  m_health_failed(0),
+  m_health_commits_start(0),
+  m_health_timeouts_start(0),
+  m_health_resyncs_start(0),
+  m_health_hunting(false),
+  m_health_gap(0),
+  m_health_commits(0),
+  m_health_errors(0),
+  m_recoveries(0),
+  m_recovery_time(0),
+  m_recovered_by(HEALTH_OK)
 {
 }
 
@@ -39,7 +70,19 @@ GPS_NMEA_MT3339::begin()
   if (!GPS_NMEA::begin())
     return (false);
 
-  send_cmd(PSTR(""));  // wake
+  m_health = HEALTH_OK;
+  monitor_restart();
+
+  queue(COMMAND_WAKE, NULL, 0, 0);
+
+  if (m_assist_clock != 0)
+    {
+      command(PSTR("PMTK740"));
+#ifndef GPS_TIME_ONLY
+      if (m_assist_position)
+        command(PSTR("PMTK741"));
+#endif
+    }
 
   return (true);
 }
@@ -54,7 +97,8 @@ GPS_NMEA_MT3339::end(void)
     {
       // Ending while device isn't responding
       // Don't defer
-      send_cmd(PSTR("$PMTK161,0*28"));
+      GPS_NMEA_Command out(m_device, m_tracing);
+      out.write(GPS_NMEA_COMMAND("PMTK161,0"));
       reset();
       GPS_NMEA::end();
     }
@@ -63,8 +107,15 @@ GPS_NMEA_MT3339::end(void)
       // Device seems active
       // Defer handling final end until ack comes in
 
-      if (!m_ending)
-        send_cmd(PSTR("$PMTK161,0*28"));
+      if (!m_ending && !command(GPS_NMEA_COMMAND("PMTK161,0")))
+        {
+          // No room to track the ack; end now
+          GPS_NMEA_Command out(m_device, m_tracing);
+          out.write(GPS_NMEA_COMMAND("PMTK161,0"));
+          reset();
+          GPS_NMEA::end();
+          return;
+        }
 
       m_ending = true;
     }
@@ -82,6 +133,23 @@ GPS_NMEA_MT3339::reset(void)
   m_sentence = SENTENCE_UNKNOWN;
   m_first_sentence_received = false;
   m_ending = false;
+#ifdef GPS_INTERRUPT_IMPL
+  m_acks = 0;
+  m_select = false;
+#endif
+
+  /* Drop queued commands; those queued on completion are kept */
+  for (uint8_t n = m_queued; n > 0; n--)
+    {
+      uint16_t command = m_queue[0].number;
+
+      m_queued--;
+      for (uint8_t i = 0; i < m_queued; i++)
+        m_queue[i] = m_queue[i + 1];
+      if (command == 622)
+        m_locus = NULL;
+      command_completed(command, STATUS_CANCELLED);
+    }
 
   GPS_NMEA::reset();
 }
@@ -89,9 +157,15 @@ GPS_NMEA_MT3339::reset(void)
 void
 GPS_NMEA_MT3339::factory_reset(void)
 {
-  send_cmd(PSTR("$PMTK104*37"));
   reset();
-  GPS_NMEA::begin();
+  command(GPS_NMEA_COMMAND("PMTK104"));
+
+  /* Cold start; measure time to first fix again */
+  if (!GPS_NMEA::begin())
+    ttff_restart();
+
+  /* Receiver default fix interval */
+  m_rate = 1000;
 }
 
 void
@@ -105,6 +179,10 @@ GPS_NMEA_MT3339::field(uint8_t field_number, char *new_field)
         m_sentence = SENTENCE_ACK;
       else if (!strcmp(new_field, "PMTK705"))
         m_sentence = SENTENCE_VERSION;
+      else if (!strcmp(new_field, "PMTKLOG"))
+        m_sentence = SENTENCE_LOG;
+      else if (!strcmp(new_field, "PMTKLOX"))
+        m_sentence = SENTENCE_LOX;
       return;
     }
 
@@ -114,29 +192,56 @@ GPS_NMEA_MT3339::field(uint8_t field_number, char *new_field)
       switch (field_number)
         {
         case 1: // Command
-          m_command = strtoul(new_field, NULL, 10);
+          m_command = field_value();
           break;
 
         case 2: // Status
-          m_status = strtoul(new_field, NULL, 10);
+          m_status = field_value();
           break;
 
         default:
           m_sentence = SENTENCE_UNKNOWN;
           break;
         }
+      break;
 
     case SENTENCE_VERSION:
       switch (field_number)
         {
         case 1: // Release
-          strncpy(m_release, new_field, sizeof(m_release)-1);
+          strncpy((char*)m_release, new_field, sizeof(m_release)-1);
           break;
 
         case 2: // Version
-          m_version = strtoul(new_field, NULL, 10);
+          m_version = field_value();
           break;
         }
+      break;
+
+    case SENTENCE_LOG:
+      switch (field_number)
+        {
+        case 8: // Status, 0 logging
+          m_locus_logging = (field_value() == 0);
+          break;
+
+        case 9: // Records
+          m_locus_records = field_value();
+          break;
+
+        case 10: // Percent used
+          m_locus_used = field_value();
+          break;
+        }
+      break;
+
+    case SENTENCE_LOX:
+      /* Start of dump, $PMTKLOX,0,lines; data lines take the fast path */
+      if (field_number == 1 && field_value() != 0)
+        m_sentence = SENTENCE_UNKNOWN;
+      else if (field_number == 2 && m_locus != NULL)
+        m_locus->m_total = field_value();
+      break;
 
     default:
       break;
@@ -148,22 +253,36 @@ GPS_NMEA_MT3339::sentence(bool valid)
 {
   //  trace << endl << PSTR("valid=") << valid << PSTR(" sentence=") << m_sentence << PSTR(" command=") << m_command << endl;
 
+  /* Health statistics */
+  if (valid)
+    {
+      uint32_t gap = RTT::since(m_health_sentence);
+
+      if (gap > m_health_max_gap)
+        m_health_max_gap = (gap > 0xffff ? 0xffff : gap);
+      m_health_sentence = RTT::millis();
+      m_health_sentences++;
+    }
+  else
+    m_health_failed++;
+
   if (valid)
     {
       switch (m_sentence)
         {
         case SENTENCE_ACK:
-          switch (m_command)
+#ifdef GPS_INTERRUPT_IMPL
+          /* Matched by transmit(), outside of interrupt handler */
+          if (m_acks < GPS_NMEA_MT3339_COMMANDS)
             {
-            case 161: // standby
-              // doesn't matter if it succeeded or not
-              reset();
-              GPS_NMEA::end();
-              break;
-
-            case 314: // select sentences
-              break;
+              m_ack[m_acks].command = m_command;
+              m_ack[m_acks].status = m_status;
+              m_acks++;
             }
+#else
+          acknowledge(m_command, m_status);
+          send();
+#endif
           break;
 
         case SENTENCE_VERSION:
@@ -174,7 +293,11 @@ GPS_NMEA_MT3339::sentence(bool valid)
           if (!m_first_sentence_received && !m_ending)
             {
               m_first_sentence_received = true;
+#ifdef GPS_INTERRUPT_IMPL
+              m_select = true;
+#else
               select_sentences();
+#endif
             }
         }
     }
@@ -185,22 +308,956 @@ GPS_NMEA_MT3339::sentence(bool valid)
   m_status = 0;
 }
 
+#ifndef GPS_INTERRUPT_IMPL
+uint16_t
+GPS_NMEA_MT3339::consume(uint16_t budget)
+{
+  uint16_t count = GPS_NMEA::consume(budget);
+
+
+  transmit();
+
+  return (count);
+}
+
+void
+GPS_NMEA_MT3339::feedchar(char c)
+{
+  if (m_epo != NULL && m_epo->m_state != EPO::BINARY)
+    receive(c);
+  else if (m_locus == NULL || !m_locus->parse(c))
+    GPS_NMEA::feedchar(c);
+  else
+    /* Data line; the prefix seen by the NMEA parser is not a failed
+     * sentence */
+    drop();
+}
+
+void
+GPS_NMEA_MT3339::feed(const char* buf, size_t size)
+{
+  if (m_epo != NULL && m_epo->m_state != EPO::BINARY)
+    while (size-- > 0)
+      receive(*buf++);
+  else if (m_locus != NULL)
+    /* Dump ends on acknowledge, while feeding */
+    while (size-- > 0)
+      feedchar(*buf++);
+  else
+    GPS_NMEA::feed(buf, size);
+}
+#else
+int
+GPS_NMEA_MT3339::putchar(char c)
+{
+  if (m_epo != NULL && m_epo->m_state != EPO::BINARY)
+    {
+      receive(c);
+      return (c);
+    }
+  if (m_locus != NULL && m_locus->parse(c))
+    {
+      /* Not to be completed by the NMEA parser */
+      drop();
+      return (c);
+    }
+  return (GPS_NMEA::putchar(c));
+}
+#endif
+
+bool
+GPS_NMEA_MT3339::command(const GPS_NMEA_Command::constant_t& cmd)
+{
+  return (queue(COMMAND_CONSTANT, cmd.body, cmd.checksum, 0));
+}
+
+bool
+GPS_NMEA_MT3339::command(str_P body, int32_t value)
+{
+  return (queue(COMMAND_VALUE, body, 0, value));
+}
+
+bool
+GPS_NMEA_MT3339::command(str_P body)
+{
+  return (queue(COMMAND_GENERATED, body, 0, 0));
+}
+
+bool
+GPS_NMEA_MT3339::rate(uint16_t ms)
+{
+  if (ms < 100 || ms > 10000)
+    return (false);
+
+  if (!command(PSTR("PMTK220"), ms))
+    return (false);
+
+  m_rate = ms;
+
+  return (true);
+}
+
+bool
+GPS_NMEA_MT3339::queue(uint8_t kind, str_P body, uint8_t checksum,
+                       int32_t value)
+{
+  command_t* entry;
+  uint16_t number = 0;
+
+
+  if (m_queued == GPS_NMEA_MT3339_COMMANDS)
+    return (false);
+
+  /* Command number follows "PMTK" */
+  if (body != NULL && strncmp_P("PMTK", (const char*) body, 4) == 0)
+    for (const char* p = (const char*) body + 4; isdigit(pgm_read_byte(p)); p++)
+      number = (number * 10) + (pgm_read_byte(p) - '0');
+
+  entry = &m_queue[m_queued];
+  entry->body = body;
+  entry->value = value;
+  entry->number = number;
+  entry->checksum = checksum;
+  entry->kind = kind;
+  entry->retries = GPS_NMEA_MT3339_RETRIES;
+  entry->sent = false;
+  entry->time = RTT::millis();
+  m_queued++;
+
+  send();
+
+  return (true);
+}
+
+void
+GPS_NMEA_MT3339::write(GPS_NMEA_Command& out, command_t* entry)
+{
+  switch (entry->kind)
+    {
+    case COMMAND_WAKE:
+      out.newline();
+      break;
+
+    case COMMAND_CONSTANT:
+      out.write(GPS_NMEA_Command::constant_t(entry->body, entry->checksum));
+      break;
+
+    case COMMAND_VALUE:
+      out.begin();
+      out.print_P(entry->body);
+      out.field(entry->value);
+      out.end();
+      break;
+
+    case COMMAND_GENERATED:
+      out.begin();
+      out.print_P(entry->body);
+      generate(out, entry->number);
+      out.end();
+      break;
+    }
+}
+
 void
-GPS_NMEA_MT3339::send_cmd(str_P cmd)
+GPS_NMEA_MT3339::transmit()
 {
 #ifdef GPS_INTERRUPT_IMPL
-      // bad idea to trace within Irq...
+  ack_t ack[GPS_NMEA_MT3339_COMMANDS];
+  uint8_t acks;
+  bool select;
+
+  /* Take what the interrupt handler recorded */
+  synchronized {
+    acks = m_acks;
+    for (uint8_t j = 0; j < acks; j++)
+      ack[j] = m_ack[j];
+    m_acks = 0;
+    select = m_select;
+    m_select = false;
+  }
+  for (uint8_t j = 0; j < acks; j++)
+    acknowledge(ack[j].command, ack[j].status);
+  if (select)
+    select_sentences();
 #endif
-  if (m_tracing)
-    trace << endl << PSTR("-> ") << cmd << endl;
-  m_device->puts(cmd);
-  m_device->puts((str_P)IOStream::CRLF);
+
+  monitor();
+  send();
+}
+
+void
+GPS_NMEA_MT3339::send()
+{
+  uint8_t i = 0;
+
+
+  /* Receiver doesn't take NMEA while in binary mode */
+  if (m_epo != NULL)
+    {
+      upload();
+      return;
+    }
+
+  while (i < m_queued)
+    {
+      command_t* entry = &m_queue[i];
+
+      if (!entry->sent)
+        {
+          GPS_NMEA_Command length(NULL);
+          GPS_NMEA_Command out(m_device, m_tracing);
+
+          /* Keep order; wait for room unless waited too long */
+          write(length, entry);
+          if (m_device->room() < length.length() &&
+              RTT::since(entry->time) < GPS_NMEA_MT3339_ACK_TIMEOUT)
+            return;
+
+          write(out, entry);
+          entry->sent = true;
+          entry->time = RTT::millis();
+
+          /* Wake and restarts are not acknowledged */
+          if (entry->number == 0 ||
+              (entry->number >= 101 && entry->number <= 104))
+            {
+              complete(i, STATUS_SUCCESS);
+              continue;
+            }
+        }
+      else if (RTT::since(entry->time) >= GPS_NMEA_MT3339_ACK_TIMEOUT)
+        {
+          /* Dump is acknowledged when done; wait while lines arrive */
+          if (entry->number == 622 && m_locus != NULL &&
+              RTT::since(m_locus->m_time) < GPS_NMEA_MT3339_ACK_TIMEOUT)
+            {
+              entry->time = m_locus->m_time;
+              i++;
+              continue;
+            }
+          if (entry->retries > 0)
+            {
+              entry->retries--;
+              entry->sent = false;
+              continue;
+            }
+          complete(i, STATUS_TIMEOUT);
+          continue;
+        }
+
+      i++;
+    }
+}
+
+bool
+GPS_NMEA_MT3339::upload(EPO* epo)
+{
+  if (m_epo != NULL)
+    return (false);
+
+  epo->m_state = EPO::BINARY;
+  epo->m_status = STATUS_INVALID;
+  epo->m_packets = 0;
+  epo->m_sequence = 0;
+  epo->m_time = RTT::millis();
+  m_binary_length = 0;
+  m_epo = epo;
+
+  send();
+
+  return (true);
+}
+
+void
+GPS_NMEA_MT3339::upload()
+{
+  EPO* epo = m_epo;
+
+
+  switch (epo->m_state)
+    {
+    case EPO::BINARY:
+      {
+        GPS_NMEA_Command out(m_device, m_tracing);
+
+        if (m_device->room() < 17 &&
+            RTT::since(epo->m_time) < GPS_NMEA_MT3339_ACK_TIMEOUT)
+          return;
+        out.write(GPS_NMEA_COMMAND("PMTK253,1,0"));
+        epo->m_state = EPO::SEND;
+        epo->prepare();
+      }
+      /* Fall through */
+
+    case EPO::SEND:
+    case EPO::NMEA:
+      {
+        int room = m_device->room();
+
+        /* Write as much of the packet as there is room for */
+        while (room-- > 0 && epo->m_offset < epo->m_length)
+          m_device->putchar(epo->byte(epo->m_offset++));
+        if (epo->m_offset < epo->m_length)
+          return;
+
+        epo->m_time = RTT::millis();
+        if (epo->m_state == EPO::SEND)
+          {
+            epo->m_state = EPO::ACK;
+            return;
+          }
+
+        /* Back in NMEA mode */
+        m_epo = NULL;
+        m_binary_length = 0;
+        epo->m_state = EPO::IDLE;
+        command_completed(722, epo->m_status);
+      }
+      break;
+
+    case EPO::ACK:
+      if (epo->m_result == EPO::RESULT_NONE &&
+          RTT::since(epo->m_time) < GPS_NMEA_MT3339_ACK_TIMEOUT)
+        return;
+      if (epo->m_result == EPO::RESULT_SUCCESS)
+        {
+          epo->m_packets++;
+          if (epo->m_sequence == 0xffff)
+            {
+              epo->m_status = STATUS_SUCCESS;
+              epo->m_state = EPO::NMEA;
+            }
+          else
+            {
+              epo->m_sequence++;
+              epo->m_state = EPO::SEND;
+            }
+          epo->prepare();
+        }
+      else if (epo->m_retries > 0)
+        {
+          epo->m_retries--;
+          epo->m_offset = 0;
+          epo->m_state = EPO::SEND;
+        }
+      else
+        {
+          epo->m_status = (epo->m_result == EPO::RESULT_NONE ?
+                           STATUS_TIMEOUT : STATUS_FAILED);
+          epo->m_state = EPO::NMEA;
+          epo->prepare();
+        }
+      epo->m_result = EPO::RESULT_NONE;
+      upload();
+      break;
+    }
+}
+
+bool
+GPS_NMEA_MT3339::receiver_baudrate(uint32_t rate)
+{
+  GPS_NMEA_Command length(NULL);
+  GPS_NMEA_Command out(m_device, m_tracing);
+
+
+  /* Not while the receiver is in binary mode */
+  if (m_epo != NULL)
+    return (false);
+
+  length.begin();
+  length.print_P(PSTR("PMTK251"));
+  length.field(rate);
+  length.end();
+  if (m_device->room() < length.length())
+    return (false);
+
+  out.begin();
+  out.print_P(PSTR("PMTK251"));
+  out.field(rate);
+  out.end();
+
+  return (true);
+}
+
+bool
+GPS_NMEA_MT3339::dump(Locus* locus)
+{
+  if (m_locus != NULL)
+    return (false);
+
+  locus->m_state = Locus::PREFIX;
+  locus->m_match = 0;
+  locus->m_time = RTT::millis();
+  m_locus = locus;
+  if (!command(GPS_NMEA_COMMAND("PMTK622,1")))
+    {
+      m_locus = NULL;
+      return (false);
+    }
+
+  return (true);
+}
+
+/* Data line prefix and its parity */
+static const char LOX[] __PROGMEM = "$PMTKLOX,1,";
+#define LOX_PARITY 0x68
+
+/* Value of hex digit, -1 if not a hex digit */
+static int8_t
+hex(char c)
+{
+  if (c >= '0' && c <= '9')
+    return (c - '0');
+  c |= 0x20;
+  if (c >= 'a' && c <= 'f')
+    return (c - 'a' + 10);
+  return (-1);
+}
+
+bool
+GPS_NMEA_MT3339::Locus::parse(char c)
+{
+  int8_t value;
+
+
+  switch (m_state)
+    {
+    case PREFIX:
+      /* Prefix is also seen by the NMEA parser */
+      if (c == (char) pgm_read_byte(&LOX[m_match]))
+        {
+          m_match++;
+          if (pgm_read_byte(&LOX[m_match]) == 0)
+            {
+              m_state = NUMBER;
+              m_match = 0;
+              m_parity = LOX_PARITY;
+              m_number = 0;
+            }
+        }
+      else
+        m_match = (c == '$');
+      return (false);
+
+    case NUMBER:
+      m_parity ^= c;
+      if (c >= '0' && c <= '9')
+        {
+          m_number = m_number * 10 + (c - '0');
+          return (true);
+        }
+      if (c == ',')
+        {
+          m_state = DATA;
+          m_length = 0;
+          m_nibbles = 0;
+          return (true);
+        }
+      break;
+
+    case DATA:
+      if (c == '*' && !(m_nibbles & 1))
+        {
+          m_state = CHECKSUM;
+          m_checksum = 0;
+          m_nibbles = 0;
+          return (true);
+        }
+      m_parity ^= c;
+      if (c == ',' && !(m_nibbles & 1))
+        return (true);
+      value = hex(c);
+      if (value < 0 || m_length == sizeof(m_data))
+        break;
+      if (m_nibbles++ & 1)
+        m_data[m_length++] |= value;
+      else
+        m_data[m_length] = value << 4;
+      return (true);
+
+    case CHECKSUM:
+      value = hex(c);
+      if (value < 0)
+        break;
+      m_checksum = (m_checksum << 4) | value;
+      if (++m_nibbles == 2)
+        {
+          m_state = PREFIX;
+          if (m_checksum == m_parity)
+            deliver();
+          else
+            m_errors++;
+        }
+      return (true);
+    }
+
+  /* Malformed line; left to the NMEA parser */
+  m_errors++;
+  m_state = PREFIX;
+  m_match = (c == '$');
+  return (false);
+}
+
+/* Little-endian 32-bit value */
+static uint32_t
+le32(const uint8_t* p)
+{
+  return (p[0] | ((uint32_t) p[1] << 8) |
+          ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+}
+
+void
+GPS_NMEA_MT3339::Locus::deliver()
+{
+  m_lines++;
+  m_time = RTT::millis();
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* Called in the Irq; records are passed from the event handler */
+  if (m_held)
+    {
+      m_errors++;
+      return;
+    }
+  memcpy(m_line, m_data, m_length);
+  m_line_length = m_length;
+  m_line_number = m_number;
+  m_held = true;
+  if (!Event::push(Event::USER_TYPE, this))
+    {
+      m_held = false;
+      m_errors++;
+    }
+#else
+  records(m_data, m_length, m_number);
+#endif
+}
+
+#ifdef GPS_INTERRUPT_IMPL
+void
+GPS_NMEA_MT3339::Locus::on_event(uint8_t type, uint16_t value)
+{
+  UNUSED(type);
+  UNUSED(value);
+
+  /* The line is not written while held */
+  records(m_line, m_line_length, m_line_number);
+  m_held = false;
+}
+#endif
+
+void
+GPS_NMEA_MT3339::Locus::records(const uint8_t* data, uint8_t length,
+                                uint16_t number)
+{
+  uint32_t offset = (uint32_t) number * LINE;
+
+
+  for (uint8_t i = 0; i + RECORD <= length; i += RECORD, offset += RECORD)
+    {
+      const uint8_t* p = &data[i];
+      uint8_t checksum = 0;
+      uint8_t erased = 0xff;
+      record_t record;
+
+      /* Skip sector headers and erased records */
+      if (offset % SECTOR < HEADER)
+        continue;
+      for (uint8_t j = 0; j < RECORD - 1; j++)
+        {
+          checksum ^= p[j];
+          erased &= p[j];
+        }
+      if (erased == 0xff && p[RECORD - 1] == 0xff)
+        continue;
+      if (checksum != p[RECORD - 1])
+        {
+#ifdef GPS_INTERRUPT_IMPL
+          synchronized
+#endif
+          {
+            m_errors++;
+          }
+          continue;
+        }
+
+      record.clock = le32(p);
+      record.fix = p[4];
+      record.latitude = micro(le32(p + 5));
+      record.longitude = micro(le32(p + 9));
+      record.height = p[13] | (p[14] << 8);
+      m_records++;
+      on_record(record);
+    }
+}
+
+int32_t
+GPS_NMEA_MT3339::Locus::micro(uint32_t bits)
+{
+  int16_t shift = 150 - ((bits >> 23) & 0xff);
+  uint64_t value;
+
+
+  /* Mantissa times 10^6, scaled by the exponent and rounded */
+  if (((bits >> 23) & 0xff) == 0 || shift > 63)
+    return (0);
+  value = ((bits & 0x7fffffUL) | 0x800000UL) * 1000000ULL;
+  if (shift > 0)
+    value = (value + (1ULL << (shift - 1))) >> shift;
+  else if (shift > -8)
+    value <<= -shift;
+  else
+    value = 0x7fffffff;
+  if (value > 0x7fffffff)
+    value = 0x7fffffff;
+
+  return ((bits & 0x80000000UL) ? -(int32_t) value : (int32_t) value);
+}
+
+void
+GPS_NMEA_MT3339::receive(uint8_t c)
+{
+  EPO* epo = m_epo;
+  uint8_t checksum = 0;
+  uint16_t sequence;
+
+
+  /* Synchronize on preamble 0x04 0x24 */
+  if ((m_binary_length == 0 && c != 0x04) ||
+      (m_binary_length == 1 && c != 0x24))
+    {
+      m_binary_length = (c == 0x04);
+      return;
+    }
+
+  m_binary[m_binary_length++] = c;
+  if (m_binary_length < sizeof(m_binary))
+    return;
+  m_binary_length = 0;
+
+  /* EPO acknowledge: length 12, command 2, sequence, result */
+  for (uint8_t i = 2; i < 9; i++)
+    checksum ^= m_binary[i];
+  if (m_binary[2] != 12 || m_binary[3] != 0 ||
+      m_binary[4] != 2 || m_binary[5] != 0 ||
+      m_binary[9] != checksum || epo->m_state != EPO::ACK)
+    return;
+
+  /* Handled by upload(), outside of interrupt handler */
+  sequence = m_binary[6] | (m_binary[7] << 8);
+  if (sequence == epo->m_sequence)
+    epo->m_result = m_binary[8];
+}
+
+void
+GPS_NMEA_MT3339::EPO::prepare()
+{
+  m_offset = 0;
+  m_retries = GPS_NMEA_MT3339_RETRIES;
+  m_result = RESULT_NONE;
+
+  if (m_state == SEND)
+    {
+      int n = m_source->read(m_data, DATA);
+
+      /* Data ends with sequence 0xffff and no records */
+      if (n <= 0)
+        {
+          m_sequence = 0xffff;
+          n = 0;
+        }
+      memset(m_data + n, 0, DATA - n);
+      m_length = 2 + 2 + 2 + 2 + DATA + 1 + 2;
+    }
+  else
+    m_length = 2 + 2 + 2 + 5 + 1 + 2;
+
+  m_checksum = 0;
+  for (uint8_t i = 2; i < m_length - 3; i++)
+    m_checksum ^= byte(i);
+}
+
+uint8_t
+GPS_NMEA_MT3339::EPO::byte(uint8_t index)
+{
+  uint16_t command = (m_state == NMEA ? 253 : 722);
+
+
+  /* Preamble, length, command, data, checksum, end */
+  switch (index)
+    {
+    case 0: return (0x04);
+    case 1: return (0x24);
+    case 2: return (m_length);
+    case 3: return (0);
+    case 4: return (command);
+    case 5: return (command >> 8);
+    }
+
+  if (index == m_length - 3)
+    return (m_checksum);
+  if (index == m_length - 2)
+    return ('\r');
+  if (index == m_length - 1)
+    return ('\n');
+
+  /* Switch to NMEA: mode 0, keep baudrate */
+  if (m_state == NMEA)
+    return (0);
+
+  /* EPO: sequence, records */
+  if (index == 6)
+    return (m_sequence);
+  if (index == 7)
+    return (m_sequence >> 8);
+
+  return (m_data[index - 8]);
+}
+
+void
+GPS_NMEA_MT3339::acknowledge(uint16_t command, uint8_t status)
+{
+  for (uint8_t i = 0; i < m_queued; i++)
+    {
+      command_t* entry = &m_queue[i];
+
+      if (!entry->sent || entry->number != command)
+        continue;
+
+      if ((status == STATUS_UNSUPPORTED || status == STATUS_FAILED) &&
+          entry->retries > 0)
+        {
+          entry->retries--;
+          entry->sent = false;
+          entry->time = RTT::millis();
+        }
+      else
+        complete(i, status);
+      break;
+    }
+}
+
+void
+GPS_NMEA_MT3339::complete(uint8_t index, uint8_t status)
+{
+  uint16_t command = m_queue[index].number;
+
+
+  m_queued--;
+  for (uint8_t i = index; i < m_queued; i++)
+    m_queue[i] = m_queue[i + 1];
+
+  /* Aiding is used once; drop when the last aiding command is done */
+  if (command == 740 || command == 741)
+    {
+      uint8_t i = 0;
+      while (i < m_queued &&
+             m_queue[i].number != 740 && m_queue[i].number != 741)
+        i++;
+      if (i == m_queued)
+        m_assist_clock = 0;
+    }
+
+  if (command == 622)
+    m_locus = NULL;
+
+  if (command == 161 && m_ending)
+    {
+      // standby; doesn't matter if it succeeded or not
+      reset();
+      GPS_NMEA::end();
+    }
+  else if (command == 161 && m_health == HEALTH_WAKE)
+    {
+      // recovery standby; wake regardless
+      queue(COMMAND_WAKE, NULL, 0, 0);
+    }
+
+  command_completed(command, status);
+}
+
+void
+GPS_NMEA_MT3339::monitor_restart()
+{
+  uint32_t now = RTT::millis();
+
+
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+  {
+    m_health_start = now;
+    m_health_sentence = now;
+    m_health_max_gap = 0;
+    m_health_sentences = 0;
+    m_health_failed = 0;
+  }
+  m_health_commits_start = commits();
+  m_health_timeouts_start = epoch_timeouts();
+  m_health_resyncs_start = resyncs();
+  m_health_hunting = hunting();
+}
+
+void
+GPS_NMEA_MT3339::monitor()
+{
+  uint32_t now = RTT::millis();
+  uint32_t gap;
+  uint16_t sentences;
+  uint16_t failed;
+  uint16_t expected;
+  uint16_t commits;
+  bool lost;
+
+
+  if (now - m_health_start < GPS_NMEA_MT3339_HEALTH_WINDOW)
+    return;
+
+  /* Not while ending, or while the receiver has no NMEA output */
+  if (!m_active || m_ending || m_epo != NULL || m_locus != NULL)
+    {
+      monitor_restart();
+      return;
+    }
+
+  /* Baud rate detection locked within the window; a step now would
+   * only lose the rate again, the next window is judged instead */
+  if (!hunting() &&
+      (m_health_hunting || resyncs() != m_health_resyncs_start))
+    {
+      monitor_restart();
+      return;
+    }
+
+  /* Window statistics; gap still open counts */
+#ifdef GPS_INTERRUPT_IMPL
+  synchronized
+#endif
+  {
+    gap = now - m_health_sentence;
+    if (gap < m_health_max_gap)
+      gap = m_health_max_gap;
+    sentences = m_health_sentences;
+    failed = m_health_failed;
+  }
+  commits = this->commits() - m_health_commits_start;
+  lost = (epoch_timeouts() != m_health_timeouts_start);
+  monitor_restart();
+
+  m_health_gap = (gap > 0xffff ? 0xffff : gap);
+  expected = GPS_NMEA_MT3339_HEALTH_WINDOW / m_rate;
+  if (expected == 0 || commits >= expected)
+    m_health_commits = 100;
+  else
+    m_health_commits = (commits * 100) / expected;
+  if (failed == 0)
+    m_health_errors = 0;
+  else
+    m_health_errors = ((uint32_t) failed * 100) / (sentences + failed);
+
+  /* Healthy; recovered if a step was taken */
+  if (gap <= GPS_NMEA_MT3339_HEALTH_GAP &&
+      !(lost && m_health_commits < GPS_NMEA_MT3339_HEALTH_COMMITS) &&
+      m_health_errors <= GPS_NMEA_MT3339_HEALTH_ERRORS)
+    {
+      if (m_health != HEALTH_OK)
+        {
+          m_recoveries++;
+          m_recovery_time = now - m_health_lost;
+          m_recovered_by = m_health;
+          m_health = HEALTH_OK;
+        }
+      return;
+    }
+
+  /* Escalate one step per unhealthy window */
+  if (m_health == HEALTH_OK)
+    m_health_lost = now - GPS_NMEA_MT3339_HEALTH_WINDOW;
+  else if (m_health == HEALTH_FACTORY_RESET)
+    return;
+
+  switch (++m_health)
+    {
+    case HEALTH_RESYNC:
+      resync();
+      m_health_resyncs_start = resyncs();
+      m_health_hunting = hunting();
+      break;
+
+    case HEALTH_SELECT:
+      select_sentences();
+      if (m_rate != 1000)
+        rate(m_rate);
+      break;
+
+    case HEALTH_WAKE:
+      /* Wake is queued when standby completes */
+      command(GPS_NMEA_COMMAND("PMTK161,0"));
+      break;
+
+    case HEALTH_FACTORY_RESET:
+      factory_reset();
+      break;
+    }
+}
+
+void
+GPS_NMEA_MT3339::command_completed(uint16_t command, uint8_t status)
+{
+  UNUSED(command);
+  UNUSED(status);
+
+  /* May be implemented by subsclasses */
+}
+
+void
+GPS_NMEA_MT3339::assist(clock_t now, const GPS::fix_t* fix)
+{
+  m_assist_clock = now;
+  m_assist_time = RTT::millis();
+#ifndef GPS_TIME_ONLY
+  m_assist_position = (fix != NULL);
+  if (fix != NULL)
+    {
+      m_assist_latitude = fix->latitude;
+      m_assist_longitude = fix->longitude;
+      m_assist_altitude = fix->altitude;
+    }
+#else
+  UNUSED(fix);
+#endif
+}
+
+void
+GPS_NMEA_MT3339::generate(GPS_NMEA_Command& cmd, uint16_t command)
+{
+  /* Aiding; PMTK741 is position followed by time, as PMTK740 */
+  if (command != 740 && command != 741)
+    return;
+
+#ifndef GPS_TIME_ONLY
+  if (command == 741)
+    {
+      cmd.field(m_assist_latitude, 6);
+      cmd.field(m_assist_longitude, 6);
+      cmd.field(m_assist_altitude / 100);
+    }
+#endif
+
+  /* Fields are fixed width; measured and written length match */
+  time_t now(m_assist_clock + RTT::since(m_assist_time) / 1000);
+  cmd.field(2000 + now.year, 0, 4);
+  cmd.field(now.month, 0, 2);
+  cmd.field(now.date, 0, 2);
+  cmd.field(now.hours, 0, 2);
+  cmd.field(now.minutes, 0, 2);
+  cmd.field(now.seconds, 0, 2);
 }
 
 void
 GPS_NMEA_MT3339::select_sentences(void)
 {
-  //  send_cmd(PSTR("$PMTK605*31"));  // query release and version
+  //  command(GPS_NMEA_COMMAND("PMTK605"));  // query release and version
 
   /*
    * Set the desired sentences..
@@ -213,13 +1270,16 @@ GPS_NMEA_MT3339::select_sentences(void)
    * 5 NMEA_SEN_GSV
    * 6-17 reserved
    * 18 NMEA_SEN_MCHN
+   *
+   * Enabled are those parsed by GPS_NMEA as compiled.
    */
 
-#ifndef GPS_TIME_ONLY
-  send_cmd(PSTR("$PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*28"));
-#else
-  send_cmd(PSTR("$PMTK314,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0*29"));
-#endif
+  command(GPS_NMEA_COMMAND("PMTK314,0,"
+                           GPS_NMEA_SENTENCE_RMC ",0,"
+                           GPS_NMEA_SENTENCE_GGA ","
+                           GPS_NMEA_SENTENCE_GSA ","
+                           GPS_NMEA_SENTENCE_GSV
+                           ",0,0,0,0,0,0,0,0,0,0,0,0,0"));
 }
 
 IOStream&
@@ -21,14 +21,309 @@
 #define COSA_GPS_NMEA_MT3339_HH
 
 #include "GPS_NMEA.hh"
+#include "GPS_NMEA_Command.hh"
+
+#define GPS_NMEA_MT3339_COMMANDS 4
+#define GPS_NMEA_MT3339_RETRIES 2
+#define GPS_NMEA_MT3339_ACK_TIMEOUT 1000
+
+/* Health monitor; evaluation window and longest gap between sentences
+ * in milliseconds, minimum commits in percent of the fix rate while
+ * epochs are lost, maximum checksum errors in percent of sentences */
+#define GPS_NMEA_MT3339_HEALTH_WINDOW 5000
+#define GPS_NMEA_MT3339_HEALTH_GAP 3000
+#define GPS_NMEA_MT3339_HEALTH_COMMITS 50
+#define GPS_NMEA_MT3339_HEALTH_ERRORS 10
 
 
 /**
  * GPS NMEA MT3339
+ *
+ * PMTK commands are queued and transmitted without blocking as the
+ * device output buffer has room. Several commands may be in flight;
+ * PMTK001 acknowledgements are matched by command number, failed
+ * (status 1/2) or unacknowledged commands are retried and completion
+ * is reported through command_completed().
+ *
+ * Startup can be aided with the current time and last known position
+ * (see assist() and GPS_Storage) so that the receiver hot starts, and
+ * with EPO orbit prediction data (see upload()) to shorten TTFF further.
+ *
+ * The LOCUS logger records fixes in the receiver flash while the host
+ * sleeps; see locus_start() and dump().
+ *
+ * The stream is checked every GPS_NMEA_MT3339_HEALTH_WINDOW for gaps
+ * between sentences, lost epochs and checksum errors. Each unhealthy
+ * window escalates recovery one step (see health()). A window in which
+ * baud rate detection (see detect()) locked on a rate is not judged.
  */
 
 class GPS_NMEA_MT3339 : public GPS_NMEA {
 public:
+  /* PMTK001 status, and local completion status */
+  enum {
+    STATUS_INVALID = 0,
+    STATUS_UNSUPPORTED = 1,
+    STATUS_FAILED = 2,
+    STATUS_SUCCESS = 3,
+    STATUS_CANCELLED = 254,     // dropped by reset()
+    STATUS_TIMEOUT = 255
+  };
+
+  /* Health, as the recovery step taken; HEALTH_OK when healthy */
+  enum {
+    HEALTH_OK,
+    HEALTH_RESYNC,              // parser resynchronized (see resync())
+    HEALTH_SELECT,              // sentences and fix rate selected again
+    HEALTH_WAKE,                // standby and wake
+    HEALTH_FACTORY_RESET        // last resort; no further steps
+  };
+
+  /**
+   * EPO (Extended Prediction Orbit) upload. Holds the packet being
+   * transferred so that it can be retransmitted; allocate only while
+   * uploading.
+   */
+  class EPO {
+  public:
+    /* EPO satellite records (60 bytes) per packet */
+    static const uint8_t RECORDS = 3;
+    static const uint8_t DATA = RECORDS * 60;
+
+    /* Upload state */
+    enum {
+      IDLE,                     // not started or done
+      BINARY,                   // switching receiver to binary mode
+      SEND,                     // writing packet
+      ACK,                      // waiting for packet acknowledge
+      NMEA                      // switching receiver back to NMEA
+    };
+
+    /**
+     * Construct upload reading EPO records from source, e.g. a file
+     * or external flash.
+     * @param[in] source of EPO data
+     */
+    EPO(IOStream::Device* source) :
+      m_source(source),
+      m_state(IDLE),
+      m_status(STATUS_INVALID),
+      m_packets(0)
+    {}
+
+    /**
+     * Get upload state
+     * @return state
+     */
+    uint8_t state()
+      __attribute__((always_inline))
+    {
+      return (m_state);
+    }
+
+    /**
+     * Get completion status, valid when state is IDLE after upload
+     * @return STATUS_SUCCESS, STATUS_FAILED or STATUS_TIMEOUT
+     */
+    uint8_t status()
+      __attribute__((always_inline))
+    {
+      return (m_status);
+    }
+
+    /**
+     * Get number of packets acknowledged
+     * @return packets
+     */
+    uint16_t packets()
+      __attribute__((always_inline))
+    {
+      return (m_packets);
+    }
+
+  protected:
+    IOStream::Device* m_source;
+    GPS_VOLATILE uint8_t m_state;
+    GPS_VOLATILE uint8_t m_status;
+    GPS_VOLATILE uint16_t m_packets;
+
+    /* Packet acknowledge result */
+    enum {
+      RESULT_FAILED = 0,
+      RESULT_SUCCESS = 1,
+      RESULT_NONE = 0xff
+    };
+    GPS_VOLATILE uint8_t m_result;
+
+    /* Current packet */
+    uint16_t m_sequence;
+    uint8_t m_data[DATA];
+    uint8_t m_length;
+    uint8_t m_offset;
+    uint8_t m_checksum;
+    uint8_t m_retries;
+    uint32_t m_time;
+
+    /* Prepare packet; EPO data when sending, else NMEA mode switch */
+    void prepare();
+
+    /* Get byte of current binary packet */
+    uint8_t byte(uint8_t index);
+
+    friend class GPS_NMEA_MT3339;
+  };
+
+  /**
+   * LOCUS dump (PMTK622). The $PMTKLOX data lines are decoded from hex
+   * as they are received, bypassing the NMEA field parser, and records
+   * with a valid checksum are passed to on_record(). Subclass and
+   * implement on_record(); allocate only while dumping.
+   *
+   * With GPS_INTERRUPT_IMPL lines are received in the interrupt handler
+   * and on_record() is called from the event handler, as listeners are.
+   * A line is held until its event is dispatched; a line completed
+   * while the previous one is still held is dropped and counted as an
+   * error. The dump may be reported completed before the records of
+   * its last line are passed.
+   */
+  class Locus : public Event::Handler {
+  public:
+    /* Logged record (basic content) */
+    struct record_t {
+      clock_t clock;            // seconds since Epoch
+      uint8_t fix;              // fix type
+      int32_t latitude;         // millionths of a degree
+      int32_t longitude;        // millionths of a degree
+      int16_t height;           // meters
+    };
+
+    /* Flash layout; data line, sector and sector header size */
+    static const uint8_t LINE = 96;
+    static const uint16_t SECTOR = 4096;
+    static const uint8_t HEADER = 64;
+    static const uint8_t RECORD = 16;
+
+    /**
+     * Construct dump.
+     */
+    Locus() :
+      m_state(PREFIX),
+      m_match(0),
+      m_total(0),
+      m_lines(0),
+      m_records(0),
+      m_errors(0)
+#ifdef GPS_INTERRUPT_IMPL
+      ,
+      m_held(false)
+#endif
+    {}
+
+    /**
+     * Called with each valid record, in flash order; from the event
+     * handler with GPS_INTERRUPT_IMPL.
+     * @param[in] record
+     */
+    virtual void on_record(const record_t& record) = 0;
+
+    /**
+     * Get number of data lines announced by the receiver
+     * @return lines, 0 until announced
+     */
+    uint16_t total()
+      __attribute__((always_inline))
+    {
+      return (m_total);
+    }
+
+    /**
+     * Get number of data lines received with valid checksum
+     * @return lines
+     */
+    uint16_t lines()
+      __attribute__((always_inline))
+    {
+      return (m_lines);
+    }
+
+    /**
+     * Get number of records passed to on_record()
+     * @return records
+     */
+    uint16_t records()
+      __attribute__((always_inline))
+    {
+      return (m_records);
+    }
+
+    /**
+     * Get number of malformed lines and records with wrong checksum
+     * @return errors
+     */
+    uint16_t errors()
+      __attribute__((always_inline))
+    {
+      return (m_errors);
+    }
+
+    /**
+     * Convert IEEE 754 single precision value in degrees, as logged,
+     * to millionths of a degree without floating point.
+     * @param[in] bits of float
+     * @return millionths of a degree
+     */
+    static int32_t micro(uint32_t bits);
+
+  protected:
+    /* Line parser state */
+    enum {
+      PREFIX,                   // matching "$PMTKLOX,1,"
+      NUMBER,                   // line number
+      DATA,                     // hex data words
+      CHECKSUM                  // hex checksum
+    };
+
+    GPS_VOLATILE uint8_t m_state;
+    GPS_VOLATILE uint8_t m_match;
+    GPS_VOLATILE uint8_t m_parity;
+    GPS_VOLATILE uint8_t m_nibbles;
+    GPS_VOLATILE uint8_t m_checksum;
+    GPS_VOLATILE uint16_t m_number;
+    GPS_VOLATILE uint32_t m_time;
+
+    /* Current line */
+    uint8_t m_data[LINE];
+    GPS_VOLATILE uint8_t m_length;
+
+    /* Statistics */
+    GPS_VOLATILE uint16_t m_total;
+    GPS_VOLATILE uint16_t m_lines;
+    GPS_VOLATILE uint16_t m_records;
+    GPS_VOLATILE uint16_t m_errors;
+
+#ifdef GPS_INTERRUPT_IMPL
+    /* Line held for the event handler */
+    uint8_t m_line[LINE];
+    uint8_t m_line_length;
+    uint16_t m_line_number;
+    volatile bool m_held;
+
+    /* Pass records of the held line */
+    virtual void on_event(uint8_t type, uint16_t value);
+#endif
+
+    /* Parse character; true if consumed by a data line */
+    bool parse(char c);
+
+    /* Complete line received */
+    void deliver();
+
+    /* Pass records of given line */
+    void records(const uint8_t* data, uint8_t length, uint16_t number);
+
+    friend class GPS_NMEA_MT3339;
+  };
+
   /**
    * Construct GPS_NMEA_MT3339
    */
@@ -59,10 +354,276 @@ public:
    */
   virtual void factory_reset();
 
+#ifndef GPS_INTERRUPT_IMPL
+  using GPS_NMEA::consume;
+  virtual uint16_t consume(uint16_t budget);
+  virtual void feedchar(char c);
+  virtual void feed(const char* buf, size_t size);
+#endif
+
+  /**
+   * Queue constant command for transmission, e.g.
+   * command(GPS_NMEA_COMMAND("PMTK161,0")).
+   * @param[in] cmd constant command
+   * @return true if queued, false if queue full
+   */
+  bool command(const GPS_NMEA_Command::constant_t& cmd);
+
+  /**
+   * Queue command with a single numeric field, e.g.
+   * command(PSTR("PMTK220"), 200).
+   * @param[in] body command name in program memory
+   * @param[in] value field
+   * @return true if queued, false if queue full
+   */
+  bool command(str_P body, int32_t value);
+
+  /**
+   * Queue command whose fields are written by generate() when it is
+   * transmitted.
+   * @param[in] body command name in program memory
+   * @return true if queued, false if queue full
+   */
+  bool command(str_P body);
+
+  /**
+   * Set position fix interval (PMTK220).
+   * @param[in] ms interval in milliseconds (100..10000)
+   * @return true if queued, false if out of range or queue full
+   */
+  bool rate(uint16_t ms);
+
+  /**
+   * Aid the next begin() with current time (PMTK740) and, in full
+   * builds, last known position (PMTK741) so that the receiver can hot
+   * start.
+   * @param[in] now current time, e.g. from an RTC
+   * @param[in] fix last known fix, e.g. from GPS_Storage::load(), or NULL
+   */
+  void assist(clock_t now, const GPS::fix_t* fix = NULL);
+
+  /**
+   * Start EPO upload. The receiver is switched to binary mode (PMTK253)
+   * and EPO data is transferred in packets as the device has room, each
+   * acknowledged before the next is sent. Queued commands are held
+   * until the receiver is back in NMEA mode. Completion is reported
+   * through command_completed() as command 722.
+   * @param[in] epo upload, kept until completed
+   * @return true if started, false if an upload is in progress
+   */
+  bool upload(EPO* epo);
+
+  /**
+   * Start LOCUS logging (PMTK185).
+   * @return true if queued
+   */
+  bool locus_start()
+  {
+    return (command(GPS_NMEA_COMMAND("PMTK185,0")));
+  }
+
+  /**
+   * Stop LOCUS logging (PMTK185).
+   * @return true if queued
+   */
+  bool locus_stop()
+  {
+    return (command(GPS_NMEA_COMMAND("PMTK185,1")));
+  }
+
+  /**
+   * Set LOCUS logging interval (PMTK187).
+   * @param[in] seconds between records
+   * @return true if queued
+   */
+  bool locus_interval(uint16_t seconds)
+  {
+    return (command(PSTR("PMTK187,1"), seconds));
+  }
+
+  /**
+   * Erase LOCUS flash (PMTK184).
+   * @return true if queued
+   */
+  bool locus_erase()
+  {
+    return (command(GPS_NMEA_COMMAND("PMTK184,1")));
+  }
+
+  /**
+   * Query LOCUS status (PMTK183); the $PMTKLOG reply updates
+   * locus_logging(), locus_records() and locus_used().
+   * @return true if queued
+   */
+  bool locus_query()
+  {
+    return (command(GPS_NMEA_COMMAND("PMTK183")));
+  }
+
+  /**
+   * Is LOCUS logging (latest $PMTKLOG)?
+   * @return logging
+   */
+  bool locus_logging()
+    __attribute__((always_inline))
+  {
+    return (m_locus_logging);
+  }
+
+  /**
+   * Get number of LOCUS records logged (latest $PMTKLOG)
+   * @return records
+   */
+  uint16_t locus_records()
+    __attribute__((always_inline))
+  {
+    return (m_locus_records);
+  }
+
+  /**
+   * Get LOCUS flash used (latest $PMTKLOG)
+   * @return percent
+   */
+  uint8_t locus_used()
+    __attribute__((always_inline))
+  {
+    return (m_locus_used);
+  }
+
+  /**
+   * Start LOCUS dump (PMTK622). Completion is reported through
+   * command_completed() as command 622.
+   * @param[in] locus dump, kept until completed
+   * @return true if started, false if a dump is in progress or the
+   *   command queue is full
+   */
+  bool dump(Locus* locus);
+
+  /**
+   * Transmit queued commands as the device has room and handle
+   * acknowledgements and their timeouts, and check health. Called from
+   * consume(); with GPS_INTERRUPT_IMPL it should be called
+   * periodically, outside of the interrupt handler, which only records
+   * acknowledgements. Health recovery is only taken from here.
+   */
+  void transmit();
+
+  /**
+   * Get health, the recovery step taken while unhealthy.
+   * @return HEALTH_*
+   */
+  uint8_t health()
+    __attribute__((always_inline))
+  {
+    return (m_health);
+  }
+
+  /**
+   * Get longest gap between valid sentences in the latest window.
+   * @return milliseconds
+   */
+  uint16_t sentence_gap()
+    __attribute__((always_inline))
+  {
+    return (m_health_gap);
+  }
+
+  /**
+   * Get commits in the latest window in percent of the fix rate.
+   * @return percent
+   */
+  uint8_t commit_ratio()
+    __attribute__((always_inline))
+  {
+    return (m_health_commits);
+  }
+
+  /**
+   * Get checksum errors in the latest window in percent of sentences.
+   * @return percent
+   */
+  uint8_t error_ratio()
+    __attribute__((always_inline))
+  {
+    return (m_health_errors);
+  }
+
+  /**
+   * Get number of recoveries.
+   * @return recoveries
+   */
+  uint16_t recoveries()
+    __attribute__((always_inline))
+  {
+    return (m_recoveries);
+  }
+
+  /**
+   * Get time taken by the latest recovery, from the first unhealthy
+   * window to the first healthy one.
+   * @return milliseconds, 0 if none
+   */
+  uint32_t recovery_time()
+    __attribute__((always_inline))
+  {
+    return (m_recovery_time);
+  }
+
+  /**
+   * Get recovery step that preceded the latest recovery.
+   * @return HEALTH_*
+   */
+  uint8_t recovered_by()
+    __attribute__((always_inline))
+  {
+    return (m_recovered_by);
+  }
+
+  /**
+   * Get number of queued and unacknowledged commands
+   * @return commands
+   */
+  uint8_t pending()
+    __attribute__((always_inline))
+  {
+    return (m_queued);
+  }
+
 protected:
   virtual void field(uint8_t field_number, char* new_field);
   virtual void sentence(bool valid);
 
+  /**
+   * Switch receiver rate (PMTK251). Written directly, ahead of queued
+   * commands, as the device rate changes next; not acknowledged.
+   * @param[in] rate
+   * @return true if written
+   */
+  virtual bool receiver_baudrate(uint32_t rate);
+
+#ifdef GPS_INTERRUPT_IMPL
+  virtual int putchar(char c);
+#endif
+
+  /**
+   * Called when a queued command has completed, successfully or not.
+   * May be implemented by subclasses.
+   * @param[in] command number (0 for commands without number)
+   * @param[in] status STATUS_SUCCESS, PMTK001 status, STATUS_TIMEOUT or
+   *   STATUS_CANCELLED
+   */
+  virtual void command_completed(uint16_t command, uint8_t status);
+
+  /**
+   * Write fields of a command queued with command(body). Called to
+   * measure and again to transmit the sentence, so the output length
+   * must not change in between. May be implemented by subclasses;
+   * pass commands not generated by the subclass on to this method.
+   * @param[in] cmd command writer; use cmd.field()
+   * @param[in] command number
+   */
+  virtual void generate(GPS_NMEA_Command& cmd, uint16_t command);
+
   /**
    * Print latest gps_nmea_mtk information to
    * given stream.
@@ -77,7 +638,9 @@ private:
   enum sentence_t {
     SENTENCE_UNKNOWN,
     SENTENCE_ACK,
-    SENTENCE_VERSION
+    SENTENCE_VERSION,
+    SENTENCE_LOG,
+    SENTENCE_LOX
   } __attribute__((packed));
 
   GPS_VOLATILE sentence_t m_sentence;
@@ -89,7 +652,119 @@ private:
 
   GPS_VOLATILE bool m_first_sentence_received;
   GPS_VOLATILE bool m_ending;
-  void send_cmd(str_P);
+
+  /* Kind of queued command */
+  enum {
+    COMMAND_WAKE,
+    COMMAND_CONSTANT,
+    COMMAND_VALUE,
+    COMMAND_GENERATED
+  };
+
+  /* Queued command */
+  struct command_t {
+    str_P body;
+    int32_t value;
+    uint16_t number;
+    uint8_t checksum;
+    uint8_t kind;
+    uint8_t retries;
+    bool sent;
+    uint32_t time;
+  };
+
+  /* Command queue in transmission order */
+  command_t m_queue[GPS_NMEA_MT3339_COMMANDS];
+  GPS_VOLATILE uint8_t m_queued;
+
+  /* Add command to queue */
+  bool queue(uint8_t kind, str_P body, uint8_t checksum, int32_t value);
+
+  /* Write queued command, or count its length if device is NULL */
+  void write(GPS_NMEA_Command& out, command_t* entry);
+
+  /* Remove queued command and report completion */
+  void complete(uint8_t index, uint8_t status);
+
+  /* Match PMTK001 to queued command */
+  void acknowledge(uint16_t command, uint8_t status);
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* PMTK001 received in the interrupt handler, for transmit() */
+  struct ack_t {
+    uint16_t command;
+    uint8_t status;
+  };
+  ack_t m_ack[GPS_NMEA_MT3339_COMMANDS];
+  volatile uint8_t m_acks;
+
+  /* First sentence received; select_sentences() from transmit() */
+  volatile bool m_select;
+#endif
+
+  /* LOCUS status */
+  GPS_VOLATILE bool m_locus_logging;
+  GPS_VOLATILE uint16_t m_locus_records;
+  GPS_VOLATILE uint8_t m_locus_used;
+
+  /* LOCUS dump in progress */
+  Locus* m_locus;
+
+  /* EPO upload in progress, binary packet received */
+  EPO* m_epo;
+  uint8_t m_binary[12];
+  uint8_t m_binary_length;
+
+  /* Progress EPO upload; called from send() */
+  void upload();
+
+  /* Handle byte received during EPO upload */
+  void receive(uint8_t c);
+
+  /* Startup aiding, m_assist_clock zero if none */
+  clock_t m_assist_clock;
+  uint32_t m_assist_time;
+#ifndef GPS_TIME_ONLY
+  bool m_assist_position;
+  GPS::position_t m_assist_latitude;
+  GPS::position_t m_assist_longitude;
+  GPS::altitude_t m_assist_altitude;
+#endif
+
+  /* Fix interval (PMTK220), milliseconds */
+  uint16_t m_rate;
+
+  /* Health; window start, sentence statistics of window */
+  uint8_t m_health;
+  uint32_t m_health_start;
+  uint32_t m_health_lost;
+  GPS_VOLATILE uint32_t m_health_sentence;
+  GPS_VOLATILE uint16_t m_health_max_gap;
+  GPS_VOLATILE uint16_t m_health_sentences;
+  GPS_VOLATILE uint16_t m_health_failed;
+  uint16_t m_health_commits_start;
+  uint16_t m_health_timeouts_start;
+  uint16_t m_health_resyncs_start;
+  bool m_health_hunting;
+
+  /* Latest window and recovery metrics */
+  uint16_t m_health_gap;
+  uint8_t m_health_commits;
+  uint8_t m_health_errors;
+  uint16_t m_recoveries;
+  uint32_t m_recovery_time;
+  uint8_t m_recovered_by;
+
+  /* Evaluate health window and escalate; called from transmit() only,
+   * as recovery queues commands */
+  void monitor();
+
+  /* Write queued commands, retry and time out; progress EPO upload */
+  void send();
+
+  /* Start health window */
+  void monitor_restart();
+
   void select_sentences();
 };
 #endif
@@ -0,0 +1,452 @@
+/**
+ * @file ?/GPS_NMEA_MT3339_Emulator.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "Cosa/RTT.hh"
+
+#include "GPS_NMEA_MT3339_Emulator.hh"
+
+/* Longest sentence generated, with CRLF */
+#define SENTENCE_MAX 82
+
+GPS_NMEA_MT3339_Emulator::GPS_NMEA_MT3339_Emulator(clock_t now) :
+  m_generator(now),
+  m_start(RTT::millis()),
+  m_epoch(0xffffffffUL),
+  m_ack_delay(50),
+  m_faults(0),
+  m_probability(0),
+  m_standby(false),
+  m_baudrate(0),
+  m_device_baudrate(0),
+  m_acks(0),
+  m_length(0),
+  m_binary(false),
+  m_packet_checksum(0),
+  m_packet_valid(false),
+  m_binary_ack(false),
+  m_binary_ack_sequence(0),
+  m_binary_ack_result(0),
+  m_binary_ack_time(0),
+  m_commands(0),
+  m_restarts(0),
+  m_epo_packets(0),
+  m_random(0xace1)
+{
+}
+
+void
+GPS_NMEA_MT3339_Emulator::faults(uint8_t faults, uint8_t probability)
+{
+  m_faults = faults;
+  m_probability = probability;
+  m_generator.errors((faults & FAULT_CHECKSUM) ?
+                     GPS_NMEA_Generator::ERROR_CHECKSUM : 0,
+                     probability);
+}
+
+uint16_t
+GPS_NMEA_MT3339_Emulator::random()
+{
+  /* xorshift */
+  m_random ^= m_random << 7;
+  m_random ^= m_random >> 9;
+  m_random ^= m_random << 8;
+  return (m_random);
+}
+
+bool
+GPS_NMEA_MT3339_Emulator::fault(uint8_t fault)
+{
+  return ((m_faults & fault) && (random() & 0xff) < m_probability);
+}
+
+int
+GPS_NMEA_MT3339_Emulator::available()
+{
+  generate();
+  return (m_output.available());
+}
+
+int
+GPS_NMEA_MT3339_Emulator::getchar()
+{
+  int c;
+
+
+  generate();
+  c = m_output.getchar();
+  if (c != IOStream::EOF && garbled())
+    c = (c ^ random()) & 0xff;
+
+  return (c);
+}
+
+int
+GPS_NMEA_MT3339_Emulator::room()
+{
+  /* Binary packets are checked as they stream in */
+  if (m_binary)
+    return (sizeof(m_line));
+
+  return (sizeof(m_line) - m_length);
+}
+
+int
+GPS_NMEA_MT3339_Emulator::putchar(char c)
+{
+  if (garbled())
+    return (c);
+
+  if (m_binary)
+    {
+      receive(c);
+      return (c);
+    }
+
+  /* Any character wakes from standby, except end of the command */
+  if (m_standby && c != '\n')
+    {
+      m_standby = false;
+      restart(0);
+    }
+
+  switch (c)
+    {
+    case '$':
+      m_length = 0;
+      m_line[m_length++] = c;
+      break;
+
+    case '\r':
+    case '\n':
+      if (m_length != 0)
+        {
+          m_line[m_length] = 0;
+          command();
+        }
+      m_length = 0;
+      break;
+
+    default:
+      if (m_length != 0 && m_length < sizeof(m_line) - 1)
+        m_line[m_length++] = c;
+    }
+
+  return (c);
+}
+
+void
+GPS_NMEA_MT3339_Emulator::command()
+{
+  char* p = m_line + 1;
+  uint8_t parity = 0;
+  uint16_t number;
+
+
+  /* $PMTKnnn,...*hh */
+  while (*p != 0 && *p != '*')
+    parity ^= *p++;
+  if (*p != '*' || strtoul(p + 1, NULL, 16) != parity)
+    return;
+  if (strncmp(m_line + 1, "PMTK", 4) != 0)
+    return;
+  m_commands++;
+
+  number = strtoul(m_line + 5, &p, 10);
+
+  switch (number)
+    {
+    case 101:
+    case 102:
+    case 103:
+    case 104:
+      /* Restarts are not acknowledged */
+      restart(number);
+      return;
+
+    case 161:
+      acknowledge(number, 3);
+      m_standby = true;
+      return;
+
+    case 220:
+      {
+        uint32_t rate = (*p == ',' ? strtoul(p + 1, NULL, 10) : 0);
+        if (rate < 100 || rate > 10000)
+          {
+            acknowledge(number, 2);
+            return;
+          }
+        m_generator.rate(rate);
+      }
+      break;
+
+    case 314:
+      {
+        /* GLL,RMC,VTG,GGA,GSA,GSV,... or -1 for default */
+        static const uint8_t field[] = {
+          0,
+          GPS_NMEA_Generator::SENTENCE_RMC,
+          0,
+          GPS_NMEA_Generator::SENTENCE_GGA,
+          GPS_NMEA_Generator::SENTENCE_GSA,
+          GPS_NMEA_Generator::SENTENCE_GSV
+        };
+        uint8_t sentences = 0;
+
+        if (strncmp(p, ",-1", 3) == 0)
+          sentences = GPS_NMEA_Generator::SENTENCE_DEFAULT;
+        else
+          for (uint8_t i = 0; i < sizeof(field) && *p == ','; i++)
+            if (strtol(p + 1, &p, 10) != 0)
+              sentences |= field[i];
+        m_generator.sentences(sentences);
+      }
+      break;
+
+    case 251:
+      /* Switched at once, not acknowledged */
+      m_baudrate = (*p == ',' ? strtoul(p + 1, NULL, 10) : 0);
+      return;
+
+    case 605:
+      {
+        GPS_NMEA_Command out(&m_output);
+
+        acknowledge(number, 3);
+        out.begin();
+        out.print_P(PSTR("PMTK705,AXN_2.10_3339_EMULATOR,0001,PA6H,1.0"));
+        out.end();
+      }
+      return;
+
+    case 253:
+      /* Binary mode, no acknowledgement; output stops */
+      if (*p != ',' || strtoul(p + 1, NULL, 10) != 1)
+        {
+          acknowledge(number, 2);
+          return;
+        }
+      m_binary = true;
+      m_binary_ack = false;
+      m_length = 0;
+      m_acks = 0;
+      m_output.empty();
+      return;
+
+    case 740:
+    case 741:
+      break;
+
+    default:
+      acknowledge(number, 1);
+      return;
+    }
+
+  acknowledge(number, 3);
+}
+
+void
+GPS_NMEA_MT3339_Emulator::receive(uint8_t c)
+{
+  uint8_t length;
+
+
+  /* Synchronize on preamble 0x04 0x24; a 0x04 out of place starts a
+   * new packet */
+  if ((m_length == 0 && c != 0x04) || (m_length == 1 && c != 0x24))
+    {
+      m_length = 0;
+      if (c != 0x04)
+        return;
+    }
+  if (m_length == 0)
+    {
+      m_packet_checksum = 0;
+      m_packet_valid = true;
+    }
+  if (m_length < sizeof(m_line))
+    m_line[m_length] = c;
+
+  /* Length, command and data are checksummed; then checksum, CR LF */
+  length = (m_length < 4 ? 0xff : (uint8_t) m_line[2]);
+  if (m_length >= 4 && (m_line[3] != 0 || length < 9))
+    {
+      m_length = 0;
+      return;
+    }
+  if (m_length >= 2 && m_length < length - 3)
+    m_packet_checksum ^= c;
+  else if (m_length == length - 3)
+    m_packet_valid = (c == m_packet_checksum);
+  else if (m_length == length - 2)
+    m_packet_valid &= (c == '\r');
+  else if (m_length == length - 1)
+    {
+      m_packet_valid &= (c == '\n');
+      m_length = 0;
+      if (m_packet_valid)
+        packet();
+      return;
+    }
+  m_length++;
+}
+
+void
+GPS_NMEA_MT3339_Emulator::packet()
+{
+  uint16_t command = (uint8_t) m_line[4] | ((uint8_t) m_line[5] << 8);
+
+
+  switch (command)
+    {
+    case 722:
+      /* EPO data; acknowledged with sequence and result */
+      m_epo_packets++;
+      if (fault(FAULT_DROP_ACK))
+        return;
+      m_binary_ack = true;
+      m_binary_ack_sequence =
+        (uint8_t) m_line[6] | ((uint8_t) m_line[7] << 8);
+      m_binary_ack_result = (fault(FAULT_EPO_NACK) ? 0 : 1);
+      m_binary_ack_time = RTT::millis();
+      break;
+
+    case 253:
+      /* Mode 0 is back to NMEA */
+      if (m_line[6] == 0)
+        {
+          m_binary = false;
+          m_binary_ack = false;
+          m_epoch = 0xffffffffUL;
+        }
+      break;
+    }
+}
+
+void
+GPS_NMEA_MT3339_Emulator::acknowledge(uint16_t command, uint8_t status)
+{
+  if (m_acks == GPS_NMEA_MT3339_EMULATOR_ACKS || fault(FAULT_DROP_ACK))
+    return;
+
+  m_ack[m_acks].command = command;
+  m_ack[m_acks].status = status;
+  m_ack[m_acks].time = RTT::millis();
+  m_acks++;
+}
+
+void
+GPS_NMEA_MT3339_Emulator::restart(uint16_t command)
+{
+  GPS_NMEA_Command out(&m_output);
+
+
+  if (command == 104)
+    {
+      m_generator.rate(1000);
+      m_generator.sentences(GPS_NMEA_Generator::SENTENCE_DEFAULT);
+    }
+  if (command != 0)
+    m_restarts++;
+
+  m_acks = 0;
+  m_epoch = 0xffffffffUL;
+  m_output.empty();
+
+  out.write(GPS_NMEA_COMMAND("PMTK011,MTKGPS"));
+  out.write(GPS_NMEA_COMMAND("PMTK010,001"));
+}
+
+void
+GPS_NMEA_MT3339_Emulator::generate()
+{
+  uint32_t now = RTT::millis();
+  uint32_t epoch;
+
+
+  /* Binary acknowledgement when due; no NMEA output in binary mode */
+  if (m_binary)
+    {
+      static const uint8_t SIZE = 12;
+      uint8_t ack[SIZE];
+      uint8_t checksum = 0;
+
+      if (!m_binary_ack || (now - m_binary_ack_time) < m_ack_delay ||
+          m_output.room() < SIZE)
+        return;
+      ack[0] = 0x04;
+      ack[1] = 0x24;
+      ack[2] = SIZE;
+      ack[3] = 0;
+      ack[4] = 2;
+      ack[5] = 0;
+      ack[6] = m_binary_ack_sequence;
+      ack[7] = m_binary_ack_sequence >> 8;
+      ack[8] = m_binary_ack_result;
+      for (uint8_t i = 2; i < 9; i++)
+        checksum ^= ack[i];
+      ack[9] = checksum;
+      ack[10] = '\r';
+      ack[11] = '\n';
+      for (uint8_t i = 0; i < SIZE; i++)
+        m_output.putchar(ack[i]);
+      m_binary_ack = false;
+      return;
+    }
+
+  /* Acknowledgements in order, when due */
+  while (m_acks > 0 && (now - m_ack[0].time) >= m_ack_delay &&
+         m_output.room() >= SENTENCE_MAX)
+    {
+      GPS_NMEA_Command out(&m_output);
+
+      out.begin();
+      out.print_P(PSTR("PMTK001"));
+      out.field(m_ack[0].command);
+      out.field(m_ack[0].status);
+      end(out);
+
+      m_acks--;
+      memmove(&m_ack[0], &m_ack[1], m_acks * sizeof(ack_t));
+    }
+
+  if (m_standby)
+    return;
+
+  /* Start epoch on fix interval; sentences as there is room */
+  epoch = (now - m_start) / m_generator.rate() * m_generator.rate();
+  if (epoch != m_epoch)
+    {
+      m_epoch = epoch;
+      m_generator.epoch(epoch);
+    }
+
+  while (m_output.room() >= SENTENCE_MAX && m_generator.sentence(&m_output))
+    ;
+}
+
+void
+GPS_NMEA_MT3339_Emulator::end(GPS_NMEA_Command& out)
+{
+  if (fault(FAULT_CHECKSUM))
+    out.end(out.parity() ^ 0x5a);
+  else
+    out.end();
+}
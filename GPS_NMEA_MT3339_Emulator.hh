@@ -0,0 +1,321 @@
+/**
+ * @file ?/GPS_NMEA_MT3339_Emulator.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_NMEA_MT3339_EMULATOR_HH
+#define COSA_GPS_NMEA_MT3339_EMULATOR_HH
+
+#include "Cosa/IOStream.hh"
+#include "Cosa/IOBuffer.hh"
+#include "Cosa/Time.hh"
+
+#include "GPS.hh"
+#include "GPS_NMEA_Command.hh"
+#include "GPS_NMEA_Generator.hh"
+
+#define GPS_NMEA_MT3339_EMULATOR_BUFFER 256
+#define GPS_NMEA_MT3339_EMULATOR_ACKS 4
+#define GPS_NMEA_MT3339_EMULATOR_LINE 96
+
+/**
+ * GPS NMEA MT3339 Emulator
+ *
+ * Stand-in for an MT3339 receiver on the device side of GPS_NMEA_MT3339,
+ * e.g. GPS_NMEA_MT3339 gps(&emulator). Sentences are produced by a
+ * GPS_NMEA_Generator (see generator() for position, motion and noise)
+ * at the fix rate as read, and PMTK commands are answered with PMTK001
+ * after a delay. Standby (PMTK161), restarts (PMTK101-104), fix rate
+ * (PMTK220), sentence selection (PMTK314), version query (PMTK605) and
+ * baud rate (PMTK251) are emulated, as is the binary mode (PMTK253)
+ * used for EPO upload, where each EPO packet is acknowledged with a
+ * binary packet. Faults may be injected: dropped acknowledgements,
+ * failed EPO packets, corrupted checksums and garbled output as with a
+ * baudrate mismatch. Output is also garbled and input ignored while the
+ * receiver and device rates differ (see baudrate() and
+ * device_baudrate()).
+ *
+ * Time is taken from RTT; output is produced as the device is polled.
+ */
+
+class GPS_NMEA_MT3339_Emulator : public IOStream::Device {
+public:
+  /* Faults */
+  enum {
+    FAULT_DROP_ACK = 0x01,      // acknowledgement not sent
+    FAULT_CHECKSUM = 0x02,      // sentence checksum corrupted
+    FAULT_BAUDRATE = 0x04,      // all output garbled, input ignored
+    FAULT_EPO_NACK = 0x08       // EPO packet acknowledged as failed
+  };
+
+  /**
+   * Construct emulator.
+   * @param[in] now start time
+   */
+  GPS_NMEA_MT3339_Emulator(clock_t now = 0);
+
+  /**
+   * Get sentence generator, e.g. to set position, motion and noise.
+   * @return generator
+   */
+  GPS_NMEA_Generator& generator()
+    __attribute__((always_inline))
+  {
+    return (m_generator);
+  }
+
+  /**
+   * Set acknowledgement delay.
+   * @param[in] ms delay from command to PMTK001
+   */
+  void ack_delay(uint16_t ms)
+    __attribute__((always_inline))
+  {
+    m_ack_delay = ms;
+  }
+
+  /**
+   * Inject faults.
+   * @param[in] faults FAULT_* mask
+   * @param[in] probability per sentence or acknowledgement, in 1/256
+   *   (FAULT_BAUDRATE is permanent while set)
+   */
+  void faults(uint8_t faults, uint8_t probability = 255);
+
+  /**
+   * Set receiver baud rate, e.g. back to the default after a brownout.
+   * @param[in] rate
+   */
+  void baudrate(uint32_t rate)
+    __attribute__((always_inline))
+  {
+    m_baudrate = rate;
+  }
+
+  /**
+   * Get receiver baud rate (PMTK251)
+   * @return rate
+   */
+  uint32_t baudrate()
+    __attribute__((always_inline))
+  {
+    return (m_baudrate);
+  }
+
+  /**
+   * Set device (host serial port) baud rate, as the host would.
+   * @param[in] rate
+   */
+  void device_baudrate(uint32_t rate)
+    __attribute__((always_inline))
+  {
+    m_device_baudrate = rate;
+  }
+
+  /**
+   * Get fix interval (PMTK220)
+   * @return milliseconds
+   */
+  uint16_t rate()
+    __attribute__((always_inline))
+  {
+    return (m_generator.rate());
+  }
+
+  /**
+   * Get selected sentences (PMTK314)
+   * @return GPS_NMEA_Generator::SENTENCE_* mask
+   */
+  uint8_t sentences()
+    __attribute__((always_inline))
+  {
+    return (m_generator.sentences());
+  }
+
+  /**
+   * Is receiver in standby (PMTK161)?
+   * @return standby
+   */
+  bool standby()
+    __attribute__((always_inline))
+  {
+    return (m_standby);
+  }
+
+  /**
+   * Is receiver in binary mode (PMTK253)?
+   * @return binary
+   */
+  bool binary()
+    __attribute__((always_inline))
+  {
+    return (m_binary);
+  }
+
+  /**
+   * Get number of EPO packets received with valid checksum, including
+   * retransmissions and the final packet
+   * @return packets
+   */
+  uint16_t epo_packets()
+    __attribute__((always_inline))
+  {
+    return (m_epo_packets);
+  }
+
+  /**
+   * Get number of sentences generated
+   * @return sentences
+   */
+  uint32_t generated()
+    __attribute__((always_inline))
+  {
+    return (m_generator.written());
+  }
+
+  /**
+   * Get number of commands received with valid checksum
+   * @return commands
+   */
+  uint16_t commands()
+    __attribute__((always_inline))
+  {
+    return (m_commands);
+  }
+
+  /**
+   * Get number of restarts (PMTK101-104)
+   * @return restarts
+   */
+  uint16_t restarts()
+    __attribute__((always_inline))
+  {
+    return (m_restarts);
+  }
+
+  /**
+   * @override IOStream::Device
+   * Generate due output.
+   * @return number of characters available
+   */
+  virtual int available();
+
+  /**
+   * @override IOStream::Device
+   * @return next character or EOF
+   */
+  virtual int getchar();
+
+  /**
+   * @override IOStream::Device
+   * @return room for commands
+   */
+  virtual int room();
+
+  /**
+   * @override IOStream::Device
+   * Receive command character.
+   * @param[in] c character
+   * @return character
+   */
+  virtual int putchar(char c);
+
+protected:
+  /* Output to receiver */
+  IOBuffer<GPS_NMEA_MT3339_EMULATOR_BUFFER> m_output;
+
+  /* Sentences of emulated fix */
+  GPS_NMEA_Generator m_generator;
+  uint32_t m_start;
+  uint32_t m_epoch;
+
+  /* Configuration */
+  uint16_t m_ack_delay;
+  uint8_t m_faults;
+  uint8_t m_probability;
+  bool m_standby;
+
+  /* Receiver and device rates; garbled unless equal */
+  uint32_t m_baudrate;
+  uint32_t m_device_baudrate;
+
+  /* Pending acknowledgements */
+  struct ack_t {
+    uint16_t command;
+    uint8_t status;
+    uint32_t time;
+  };
+  ack_t m_ack[GPS_NMEA_MT3339_EMULATOR_ACKS];
+  uint8_t m_acks;
+
+  /* Command being received */
+  char m_line[GPS_NMEA_MT3339_EMULATOR_LINE];
+  uint8_t m_length;
+
+  /* Binary mode; packet being received, header kept in m_line */
+  bool m_binary;
+  uint8_t m_packet_checksum;
+  bool m_packet_valid;
+
+  /* Pending binary acknowledgement */
+  bool m_binary_ack;
+  uint16_t m_binary_ack_sequence;
+  uint8_t m_binary_ack_result;
+  uint32_t m_binary_ack_time;
+
+  /* Statistics */
+  uint16_t m_commands;
+  uint16_t m_restarts;
+  uint16_t m_epo_packets;
+
+  /* Pseudo random state */
+  uint16_t m_random;
+
+  /* Get pseudo random number */
+  uint16_t random();
+
+  /* Fault occurs? */
+  bool fault(uint8_t fault);
+
+  /* Baudrate mismatch, injected or by rate? */
+  bool garbled()
+  {
+    return ((m_faults & FAULT_BAUDRATE) || m_baudrate != m_device_baudrate);
+  }
+
+  /* Write due acknowledgements and sentences */
+  void generate();
+
+  /* End sentence, possibly with corrupted checksum */
+  void end(GPS_NMEA_Command& out);
+
+  /* Handle command line */
+  void command();
+
+  /* Receive binary mode character */
+  void receive(uint8_t c);
+
+  /* Handle binary packet */
+  void packet();
+
+  /* Queue acknowledgement */
+  void acknowledge(uint16_t command, uint8_t status);
+
+  /* Restart; startup messages */
+  void restart(uint16_t command);
+};
+#endif
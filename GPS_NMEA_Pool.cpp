@@ -0,0 +1,102 @@
+/**
+ * @file ?/GPS_NMEA_Pool.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_NMEA_Pool.hh"
+
+#ifndef GPS_INTERRUPT_IMPL
+
+bool
+GPS_NMEA_Pool::attach(GPS_NMEA* gps)
+{
+  uint8_t free = GPS_NMEA_POOL_RECEIVERS;
+
+
+  for (uint8_t i = 0; i < GPS_NMEA_POOL_RECEIVERS; i++)
+    {
+      if (m_receiver[i] == gps)
+        return (false);
+      if (m_receiver[i] == NULL && free == GPS_NMEA_POOL_RECEIVERS)
+        free = i;
+    }
+
+  if (free == GPS_NMEA_POOL_RECEIVERS)
+    return (false);
+
+  m_receiver[free] = gps;
+
+  return (true);
+}
+
+bool
+GPS_NMEA_Pool::detach(GPS_NMEA* gps)
+{
+  for (uint8_t i = 0; i < GPS_NMEA_POOL_RECEIVERS; i++)
+    if (m_receiver[i] == gps)
+      {
+        m_receiver[i] = NULL;
+        return (true);
+      }
+
+  return (false);
+}
+
+uint16_t
+GPS_NMEA_Pool::service(uint16_t budget)
+{
+  uint16_t count = 0;
+  uint16_t spare = 0;
+  uint8_t busy = 0;
+
+
+  /* Round-robin, each receiver its budget */
+  for (uint8_t k = 0; k < GPS_NMEA_POOL_RECEIVERS; k++)
+    {
+      uint8_t i = (m_next + k) % GPS_NMEA_POOL_RECEIVERS;
+      uint16_t n;
+
+      if (m_receiver[i] == NULL)
+        continue;
+
+      n = m_receiver[i]->consume(budget);
+      count += n;
+      if (n == budget)
+        busy |= _BV(i);
+      else
+        spare += budget - n;
+    }
+
+  /* Budget not used goes to receivers that may have more */
+  for (uint8_t k = 0; k < GPS_NMEA_POOL_RECEIVERS && busy != 0; k++)
+    {
+      uint8_t i = (m_next + k) % GPS_NMEA_POOL_RECEIVERS;
+      uint16_t n;
+
+      if (!(busy & _BV(i)) || spare == 0)
+        continue;
+
+      n = m_receiver[i]->consume(spare);
+      count += n;
+      spare -= n;
+    }
+
+  m_next = (m_next + 1) % GPS_NMEA_POOL_RECEIVERS;
+
+  return (count);
+}
+#endif
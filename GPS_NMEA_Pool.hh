@@ -0,0 +1,78 @@
+/**
+ * @file ?/GPS_NMEA_Pool.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_NMEA_POOL_HH
+#define COSA_GPS_NMEA_POOL_HH
+
+#include "GPS_NMEA.hh"
+
+#ifndef GPS_INTERRUPT_IMPL
+
+#define GPS_NMEA_POOL_RECEIVERS 4
+
+/**
+ * GPS NMEA Pool
+ *
+ * Services several receivers from one loop. Each call to service()
+ * gives every receiver a budget of characters, starting with a
+ * different receiver each time; budget left over by quiet receivers
+ * is then shared by the receivers that used all of theirs, so that a
+ * bursting receiver catches up without starving the others. Committed
+ * fixes can be collected in order with a GPS_Fix_Queue and an Input
+ * attached to each receiver.
+ */
+
+class GPS_NMEA_Pool {
+public:
+  /**
+   * Construct empty pool.
+   */
+  GPS_NMEA_Pool()
+  {
+    memset(m_receiver, 0, sizeof(m_receiver));
+    m_next = 0;
+  }
+
+  /**
+   * Add receiver.
+   * @param[in] gps receiver
+   * @return true if added, false if pool full or already added
+   */
+  bool attach(GPS_NMEA* gps);
+
+  /**
+   * Remove receiver.
+   * @param[in] gps receiver
+   * @return true if removed
+   */
+  bool detach(GPS_NMEA* gps);
+
+  /**
+   * Service receivers.
+   * @param[in] budget characters per receiver
+   * @return number of characters parsed
+   */
+  uint16_t service(uint16_t budget = GPS_NMEA_BLOCK * 4);
+
+protected:
+  GPS_NMEA* m_receiver[GPS_NMEA_POOL_RECEIVERS];
+  uint8_t m_next;
+};
+#endif
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file ?/GPS_NMEA_Service.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_NMEA_Service.hh"
+
+#ifndef GPS_INTERRUPT_IMPL
+
+void
+GPS_NMEA_Service::run()
+{
+  m_slices++;
+
+  /* More may be waiting; continue after queued events */
+  if (m_gps->consume(m_slice) == m_slice && !m_pending)
+    {
+      m_pending = true;
+      m_continued++;
+      if (!Event::push(Event::RUN_TYPE, this))
+        m_pending = false;
+    }
+}
+
+void
+GPS_NMEA_Service::on_event(uint8_t type, uint16_t value)
+{
+  switch (type)
+    {
+    case Event::RUN_TYPE:
+      m_pending = false;
+      run();
+      break;
+
+    case Event::RECEIVE_COMPLETED_TYPE:
+      run();
+      break;
+
+    default:
+      Periodic::on_event(type, value);
+      break;
+    }
+}
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file ?/GPS_NMEA_Service.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_NMEA_SERVICE_HH
+#define COSA_GPS_NMEA_SERVICE_HH
+
+#include "Cosa/Periodic.hh"
+
+#include "GPS_NMEA.hh"
+
+#ifndef GPS_INTERRUPT_IMPL
+
+/* Default characters parsed per slice */
+#define GPS_NMEA_SERVICE_SLICE (GPS_NMEA_BLOCK * 4)
+
+/**
+ * GPS NMEA Service
+ *
+ * Parses a receiver from the Cosa event loop instead of calling
+ * consume() from loop(). Each slice parses at most the slice size of
+ * characters. A slice runs on the period, and as soon as
+ * Event::RECEIVE_COMPLETED_TYPE is pushed to the service, e.g. from a
+ * serial receive hook. A slice that used all of its budget pushes
+ * another through the event queue, so a backlog is worked off without
+ * delaying other handlers by more than one slice. The loop then only
+ * needs Event::service() and may sleep between sentences.
+ *
+ * @code
+ * GPS_NMEA_Service service(&scheduler, &gps, 100);
+ * ...
+ * service.start();
+ * ...
+ * void loop() { Event::service(); }
+ * @endcode
+ */
+
+class GPS_NMEA_Service : public Periodic {
+public:
+  /**
+   * Construct service for receiver.
+   * @param[in] scheduler for the period
+   * @param[in] gps receiver
+   * @param[in] period between slices, in scheduler time units
+   * @param[in] slice maximum characters per slice
+   */
+  GPS_NMEA_Service(Job::Scheduler* scheduler, GPS_NMEA* gps,
+                   uint32_t period,
+                   uint16_t slice = GPS_NMEA_SERVICE_SLICE) :
+    Periodic(scheduler, period),
+    m_gps(gps),
+    m_slice(slice),
+    m_slices(0),
+    m_continued(0),
+    m_pending(false)
+  {}
+
+  /**
+   * Set slice size.
+   * @param[in] slice maximum characters per slice
+   */
+  void slice(uint16_t slice)
+    __attribute__((always_inline))
+  {
+    m_slice = slice;
+  }
+
+  /**
+   * Get slice size.
+   * @return maximum characters per slice
+   */
+  uint16_t slice()
+    __attribute__((always_inline))
+  {
+    return (m_slice);
+  }
+
+  /**
+   * Get number of slices run.
+   * @return slices
+   */
+  uint32_t slices()
+    __attribute__((always_inline))
+  {
+    return (m_slices);
+  }
+
+  /**
+   * Get number of slices that used all of their budget and were
+   * continued through the event queue.
+   * @return slices
+   */
+  uint32_t continued()
+    __attribute__((always_inline))
+  {
+    return (m_continued);
+  }
+
+  /**
+   * Parse one slice; called on the period.
+   */
+  virtual void run();
+
+protected:
+  /* Receive event, or continued slice; else periodic */
+  virtual void on_event(uint8_t type, uint16_t value);
+
+  GPS_NMEA* m_gps;
+  uint16_t m_slice;
+  uint32_t m_slices;
+  uint32_t m_continued;
+
+  /* Continued slice is queued */
+  bool m_pending;
+};
+#endif
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file ?/GPS_Serial_POSIX.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Serial_POSIX.hh"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+bool
+GPS_Serial_POSIX::open(const char* path, uint32_t baudrate, uint8_t min)
+{
+  struct termios tio;
+  speed_t speed;
+
+
+  switch (baudrate)
+    {
+    case 4800: speed = B4800; break;
+    case 9600: speed = B9600; break;
+    case 19200: speed = B19200; break;
+    case 38400: speed = B38400; break;
+    case 57600: speed = B57600; break;
+    case 115200: speed = B115200; break;
+    case 230400: speed = B230400; break;
+    case 460800: speed = B460800; break;
+    case 921600: speed = B921600; break;
+    default:
+      return (false);
+    }
+  if (min == 0)
+    min = 1;
+
+  close();
+  m_fd = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (m_fd < 0)
+    return (false);
+
+  /* Raw 8N1; reads do not block, poll wakes on min characters */
+  if (tcgetattr(m_fd, &tio) != 0)
+    {
+      close();
+      return (false);
+    }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+  tio.c_cc[VMIN] = min;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+  if (tcsetattr(m_fd, TCSANOW, &tio) != 0)
+    {
+      close();
+      return (false);
+    }
+  tcflush(m_fd, TCIOFLUSH);
+
+  return (true);
+}
+
+void
+GPS_Serial_POSIX::close()
+{
+  if (m_fd >= 0)
+    ::close(m_fd);
+  m_fd = -1;
+  m_head = 0;
+  m_tail = 0;
+}
+
+bool
+GPS_Serial_POSIX::wait(int ms)
+{
+  struct pollfd pfd;
+
+
+  if (m_head != m_tail)
+    return (true);
+  if (m_fd < 0)
+    return (false);
+
+  pfd.fd = m_fd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  while (poll(&pfd, 1, ms) < 0)
+    if (errno != EINTR)
+      return (false);
+
+  return ((pfd.revents & POLLIN) != 0);
+}
+
+int
+GPS_Serial_POSIX::fill()
+{
+  ssize_t n;
+
+
+  m_head = 0;
+  m_tail = 0;
+  if (m_fd < 0)
+    return (0);
+
+  do
+    n = ::read(m_fd, m_buffer, sizeof(m_buffer));
+  while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return (0);
+
+  m_tail = n;
+  return (n);
+}
+
+int
+GPS_Serial_POSIX::available()
+{
+  int queued = 0;
+
+
+  if (m_fd >= 0 && ioctl(m_fd, FIONREAD, &queued) != 0)
+    queued = 0;
+
+  return ((m_tail - m_head) + queued);
+}
+
+int
+GPS_Serial_POSIX::getchar()
+{
+  if (m_head == m_tail && fill() == 0)
+    return (IOStream::EOF);
+
+  return ((uint8_t) m_buffer[m_head++]);
+}
+
+int
+GPS_Serial_POSIX::read(void* buf, size_t size)
+{
+  size_t n = m_tail - m_head;
+
+
+  if (n == 0)
+    {
+      /* Large reads go straight to the caller */
+      if (size >= sizeof(m_buffer) && m_fd >= 0)
+        {
+          ssize_t count;
+
+          do
+            count = ::read(m_fd, buf, size);
+          while (count < 0 && errno == EINTR);
+          return (count < 0 ? 0 : count);
+        }
+      n = fill();
+    }
+
+  if (n > size)
+    n = size;
+  memcpy(buf, m_buffer + m_head, n);
+  m_head += n;
+
+  return (n);
+}
+
+int
+GPS_Serial_POSIX::room()
+{
+  int queued = 0;
+
+
+  if (m_fd < 0)
+    return (0);
+  if (ioctl(m_fd, TIOCOUTQ, &queued) != 0 || queued > GPS_SERIAL_POSIX_ROOM)
+    queued = 0;
+
+  return (GPS_SERIAL_POSIX_ROOM - queued);
+}
+
+int
+GPS_Serial_POSIX::putchar(char c)
+{
+  if (write(&c, 1) != 1)
+    return (IOStream::EOF);
+
+  return ((uint8_t) c);
+}
+
+int
+GPS_Serial_POSIX::write(const void* buf, size_t size)
+{
+  const char* p = (const char*) buf;
+  size_t count = 0;
+
+
+  if (m_fd < 0)
+    return (0);
+
+  /* Non-blocking port; wait a while for the output queue to drain */
+  while (count < size)
+    {
+      ssize_t n = ::write(m_fd, p + count, size - count);
+
+      if (n > 0)
+        {
+          count += n;
+          continue;
+        }
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && errno == EAGAIN)
+        {
+          struct pollfd pfd;
+
+          pfd.fd = m_fd;
+          pfd.events = POLLOUT;
+          pfd.revents = 0;
+          if (poll(&pfd, 1, GPS_SERIAL_POSIX_WRITE_TIMEOUT) > 0)
+            continue;
+        }
+      break;
+    }
+
+  return (count);
+}
+
+void
+GPS_Serial_POSIX::empty()
+{
+  m_head = 0;
+  m_tail = 0;
+  if (m_fd >= 0)
+    tcflush(m_fd, TCIFLUSH);
+}
+
+int
+GPS_Serial_POSIX::flush()
+{
+  if (m_fd < 0 || tcdrain(m_fd) != 0)
+    return (IOStream::EOF);
+
+  return (0);
+}
+
+#endif
@@ -0,0 +1,173 @@
+/**
+ * @file ?/GPS_Serial_POSIX.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_SERIAL_POSIX_HH
+#define COSA_GPS_SERIAL_POSIX_HH
+
+#ifdef __linux__
+
+#include "Cosa/IOStream.hh"
+
+/* Bytes read from the port per system call */
+#define GPS_SERIAL_POSIX_BUFFER 512
+
+/* Room reported for output; the size of the tty output queue */
+#define GPS_SERIAL_POSIX_ROOM 4096
+
+/* Milliseconds a write waits for the port to drain before giving up */
+#define GPS_SERIAL_POSIX_WRITE_TIMEOUT 100
+
+/**
+ * GPS Serial POSIX
+ *
+ * Device over a serial port on a Linux host, e.g. a gateway running
+ * GPS_NMEA gps(&serial) without interrupt implementation. The port is
+ * set to raw mode and read without blocking, GPS_SERIAL_POSIX_BUFFER
+ * bytes per system call, so consume() gets its blocks by copy rather
+ * than a call per character. wait() polls for input; with min > 1 the
+ * line discipline only wakes the poll when min bytes have arrived (VMIN
+ * with VTIME zero), and the wait timeout bounds the latency of the tail
+ * of an epoch. Any tty works, including the slave side of a pty.
+ *
+ * Host only; compiles to nothing on other targets.
+ */
+
+class GPS_Serial_POSIX : public IOStream::Device {
+public:
+  /**
+   * Construct closed port.
+   */
+  GPS_Serial_POSIX() :
+    IOStream::Device(),
+    m_fd(-1),
+    m_head(0),
+    m_tail(0)
+  {}
+
+  /**
+   * Destruct; close port.
+   */
+  virtual ~GPS_Serial_POSIX()
+  {
+    close();
+  }
+
+  /**
+   * Open port in raw mode, 8N1 without flow control; pending input and
+   * output are discarded.
+   * @param[in] path tty, e.g. "/dev/ttyUSB0"
+   * @param[in] baudrate 4800..921600
+   * @param[in] min characters before wait() returns (VMIN, 1..255)
+   * @return true if opened, false if not or baudrate not supported
+   */
+  bool open(const char* path, uint32_t baudrate, uint8_t min = 1);
+
+  /**
+   * Close port.
+   */
+  void close();
+
+  /**
+   * Get file descriptor, e.g. for an application event loop.
+   * @return descriptor, -1 if closed
+   */
+  int fd()
+    __attribute__((always_inline))
+  {
+    return (m_fd);
+  }
+
+  /**
+   * Wait for input.
+   * @param[in] ms timeout, -1 for none
+   * @return true if input available, false on timeout or error
+   */
+  bool wait(int ms);
+
+  /**
+   * @override IOStream::Device
+   * @return number of characters buffered and queued in the port
+   */
+  virtual int available();
+
+  /**
+   * @override IOStream::Device
+   * @return next character or EOF
+   */
+  virtual int getchar();
+
+  /**
+   * @override IOStream::Device
+   * Read buffered characters; the port is read when the buffer is
+   * empty, at most once per call.
+   * @param[in] buf destination
+   * @param[in] size maximum number of characters
+   * @return number of characters read
+   */
+  virtual int read(void* buf, size_t size);
+
+  /**
+   * @override IOStream::Device
+   * @return room in the port output queue
+   */
+  virtual int room();
+
+  /**
+   * @override IOStream::Device
+   * @param[in] c character
+   * @return character or EOF
+   */
+  virtual int putchar(char c);
+
+  /**
+   * @override IOStream::Device
+   * @param[in] buf source
+   * @param[in] size number of characters
+   * @return number of characters written
+   */
+  virtual int write(const void* buf, size_t size);
+
+  /**
+   * @override IOStream::Device
+   * Discard buffered and pending input.
+   */
+  virtual void empty();
+
+  /**
+   * @override IOStream::Device
+   * Wait until output is transmitted.
+   * @return zero or EOF on error
+   */
+  virtual int flush();
+
+protected:
+  /* Port, -1 if closed */
+  int m_fd;
+
+  /* Input read but not yet taken */
+  char m_buffer[GPS_SERIAL_POSIX_BUFFER];
+  uint16_t m_head;
+  uint16_t m_tail;
+
+  /* Read port into empty buffer; number of characters */
+  int fill();
+};
+
+#endif
+#endif
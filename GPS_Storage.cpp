@@ -0,0 +1,151 @@
+/**
+ * @file ?/GPS_Storage.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "Cosa/RTT.hh"
+
+#include "GPS_Storage.hh"
+
+void
+GPS_Storage::on_fix(GPS& gps)
+{
+  GPS::fix_t fix;
+
+
+  if (m_count != 0 && RTT::since(m_saved) < m_interval * 1000UL)
+    return;
+
+  gps.get(fix);
+  if (save(fix))
+    {
+      m_saved = RTT::millis();
+      m_count++;
+    }
+}
+
+uint8_t
+GPS_Storage::checksum(const record_t& record)
+{
+  const uint8_t* p = (const uint8_t*) &record;
+  uint8_t sum = 0;
+
+
+  for (size_t i = 0; i < offsetof(record_t, checksum); i++)
+    sum = ((sum << 1) | (sum >> 7)) ^ p[i];
+
+  return (sum);
+}
+
+void
+GPS_Storage::encode(record_t& record, const GPS::fix_t& fix)
+{
+  memset(&record, 0, sizeof(record));
+  record.magic = MAGIC;
+  record.fix = fix;
+  record.checksum = checksum(record);
+}
+
+bool
+GPS_Storage::decode(const record_t& record, GPS::fix_t& fix)
+{
+  if (record.magic != MAGIC || record.checksum != checksum(record))
+    return (false);
+
+  fix = record.fix;
+
+  return (true);
+}
+
+bool
+GPS_Storage_EEPROM::save(const GPS::fix_t& fix)
+{
+  record_t record;
+
+
+  encode(record, fix);
+
+  return (m_eeprom->write(m_addr, &record, sizeof(record)) ==
+          (int) sizeof(record));
+}
+
+bool
+GPS_Storage_EEPROM::load(GPS::fix_t& fix)
+{
+  record_t record;
+
+
+  if (m_eeprom->read(&record, m_addr, sizeof(record)) != (int) sizeof(record))
+    return (false);
+
+  return (decode(record, fix));
+}
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+bool
+GPS_Storage_File::save(const GPS::fix_t& fix)
+{
+  char tmp[256];
+  record_t record;
+  bool ok;
+  int fd;
+
+
+  if (snprintf(tmp, sizeof(tmp), "%s.tmp", m_path) >= (int) sizeof(tmp))
+    return (false);
+
+  fd = ::open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return (false);
+
+  encode(record, fix);
+  ok = (::write(fd, &record, sizeof(record)) == (ssize_t) sizeof(record));
+  ok = (::fsync(fd) == 0) && ok;
+  ok = (::close(fd) == 0) && ok;
+  if (ok)
+    ok = (::rename(tmp, m_path) == 0);
+  if (!ok)
+    ::unlink(tmp);
+
+  return (ok);
+}
+
+bool
+GPS_Storage_File::load(GPS::fix_t& fix)
+{
+  record_t record;
+  ssize_t n;
+  int fd;
+
+
+  fd = ::open(m_path, O_RDONLY);
+  if (fd < 0)
+    return (false);
+
+  n = ::read(fd, &record, sizeof(record));
+  ::close(fd);
+  if (n != (ssize_t) sizeof(record))
+    return (false);
+
+  return (decode(record, fix));
+}
+#endif
@@ -0,0 +1,168 @@
+/**
+ * @file ?/GPS_Storage.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_STORAGE_HH
+#define COSA_GPS_STORAGE_HH
+
+#include "Cosa/EEPROM.hh"
+
+#include "GPS.hh"
+
+/**
+ * GPS Storage
+ *
+ * Persists the last committed fix so that it can be used to aid the
+ * receiver at the next start (see GPS_NMEA_MT3339::assist()). Attach to
+ * a GPS to save committed fixes, at most once per interval to limit
+ * wear. Subclass and implement save()/load() for the storage medium.
+ */
+
+class GPS_Storage : public GPS::Listener {
+public:
+  /**
+   * Construct storage.
+   * @param[in] interval minimum seconds between saves
+   */
+  GPS_Storage(uint16_t interval = 600) :
+    GPS::Listener(),
+    m_interval(interval),
+    m_saved(0),
+    m_count(0)
+  {}
+
+  /**
+   * Save fix.
+   * @param[in] fix
+   * @return true if saved
+   */
+  virtual bool save(const GPS::fix_t& fix) = 0;
+
+  /**
+   * Load last saved fix.
+   * @param[out] fix
+   * @return true if a valid fix was loaded
+   */
+  virtual bool load(GPS::fix_t& fix) = 0;
+
+  /**
+   * @override GPS::Listener
+   * Save committed fix if interval has passed since last save.
+   * @param[in] gps
+   */
+  virtual void on_fix(GPS& gps);
+
+  /**
+   * Get number of fixes saved
+   * @return saves
+   */
+  uint16_t saves()
+    __attribute__((always_inline))
+  {
+    return (m_count);
+  }
+
+protected:
+  static const uint16_t MAGIC = 0x4746;
+
+  /* Record with magic number and checksum, as kept by the sinks below */
+  struct record_t {
+    uint16_t magic;
+    GPS::fix_t fix;
+    uint8_t checksum;
+  };
+
+  uint16_t m_interval;
+  uint32_t m_saved;
+  uint16_t m_count;
+
+  /* Checksum of record up to the checksum */
+  static uint8_t checksum(const record_t& record);
+
+  /* Fill record for given fix */
+  static void encode(record_t& record, const GPS::fix_t& fix);
+
+  /* Get fix from record; false if erased or partially written */
+  static bool decode(const record_t& record, GPS::fix_t& fix);
+};
+
+/**
+ * GPS Storage in EEPROM
+ *
+ * The fix is kept in a record with a magic number and checksum so that
+ * an erased or partially written record is not loaded.
+ */
+
+class GPS_Storage_EEPROM : public GPS_Storage {
+public:
+  /**
+   * Construct EEPROM storage.
+   * @param[in] eeprom device
+   * @param[in] addr of record in EEPROM (size RECORD_SIZE)
+   * @param[in] interval minimum seconds between saves
+   */
+  GPS_Storage_EEPROM(EEPROM* eeprom, void* addr, uint16_t interval = 600) :
+    GPS_Storage(interval),
+    m_eeprom(eeprom),
+    m_addr(addr)
+  {}
+
+  virtual bool save(const GPS::fix_t& fix);
+  virtual bool load(GPS::fix_t& fix);
+
+protected:
+  EEPROM* m_eeprom;
+  void* m_addr;
+
+public:
+  /* Size of EEPROM record */
+  static const size_t RECORD_SIZE = sizeof(record_t);
+};
+
+#ifdef __linux__
+/**
+ * GPS Storage in a file
+ *
+ * Host sink, e.g. for a gateway with GPS_Serial_POSIX. The record is
+ * the one kept in EEPROM. It is written to a temporary file next to the
+ * given path and renamed over it, so that the file holds either the
+ * previous or the new record.
+ *
+ * Host only; not defined on other targets.
+ */
+
+class GPS_Storage_File : public GPS_Storage {
+public:
+  /**
+   * Construct file storage.
+   * @param[in] path of record file, kept by the caller
+   * @param[in] interval minimum seconds between saves
+   */
+  GPS_Storage_File(const char* path, uint16_t interval = 600) :
+    GPS_Storage(interval),
+    m_path(path)
+  {}
+
+  virtual bool save(const GPS::fix_t& fix);
+  virtual bool load(GPS::fix_t& fix);
+
+protected:
+  const char* m_path;
+};
+#endif
+#endif
@@ -0,0 +1,210 @@
+/**
+ * @file ?/GPS_Telemetry.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Telemetry.hh"
+#include "GPS_Track.hh"
+
+/* Little-endian field access */
+
+static uint8_t*
+put(uint8_t* p, uint32_t value, uint8_t size)
+{
+  while (size-- > 0)
+    {
+      *p++ = value;
+      value >>= 8;
+    }
+  return (p);
+}
+
+static uint32_t
+get(const uint8_t*& p, uint8_t size)
+{
+  uint32_t value = 0;
+
+
+  for (uint8_t i = 0; i < size; i++)
+    value |= (uint32_t) *p++ << (i * 8);
+  return (value);
+}
+
+#ifndef GPS_TIME_ONLY
+/* Does delta fit in 16 bits? */
+static bool
+fits(int32_t delta)
+{
+  return (delta >= -32768 && delta <= 32767);
+}
+
+/* Clamp to 16 bits */
+static uint16_t
+clamp(uint32_t value)
+{
+  return (value > 0xffff ? 0xffff : value);
+}
+#endif
+
+uint16_t
+GPS_Telemetry::crc(const uint8_t* buf, size_t size)
+{
+  uint16_t crc = 0xffff;
+
+
+  while (size-- > 0)
+    {
+      crc = (crc >> 8) | (crc << 8);
+      crc ^= *buf++;
+      crc ^= (crc & 0xff) >> 4;
+      crc ^= crc << 12;
+      crc ^= (crc & 0xff) << 5;
+    }
+
+  return (crc);
+}
+
+size_t
+GPS_Telemetry::Encoder::encode(const GPS::fix_t& fix, void* buf, size_t size)
+{
+  uint8_t* start = (uint8_t*) buf;
+  uint8_t* p = start + 2;
+  uint32_t ms = GPS_Track::time_to_millis(fix.time);
+  uint32_t last_ms = GPS_Track::time_to_millis(m_last.time);
+  bool delta = false;
+  uint16_t sum;
+
+
+  if (size < KEY_SIZE)
+    return (0);
+
+  /* Delta if previous packet in same day and deltas fit */
+  if (m_delta && m_key_countdown > 0 &&
+      fix.date == m_last.date && ms >= last_ms && ms - last_ms <= 0xffff)
+    {
+      delta = true;
+#ifndef GPS_TIME_ONLY
+      delta = (fits(fix.latitude - m_last.latitude) &&
+               fits(fix.longitude - m_last.longitude) &&
+               fits(fix.altitude - m_last.altitude));
+#endif
+    }
+
+  if (delta)
+    {
+      p = put(p, ms - last_ms, 2);
+#ifndef GPS_TIME_ONLY
+      p = put(p, fix.latitude - m_last.latitude, 2);
+      p = put(p, fix.longitude - m_last.longitude, 2);
+      p = put(p, fix.altitude - m_last.altitude, 2);
+#endif
+      m_key_countdown--;
+    }
+  else
+    {
+      p = put(p, fix.date, 3);
+      p = put(p, fix.time, 4);
+#ifndef GPS_TIME_ONLY
+      p = put(p, fix.latitude, 4);
+      p = put(p, fix.longitude, 4);
+      p = put(p, fix.altitude, 4);
+#endif
+      m_key_countdown = m_key_interval;
+    }
+#ifndef GPS_TIME_ONLY
+  p = put(p, clamp(fix.course), 2);
+  p = put(p, clamp(fix.speed), 2);
+  p = put(p, fix.satellites, 1);
+  p = put(p, clamp(fix.hdop), 2);
+#endif
+
+  start[0] = VERSION | (delta ? DELTA : 0);
+  start[1] = ++m_sequence;
+  sum = crc(start, p - start);
+  *p++ = sum >> 8;
+  *p++ = sum;
+  m_last = fix;
+
+  return (p - start);
+}
+
+bool
+GPS_Telemetry::Decoder::decode(const void* buf, size_t size,
+                               GPS::fix_t& fix)
+{
+  const uint8_t* p = (const uint8_t*) buf;
+  bool delta;
+  uint8_t sequence;
+
+
+  if (size < 2 || (p[0] & ~DELTA) != VERSION)
+    {
+      m_errors++;
+      return (false);
+    }
+  delta = (p[0] & DELTA) != 0;
+  if (size != (delta ? DELTA_SIZE : KEY_SIZE) ||
+      crc(p, size - 2) != (((uint16_t) p[size - 2] << 8) | p[size - 1]))
+    {
+      m_errors++;
+      return (false);
+    }
+  sequence = p[1];
+  p += 2;
+
+  if (delta)
+    {
+      uint32_t ms;
+
+      if (!m_synced || sequence != (uint8_t) (m_sequence + 1))
+        {
+          m_synced = false;
+          m_missed++;
+          return (false);
+        }
+      ms = GPS_Track::time_to_millis(m_last.time) + get(p, 2);
+      fix = m_last;
+      fix.time = GPS_Track::millis_to_time(ms);
+#ifndef GPS_TIME_ONLY
+      fix.latitude += (int16_t) get(p, 2);
+      fix.longitude += (int16_t) get(p, 2);
+      fix.altitude += (int16_t) get(p, 2);
+#endif
+    }
+  else
+    {
+      fix.date = get(p, 3);
+      fix.time = get(p, 4);
+#ifndef GPS_TIME_ONLY
+      fix.latitude = get(p, 4);
+      fix.longitude = get(p, 4);
+      fix.altitude = get(p, 4);
+#endif
+    }
+#ifndef GPS_TIME_ONLY
+  fix.course = get(p, 2);
+  fix.speed = get(p, 2);
+  fix.satellites = get(p, 1);
+  fix.hdop = get(p, 2);
+#endif
+
+  m_synced = true;
+  m_sequence = sequence;
+  m_last = fix;
+
+  return (true);
+}
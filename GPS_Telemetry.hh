@@ -0,0 +1,186 @@
+/**
+ * @file ?/GPS_Telemetry.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_TELEMETRY_HH
+#define COSA_GPS_TELEMETRY_HH
+
+#include "GPS.hh"
+
+/**
+ * GPS Telemetry
+ *
+ * Fixed layout binary packets of fixes for low bandwidth links. A
+ * packet is a header (version and flags), a sequence number, the fix
+ * and a CRC-16 (CCITT, big-endian). A key packet holds the fix; a delta
+ * packet holds the fix relative to the previous packet and is only
+ * decoded if that packet was received. Multibyte fields are
+ * little-endian. Packets are written to and read from caller buffers.
+ *
+ * Key packet fields: date (3 bytes DDMMYY), time (4 bytes HHMMSSmmm);
+ * in full builds latitude, longitude, altitude (4 bytes each), course,
+ * speed (2 bytes), satellites (1 byte) and hdop (2 bytes). Delta packet
+ * fields: milliseconds since previous (2 bytes); in full builds
+ * latitude, longitude and altitude deltas (2 bytes each) and course,
+ * speed, satellites and hdop as in a key packet.
+ */
+
+class GPS_Telemetry {
+public:
+  /* Layout version */
+  static const uint8_t VERSION = 1;
+
+  /* Header flags */
+  static const uint8_t DELTA = 0x80;
+
+  /* Packet sizes */
+#ifdef GPS_TIME_ONLY
+  static const uint8_t KEY_SIZE = 11;
+  static const uint8_t DELTA_SIZE = 6;
+#else
+  static const uint8_t KEY_SIZE = 30;
+  static const uint8_t DELTA_SIZE = 19;
+#endif
+
+  /**
+   * Calculate CRC-16 (CCITT, initial 0xffff) of buffer.
+   * @param[in] buf
+   * @param[in] size
+   * @return crc
+   */
+  static uint16_t crc(const uint8_t* buf, size_t size);
+
+  /**
+   * GPS Telemetry Encoder
+   */
+  class Encoder {
+  public:
+    /**
+     * Construct encoder.
+     * @param[in] delta write delta packets where possible
+     * @param[in] key_interval packets between key packets
+     */
+    Encoder(bool delta = true, uint8_t key_interval = 16) :
+      m_delta(delta),
+      m_key_interval(key_interval),
+      m_key_countdown(0),
+      m_sequence(0)
+    {
+      memset(&m_last, 0, sizeof(m_last));
+    }
+
+    /**
+     * Restart; next packet is a key packet.
+     */
+    void reset()
+      __attribute__((always_inline))
+    {
+      m_key_countdown = 0;
+    }
+
+    /**
+     * Encode fix.
+     * @param[in] fix
+     * @param[out] buf packet
+     * @param[in] size of buffer, at least KEY_SIZE
+     * @return packet size, 0 if buffer too small
+     */
+    size_t encode(const GPS::fix_t& fix, void* buf, size_t size);
+
+    /**
+     * Encode current fix of gps.
+     * @param[in] gps
+     * @param[out] buf packet
+     * @param[in] size of buffer, at least KEY_SIZE
+     * @return packet size, 0 if buffer too small
+     */
+    size_t encode(GPS& gps, void* buf, size_t size)
+    {
+      GPS::fix_t fix;
+      gps.get(fix);
+      return (encode(fix, buf, size));
+    }
+
+  protected:
+    bool m_delta;
+    uint8_t m_key_interval;
+    uint8_t m_key_countdown;
+    uint8_t m_sequence;
+
+    /* Previous packet */
+    GPS::fix_t m_last;
+  };
+
+  /**
+   * GPS Telemetry Decoder
+   */
+  class Decoder {
+  public:
+    /**
+     * Construct decoder.
+     */
+    Decoder() :
+      m_synced(false),
+      m_sequence(0),
+      m_errors(0),
+      m_missed(0)
+    {
+      memset(&m_last, 0, sizeof(m_last));
+    }
+
+    /**
+     * Decode packet. Delta packets are skipped until a key packet has
+     * been decoded, and after a lost packet.
+     * @param[in] buf packet
+     * @param[in] size of packet
+     * @param[out] fix
+     * @return true if a fix was decoded
+     */
+    bool decode(const void* buf, size_t size, GPS::fix_t& fix);
+
+    /**
+     * Get number of packets with wrong version, size or CRC
+     * @return errors
+     */
+    uint16_t errors()
+      __attribute__((always_inline))
+    {
+      return (m_errors);
+    }
+
+    /**
+     * Get number of delta packets skipped without previous packet
+     * @return missed
+     */
+    uint16_t missed()
+      __attribute__((always_inline))
+    {
+      return (m_missed);
+    }
+
+  protected:
+    bool m_synced;
+    uint8_t m_sequence;
+    uint16_t m_errors;
+    uint16_t m_missed;
+
+    /* Previous packet */
+    GPS::fix_t m_last;
+  };
+};
+#endif
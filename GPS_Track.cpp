@@ -0,0 +1,443 @@
+/**
+ * @file ?/GPS_Track.cpp
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#include "GPS_Track.hh"
+
+static inline uint32_t
+zigzag(int32_t value)
+{
+  return (((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline int32_t
+unzigzag(uint32_t value)
+{
+  return ((int32_t)(value >> 1) ^ -(int32_t)(value & 1));
+}
+
+uint32_t
+GPS_Track::time_to_millis(GPS::gps_time_t time)
+{
+  uint32_t tmp = time / 100000;         // HHMM
+
+
+  return (((tmp / 100) * 60 + (tmp % 100)) * 60000 + time % 100000);
+}
+
+GPS::gps_time_t
+GPS_Track::millis_to_time(uint32_t ms)
+{
+  uint32_t tmp = ms / 1000;
+
+
+  return ((((tmp / 3600) * 100 + (tmp / 60) % 60) * 100 + tmp % 60) * 1000 +
+          ms % 1000);
+}
+
+GPS_Track::Encoder::Encoder(IOStream::Device* device,
+                            uint16_t tolerance,
+                            uint8_t key_interval) :
+  m_device(device),
+  m_key_interval(key_interval ? key_interval : 1),
+  m_fixes(0),
+  m_records(0),
+  m_bytes(0)
+{
+#ifndef GPS_TIME_ONLY
+  /* Meters to units of 16 millionths of a degree */
+  if (tolerance > 58000)
+    tolerance = 58000;
+  m_tolerance = ((uint32_t)tolerance * 575 + 512) >> 10;
+#else
+  UNUSED(tolerance);
+#endif
+  reset();
+}
+
+void
+GPS_Track::Encoder::reset()
+{
+  m_key_countdown = 0;
+  memset(&m_last, 0, sizeof(m_last));
+#ifndef GPS_TIME_ONLY
+  m_pending = false;
+  m_window = 0;
+#endif
+}
+
+void
+GPS_Track::Encoder::update(GPS& gps)
+{
+  GPS::fix_t fix;
+
+
+  if (!gps.valid())
+    return;
+
+  gps.get(fix);
+  encode(fix);
+}
+
+void
+GPS_Track::Encoder::encode(const GPS::fix_t& fix)
+{
+  m_fixes++;
+
+#ifndef GPS_TIME_ONLY
+  if (m_tolerance != 0 && m_key_countdown != 0)
+    {
+      if (!m_pending)
+        {
+          m_hold = fix;
+          m_pending = true;
+          return;
+        }
+
+      if (within(fix))
+        {
+          m_window_latitude[m_window] = m_hold.latitude;
+          m_window_longitude[m_window] = m_hold.longitude;
+          m_window++;
+          m_hold = fix;
+          return;
+        }
+
+      write(m_hold);
+      m_window = 0;
+      m_hold = fix;
+      return;
+    }
+
+  /* Key record is never held back */
+  if (m_pending)
+    {
+      write(m_hold);
+      m_pending = false;
+      m_window = 0;
+    }
+#endif
+
+  write(fix);
+}
+
+void
+GPS_Track::Encoder::flush()
+{
+#ifndef GPS_TIME_ONLY
+  if (m_pending)
+    {
+      write(m_hold);
+      m_pending = false;
+      m_window = 0;
+    }
+#endif
+  m_device->flush();
+}
+
+#ifndef GPS_TIME_ONLY
+static uint16_t
+isqrt(uint32_t value)
+{
+  uint32_t result = 0;
+  uint32_t bit = 1UL << 30;
+
+
+  while (bit > value)
+    bit >>= 2;
+
+  while (bit != 0)
+    {
+      if (value >= result + bit)
+        {
+          value -= result + bit;
+          result = (result >> 1) + bit;
+        }
+      else
+        result >>= 1;
+      bit >>= 2;
+    }
+
+  return (result);
+}
+
+/* Offset in units from origin, false if out of 16-bit range */
+static bool
+offset(const GPS::fix_t& origin, uint16_t cos,
+       GPS::position_t latitude, GPS::position_t longitude,
+       int32_t& x, int32_t& y)
+{
+  y = (latitude - origin.latitude) >> 4;
+  x = (longitude - origin.longitude) >> 4;
+  if (x >= 0x10000L || x <= -0x10000L)
+    return (false);
+  x = (x * cos) >> 15;
+  return (x <= 32767 && x >= -32767 && y <= 32767 && y >= -32767);
+}
+
+bool
+GPS_Track::Encoder::within(const GPS::fix_t& fix)
+{
+  uint16_t cos = GPS::cos_latitude(m_last.latitude);
+  int32_t dx, dy, px, py;
+  uint32_t len;
+
+
+  if (m_window == GPS_TRACK_WINDOW)
+    return (false);
+
+  /* Segment from last written fix to new fix */
+  if (!offset(m_last, cos, fix.latitude, fix.longitude, dx, dy))
+    return (false);
+  len = isqrt((uint32_t)(dx * dx) + (uint32_t)(dy * dy));
+
+  /* Every dropped fix, and the held fix, must be within tolerance */
+  for (uint8_t i = 0; i <= m_window; i++)
+    {
+      GPS::position_t latitude, longitude;
+
+      if (i < m_window)
+        {
+          latitude = m_window_latitude[i];
+          longitude = m_window_longitude[i];
+        }
+      else
+        {
+          latitude = m_hold.latitude;
+          longitude = m_hold.longitude;
+        }
+
+      if (!offset(m_last, cos, latitude, longitude, px, py))
+        return (false);
+
+      if (len == 0)
+        {
+          if ((uint32_t)(px * px) + (uint32_t)(py * py) >
+              (uint32_t)m_tolerance * m_tolerance)
+            return (false);
+        }
+      else
+        {
+          int32_t cross = px * dy - py * dx;
+          if (cross < 0)
+            cross = -cross;
+          if ((uint32_t)cross > (uint32_t)m_tolerance * len)
+            return (false);
+        }
+    }
+
+  return (true);
+}
+#endif
+
+void
+GPS_Track::Encoder::write(uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      m_device->putchar((value & 0x7f) | 0x80);
+      value >>= 7;
+      m_bytes++;
+    }
+  m_device->putchar(value);
+  m_bytes++;
+}
+
+void
+GPS_Track::Encoder::write(const GPS::fix_t& fix)
+{
+  uint32_t ms = time_to_millis(fix.time);
+  uint32_t last_ms = time_to_millis(m_last.time);
+  uint16_t mask;
+  bool key;
+
+
+  key = (m_key_countdown == 0);
+  if (key)
+    {
+      m_key_countdown = m_key_interval;
+      mask = KEY | TIME | DATE
+#ifndef GPS_TIME_ONLY
+        | LATITUDE | LONGITUDE | ALTITUDE | SPEED | COURSE | SATELLITES | HDOP
+#endif
+        ;
+      memset(&m_last, 0, sizeof(m_last));
+      last_ms = 0;
+    }
+  else
+    {
+      mask = 0;
+      if (ms != last_ms) mask |= TIME;
+      if (fix.date != m_last.date) mask |= DATE;
+#ifndef GPS_TIME_ONLY
+      if (fix.latitude != m_last.latitude) mask |= LATITUDE;
+      if (fix.longitude != m_last.longitude) mask |= LONGITUDE;
+      if (fix.altitude != m_last.altitude) mask |= ALTITUDE;
+      if (fix.speed != m_last.speed) mask |= SPEED;
+      if (fix.course != m_last.course) mask |= COURSE;
+      if (fix.satellites != m_last.satellites) mask |= SATELLITES;
+      if (fix.hdop != m_last.hdop) mask |= HDOP;
+#endif
+    }
+  m_key_countdown--;
+
+  write(mask);
+  if (mask & TIME)
+    write(zigzag(ms - last_ms));
+#ifndef GPS_TIME_ONLY
+  if (mask & LATITUDE)
+    write(zigzag(fix.latitude - m_last.latitude));
+  if (mask & LONGITUDE)
+    write(zigzag(fix.longitude - m_last.longitude));
+  if (mask & ALTITUDE)
+    write(zigzag(fix.altitude - m_last.altitude));
+  if (mask & SPEED)
+    write(zigzag(fix.speed - m_last.speed));
+  if (mask & COURSE)
+    write(zigzag(fix.course - m_last.course));
+#endif
+  if (mask & DATE)
+    write(fix.date);
+#ifndef GPS_TIME_ONLY
+  if (mask & SATELLITES)
+    write(fix.satellites);
+  if (mask & HDOP)
+    write(zigzag(fix.hdop - m_last.hdop));
+#endif
+
+  m_last = fix;
+  m_records++;
+}
+
+GPS_Track::Decoder::Decoder(IOStream::Device* device) :
+  m_device(device),
+  m_synced(false)
+{
+  memset(&m_last, 0, sizeof(m_last));
+}
+
+bool
+GPS_Track::Decoder::read(uint32_t& value)
+{
+  uint8_t shift = 0;
+  int c;
+
+
+  value = 0;
+  do
+    {
+      c = m_device->getchar();
+      if (c == IOStream::EOF || shift > 28)
+        return (false);
+      value |= (uint32_t)(c & 0x7f) << shift;
+      shift += 7;
+    } while (c & 0x80);
+
+  return (true);
+}
+
+bool
+GPS_Track::Decoder::decode(GPS::fix_t& fix)
+{
+  uint32_t mask;
+  uint32_t value;
+
+
+  while (read(mask))
+    {
+      if (mask & KEY)
+        {
+          memset(&m_last, 0, sizeof(m_last));
+          m_synced = true;
+        }
+
+      if (!m_synced)
+        {
+          /* Skip fields of delta record */
+          for (uint16_t bit = TIME; bit <= 0x200; bit <<= 1)
+            if ((mask & bit) && !read(value))
+              return (false);
+          continue;
+        }
+
+      if (mask & TIME)
+        {
+          if (!read(value))
+            return (false);
+          m_last.time = millis_to_time(time_to_millis(m_last.time) +
+                                       unzigzag(value));
+        }
+#ifndef GPS_TIME_ONLY
+      if (mask & LATITUDE)
+        {
+          if (!read(value))
+            return (false);
+          m_last.latitude += unzigzag(value);
+        }
+      if (mask & LONGITUDE)
+        {
+          if (!read(value))
+            return (false);
+          m_last.longitude += unzigzag(value);
+        }
+      if (mask & ALTITUDE)
+        {
+          if (!read(value))
+            return (false);
+          m_last.altitude += unzigzag(value);
+        }
+      if (mask & SPEED)
+        {
+          if (!read(value))
+            return (false);
+          m_last.speed += unzigzag(value);
+        }
+      if (mask & COURSE)
+        {
+          if (!read(value))
+            return (false);
+          m_last.course += unzigzag(value);
+        }
+#endif
+      if (mask & DATE)
+        {
+          if (!read(value))
+            return (false);
+          m_last.date = value;
+        }
+#ifndef GPS_TIME_ONLY
+      if (mask & SATELLITES)
+        {
+          if (!read(value))
+            return (false);
+          m_last.satellites = value;
+        }
+      if (mask & HDOP)
+        {
+          if (!read(value))
+            return (false);
+          m_last.hdop += unzigzag(value);
+        }
+#endif
+
+      fix = m_last;
+      return (true);
+    }
+
+  return (false);
+}
@@ -0,0 +1,222 @@
+/**
+ * @file ?/GPS_Track.hh
+ * @version 0.1
+ *
+ * @section License
+ * Copyright (C) 2015, jeditekunum
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ */
+
+#ifndef COSA_GPS_TRACK_HH
+#define COSA_GPS_TRACK_HH
+
+#include "Cosa/IOStream.hh"
+
+#include "GPS.hh"
+
+#define GPS_TRACK_WINDOW 8
+
+/**
+ * GPS Track
+ *
+ * Streaming track compression for fix logs. Each record starts with a
+ * varint field mask followed by the fields that changed, as zig-zag
+ * varint deltas against the previous record. Key records hold absolute
+ * values and are written every key_interval records so that a log can
+ * be decoded from any key record. A typical record is 5-8 bytes.
+ *
+ * In full builds the encoder can optionally drop fixes that lie within
+ * a given distance of the line between the fixes kept around them
+ * (opening window Douglas-Peucker over GPS_TRACK_WINDOW fixes).
+ */
+
+class GPS_Track {
+public:
+  /* Record field mask */
+  enum {
+    KEY = 0x01,
+    TIME = 0x02,
+#ifndef GPS_TIME_ONLY
+    LATITUDE = 0x04,
+    LONGITUDE = 0x08,
+    ALTITUDE = 0x10,
+    SPEED = 0x20,
+    COURSE = 0x40,
+#endif
+    DATE = 0x80
+#ifndef GPS_TIME_ONLY
+    ,
+    SATELLITES = 0x100,
+    HDOP = 0x200
+#endif
+  };
+
+  /**
+   * Convert time HHMMSSmmm to milliseconds since midnight.
+   * @param[in] time HHMMSSmmm
+   * @return milliseconds
+   */
+  static uint32_t time_to_millis(GPS::gps_time_t time);
+
+  /**
+   * Convert milliseconds since midnight to time HHMMSSmmm.
+   * @param[in] ms milliseconds
+   * @return time HHMMSSmmm
+   */
+  static GPS::gps_time_t millis_to_time(uint32_t ms);
+
+  /**
+   * GPS Track Encoder
+   */
+  class Encoder : public GPS::Listener {
+  public:
+    /**
+     * Construct encoder writing to given device.
+     * @param[in] device to write records to
+     * @param[in] tolerance simplification error bound in meters, 0 to
+     *   keep every fix (full builds only)
+     * @param[in] key_interval records between key records
+     */
+    Encoder(IOStream::Device* device,
+            uint16_t tolerance = 0,
+            uint8_t key_interval = 32);
+
+    /**
+     * Restart; next record is a key record.
+     */
+    void reset();
+
+    /**
+     * Consume committed fix from given gps.
+     * @param[in] gps
+     */
+    void update(GPS& gps);
+
+    /**
+     * @override GPS::Listener
+     * Consume committed fix.
+     * @param[in] gps
+     */
+    virtual void on_fix(GPS& gps)
+    {
+      update(gps);
+    }
+
+    /**
+     * Consume fix.
+     * @param[in] fix
+     */
+    void encode(const GPS::fix_t& fix);
+
+    /**
+     * Write fix held back by simplification, if any. Call before the
+     * log is closed.
+     */
+    void flush();
+
+    /**
+     * Get number of fixes consumed
+     * @return fixes
+     */
+    uint32_t fixes()
+      __attribute__((always_inline))
+    {
+      return (m_fixes);
+    }
+
+    /**
+     * Get number of records written
+     * @return records
+     */
+    uint32_t records()
+      __attribute__((always_inline))
+    {
+      return (m_records);
+    }
+
+    /**
+     * Get number of bytes written
+     * @return bytes
+     */
+    uint32_t bytes()
+      __attribute__((always_inline))
+    {
+      return (m_bytes);
+    }
+
+  protected:
+    IOStream::Device* m_device;
+    uint8_t m_key_interval;
+    uint8_t m_key_countdown;
+
+    /* Last written record */
+    GPS::fix_t m_last;
+
+    /* Statistics */
+    uint32_t m_fixes;
+    uint32_t m_records;
+    uint32_t m_bytes;
+
+#ifndef GPS_TIME_ONLY
+    /* Tolerance in units of 16 millionths of a degree, 0 if disabled */
+    uint16_t m_tolerance;
+
+    /* Fix held back; written if the next fix breaks the tolerance */
+    bool m_pending;
+    GPS::fix_t m_hold;
+
+    /* Fixes dropped since last written, positions only */
+    uint8_t m_window;
+    GPS::position_t m_window_latitude[GPS_TRACK_WINDOW];
+    GPS::position_t m_window_longitude[GPS_TRACK_WINDOW];
+
+    /* Can fix replace held fix without breaking tolerance? */
+    bool within(const GPS::fix_t& fix);
+#endif
+
+    /* Write record */
+    void write(const GPS::fix_t& fix);
+
+    /* Write varint */
+    void write(uint32_t value);
+  };
+
+  /**
+   * GPS Track Decoder
+   */
+  class Decoder {
+  public:
+    /**
+     * Construct decoder reading from given device.
+     * @param[in] device to read records from
+     */
+    Decoder(IOStream::Device* device);
+
+    /**
+     * Decode next record. Records before the first key record are
+     * skipped.
+     * @param[out] fix
+     * @return true if a fix was decoded, false at end of data
+     */
+    bool decode(GPS::fix_t& fix);
+
+  protected:
+    IOStream::Device* m_device;
+    bool m_synced;
+    GPS::fix_t m_last;
+
+    /* Read varint, false at end of data */
+    bool read(uint32_t& value);
+  };
+};
+#endif
@@ -0,0 +1,42 @@
+/**
+ * @file Cosa/EEPROM.hh
+ *
+ * Host stand-in for the Cosa header of the same name; the EEPROM is a
+ * RAM array of EEPROM::SIZE bytes, addressed by pointer value.
+ */
+
+#ifndef COSA_EEPROM_HH
+#define COSA_EEPROM_HH
+
+#include "Cosa/Types.h"
+
+class EEPROM {
+public:
+  static const size_t SIZE = 1024;
+
+  class Device {
+  public:
+    virtual ~Device() {}
+    virtual bool is_ready() { return (true); }
+    virtual int read(void* dest, const void* src, size_t size);
+    virtual int write(void* dest, const void* src, size_t size);
+    static Device eeprom;
+  };
+
+  EEPROM(Device* device = &Device::eeprom) : m_device(device) {}
+
+  int read(void* dest, const void* src, size_t size)
+  {
+    return (m_device->read(dest, src, size));
+  }
+
+  int write(void* dest, const void* src, size_t size)
+  {
+    return (m_device->write(dest, src, size));
+  }
+
+protected:
+  Device* m_device;
+};
+
+#endif
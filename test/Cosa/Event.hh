@@ -0,0 +1,47 @@
+/**
+ * @file Cosa/Event.hh
+ *
+ * Host stand-in for the Cosa header of the same name; a bounded event
+ * queue dispatched by service().
+ */
+
+#ifndef COSA_EVENT_HH
+#define COSA_EVENT_HH
+
+#include "Cosa/Types.h"
+
+class Event {
+public:
+  enum {
+    NULL_TYPE = 0,
+    RECEIVE_COMPLETED_TYPE = 2,
+    TIMEOUT_TYPE = 32,
+    RUN_TYPE = 33,
+    SERVICE_REQUEST_TYPE = 36,
+    USER_TYPE = 64
+  };
+
+  static const uint8_t QUEUE_MAX = 16;
+
+  class Handler {
+  public:
+    virtual ~Handler() {}
+    virtual void on_event(uint8_t type, uint16_t value)
+    {
+      UNUSED(type);
+      UNUSED(value);
+    }
+  };
+
+  /**
+   * Queue event; false if the queue is full.
+   */
+  static bool push(uint8_t type, Handler* target, uint16_t value = 0);
+
+  /**
+   * Dispatch next event; false if none.
+   */
+  static bool service(uint32_t ms = 0);
+};
+
+#endif
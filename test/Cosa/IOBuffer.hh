@@ -0,0 +1,57 @@
+/**
+ * @file Cosa/IOBuffer.hh
+ *
+ * Host stand-in for the Cosa header of the same name; ring buffer of
+ * SIZE (power of two) holding SIZE - 1 characters.
+ */
+
+#ifndef COSA_IOBUFFER_HH
+#define COSA_IOBUFFER_HH
+
+#include "Cosa/IOStream.hh"
+
+template<uint16_t SIZE>
+class IOBuffer : public IOStream::Device {
+public:
+  IOBuffer() : m_head(0), m_tail(0) {}
+
+  bool is_empty() { return (m_head == m_tail); }
+  bool is_full() { return (((m_head + 1) & (SIZE - 1)) == m_tail); }
+
+  virtual int available() { return ((SIZE + m_head - m_tail) & (SIZE - 1)); }
+  virtual int room() { return (SIZE - available() - 1); }
+
+  virtual int putchar(char c)
+  {
+    uint16_t next = (m_head + 1) & (SIZE - 1);
+    if (next == m_tail)
+      return (IOStream::EOF);
+    m_buffer[next] = c;
+    m_head = next;
+    return ((uint8_t) c);
+  }
+
+  virtual int peekchar()
+  {
+    if (m_head == m_tail)
+      return (IOStream::EOF);
+    return ((uint8_t) m_buffer[(m_tail + 1) & (SIZE - 1)]);
+  }
+
+  virtual int getchar()
+  {
+    if (m_head == m_tail)
+      return (IOStream::EOF);
+    m_tail = (m_tail + 1) & (SIZE - 1);
+    return ((uint8_t) m_buffer[m_tail]);
+  }
+
+  virtual void empty() { m_head = m_tail = 0; }
+
+private:
+  volatile uint16_t m_head;
+  volatile uint16_t m_tail;
+  char m_buffer[SIZE];
+};
+
+#endif
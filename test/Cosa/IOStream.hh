@@ -0,0 +1,86 @@
+/**
+ * @file Cosa/IOStream.hh
+ *
+ * Host stand-in for the Cosa header of the same name. A stream without
+ * device prints to stdout.
+ */
+
+#ifndef COSA_IOSTREAM_HH
+#define COSA_IOSTREAM_HH
+
+#include "Cosa/Types.h"
+
+#undef EOF
+
+class IOStream {
+public:
+  static const int EOF = -1;
+  static const char CRLF[];
+
+  class Device {
+  public:
+    virtual ~Device() {}
+    virtual int available() { return (0); }
+    virtual int room() { return (0); }
+    virtual int putchar(char c) { return ((uint8_t) c); }
+    virtual int puts(const char* s)
+    {
+      while (*s)
+        if (putchar(*s++) < 0)
+          return (EOF);
+      return (0);
+    }
+    virtual int write(const void* buf, size_t size)
+    {
+      const char* p = (const char*) buf;
+      for (size_t n = 0; n < size; n++)
+        if (putchar(p[n]) < 0)
+          return (n);
+      return (size);
+    }
+    virtual int getchar() { return (EOF); }
+    virtual int peekchar() { return (EOF); }
+    virtual int read(void* buf, size_t size)
+    {
+      char* p = (char*) buf;
+      size_t n = 0;
+      for (; n < size; n++)
+        {
+          int c = getchar();
+          if (c < 0)
+            break;
+          p[n] = c;
+        }
+      return (n);
+    }
+    virtual void empty() {}
+    virtual int flush() { return (0); }
+  };
+
+  enum Base { bcd = 0, bin = 2, oct = 8, dec = 10, hex = 16 };
+
+  IOStream(Device* device = NULL) : m_device(device), m_base(dec) {}
+
+  Device* device() { return (m_device); }
+  void device(Device* device) { m_device = device; }
+
+  IOStream& operator<<(int n);
+  IOStream& operator<<(long n);
+  IOStream& operator<<(unsigned int n);
+  IOStream& operator<<(unsigned long n);
+  IOStream& operator<<(double n);
+  IOStream& operator<<(char c);
+  IOStream& operator<<(const char* s);
+  IOStream& operator<<(Base base);
+  IOStream& operator<<(IOStream& (*manipulator)(IOStream&));
+
+protected:
+  Device* m_device;
+  Base m_base;
+
+  void print(const char* s);
+};
+
+IOStream& endl(IOStream& outs);
+
+#endif
@@ -0,0 +1,41 @@
+/**
+ * @file Cosa/Job.hh
+ *
+ * Host stand-in for the Cosa header of the same name; jobs are run by
+ * the test, not scheduled.
+ */
+
+#ifndef COSA_JOB_HH
+#define COSA_JOB_HH
+
+#include "Cosa/Event.hh"
+
+class Job : public Event::Handler {
+public:
+  class Scheduler {
+  public:
+    virtual ~Scheduler() {}
+    virtual uint32_t time() = 0;
+  };
+
+  Job(Scheduler* scheduler) :
+    m_scheduler(scheduler),
+    m_expires(0),
+    m_started(false)
+  {}
+
+  virtual void run() {}
+
+  bool start() { m_started = true; return (true); }
+  bool stop() { m_started = false; return (true); }
+  bool is_started() const { return (m_started); }
+  void expire_at(uint32_t time) { m_expires = time; }
+  uint32_t expire_at() const { return (m_expires); }
+
+protected:
+  Scheduler* m_scheduler;
+  uint32_t m_expires;
+  bool m_started;
+};
+
+#endif
@@ -0,0 +1,26 @@
+/**
+ * @file Cosa/Periodic.hh
+ *
+ * Host stand-in for the Cosa header of the same name.
+ */
+
+#ifndef COSA_PERIODIC_HH
+#define COSA_PERIODIC_HH
+
+#include "Cosa/Job.hh"
+
+class Periodic : public Job {
+public:
+  Periodic(Job::Scheduler* scheduler, uint32_t period) :
+    Job(scheduler),
+    m_period(period)
+  {}
+
+  void period(uint32_t period) { m_period = period; }
+  uint32_t period() const { return (m_period); }
+
+protected:
+  uint32_t m_period;
+};
+
+#endif
@@ -0,0 +1,24 @@
+/**
+ * @file Cosa/RTT.hh
+ *
+ * Host stand-in for the Cosa header of the same name. Milliseconds are
+ * simulated and advanced by the test (host_millis); microseconds are
+ * real, for measurements.
+ */
+
+#ifndef COSA_RTT_HH
+#define COSA_RTT_HH
+
+#include "Cosa/Types.h"
+
+extern uint32_t host_millis;
+
+class RTT {
+public:
+  static uint32_t millis() { return (host_millis); }
+  static uint32_t micros();
+  static uint32_t since(uint32_t start) { return (host_millis - start); }
+  static void delay(uint32_t ms) { host_millis += ms; }
+};
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @file Cosa/Time.hh
+ *
+ * Host stand-in for the Cosa header of the same name; seconds since
+ * 2000-01-01 00:00:00 and broken down time.
+ */
+
+#ifndef COSA_TIME_HH
+#define COSA_TIME_HH
+
+#include "Cosa/Types.h"
+
+/* Keep clear of the C library types */
+#define clock_t cosa_clock_t
+#define time_t cosa_time_t
+
+typedef uint32_t clock_t;
+
+struct time_t {
+  uint8_t seconds;
+  uint8_t minutes;
+  uint8_t hours;
+  uint8_t day;                  // 1..7, Sunday 1
+  uint8_t date;                 // 1..31
+  uint8_t month;                // 1..12
+  uint8_t year;                 // 0..99, 2000..2099
+
+  time_t() {}
+  time_t(clock_t c, int8_t zone = 0);
+  operator clock_t() const;
+};
+
+#endif
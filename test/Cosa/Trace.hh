@@ -0,0 +1,14 @@
+/**
+ * @file Cosa/Trace.hh
+ *
+ * Host stand-in for the Cosa header of the same name.
+ */
+
+#ifndef COSA_TRACE_HH
+#define COSA_TRACE_HH
+
+#include "Cosa/IOStream.hh"
+
+extern IOStream trace;
+
+#endif
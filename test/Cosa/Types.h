@@ -0,0 +1,38 @@
+/**
+ * @file Cosa/Types.h
+ *
+ * Host stand-in for the Cosa header of the same name; only what the
+ * library uses. Program memory is ordinary memory and interrupts are
+ * not masked.
+ */
+
+#ifndef COSA_TYPES_H
+#define COSA_TYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define __PROGMEM
+#define PROGMEM
+#define PSTR(s) ((const char*) (s))
+typedef const char* str_P;
+
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define pgm_read_word(p) (*(const uint16_t*) (p))
+#define pgm_read_dword(p) (*(const uint32_t*) (p))
+#define strlen_P strlen
+#define strncmp_P strncmp
+
+#define UNUSED(x) (void) (x)
+#define membersof(x) (sizeof(x) / sizeof((x)[0]))
+#define _BV(bit) (1 << (bit))
+
+inline uint8_t lock() { return (0); }
+inline void unlock(uint8_t key) { UNUSED(key); }
+#define synchronized                                                    \
+  for (uint8_t __key = lock(), __i = 1; __i != 0; __i--, unlock(__key))
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * @file host.cpp
+ *
+ * Host implementation of the Cosa stand-ins in Cosa/.
+ */
+
+#include <time.h>
+
+#include "Cosa/IOStream.hh"
+#include "Cosa/Trace.hh"
+#include "Cosa/RTT.hh"
+#include "Cosa/Time.hh"
+#include "Cosa/Event.hh"
+#include "Cosa/EEPROM.hh"
+
+const char IOStream::CRLF[] = "\r\n";
+
+IOStream trace;
+
+void
+IOStream::print(const char* s)
+{
+  if (m_device == NULL)
+    fputs(s, stdout);
+  else
+    m_device->puts(s);
+}
+
+IOStream&
+IOStream::operator<<(long n)
+{
+  char buf[24];
+
+  snprintf(buf, sizeof(buf), m_base == hex ? "%lx" : "%ld", n);
+  print(buf);
+  m_base = dec;
+  return (*this);
+}
+
+IOStream&
+IOStream::operator<<(unsigned long n)
+{
+  char buf[24];
+
+  snprintf(buf, sizeof(buf), m_base == hex ? "%lx" : "%lu", n);
+  print(buf);
+  m_base = dec;
+  return (*this);
+}
+
+IOStream& IOStream::operator<<(int n) { return (*this << (long) n); }
+IOStream& IOStream::operator<<(unsigned int n) { return (*this << (unsigned long) n); }
+
+IOStream&
+IOStream::operator<<(double n)
+{
+  char buf[32];
+
+  snprintf(buf, sizeof(buf), "%.2f", n);
+  print(buf);
+  return (*this);
+}
+
+IOStream&
+IOStream::operator<<(char c)
+{
+  char buf[2] = { c, 0 };
+
+  print(buf);
+  return (*this);
+}
+
+IOStream& IOStream::operator<<(const char* s) { print(s); return (*this); }
+IOStream& IOStream::operator<<(Base base) { m_base = base; return (*this); }
+
+IOStream&
+IOStream::operator<<(IOStream& (*manipulator)(IOStream&))
+{
+  return (manipulator(*this));
+}
+
+IOStream&
+endl(IOStream& outs)
+{
+  return (outs << IOStream::CRLF);
+}
+
+/* Simulated milliseconds; starts away from zero */
+uint32_t host_millis = 1000;
+
+uint32_t
+RTT::micros()
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec * 1000000UL + now.tv_nsec / 1000);
+}
+
+/* Days before month, non-leap year */
+static const uint16_t DAYS[] = {
+  0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334
+};
+
+time_t::operator clock_t() const
+{
+  uint32_t days = year * 365UL + (year + 3) / 4 + DAYS[month - 1] + date - 1;
+
+  if (month > 2 && (year % 4) == 0)
+    days++;
+  return (((days * 24 + hours) * 60 + minutes) * 60 + seconds);
+}
+
+time_t::time_t(clock_t c, int8_t zone)
+{
+  uint32_t days;
+  uint16_t length;
+
+  c += zone * 3600L;
+  seconds = c % 60;
+  minutes = (c / 60) % 60;
+  hours = (c / 3600) % 24;
+  days = c / 86400;
+  day = (days + 6) % 7 + 1;     // 2000-01-01 was a Saturday
+  for (year = 0; days >= (length = (year % 4) ? 365 : 366); year++)
+    days -= length;
+  for (month = 12; month > 1; month--)
+    if (days >= (uint32_t) (DAYS[month - 1] + (month > 2 && (year % 4) == 0)))
+      break;
+  date = days - DAYS[month - 1] - (month > 2 && (year % 4) == 0) + 1;
+}
+
+/* Event queue */
+static struct {
+  uint8_t type;
+  Event::Handler* target;
+  uint16_t value;
+} queue[Event::QUEUE_MAX];
+static uint8_t head = 0;
+static uint8_t count = 0;
+
+bool
+Event::push(uint8_t type, Handler* target, uint16_t value)
+{
+  uint8_t tail;
+
+  if (count == QUEUE_MAX)
+    return (false);
+  tail = (head + count++) % QUEUE_MAX;
+  queue[tail].type = type;
+  queue[tail].target = target;
+  queue[tail].value = value;
+  return (true);
+}
+
+bool
+Event::service(uint32_t ms)
+{
+  uint8_t type;
+  Handler* target;
+  uint16_t value;
+
+  UNUSED(ms);
+  if (count == 0)
+    return (false);
+  type = queue[head].type;
+  target = queue[head].target;
+  value = queue[head].value;
+  head = (head + 1) % QUEUE_MAX;
+  count--;
+  target->on_event(type, value);
+  return (true);
+}
+
+/* EEPROM */
+static uint8_t memory[EEPROM::SIZE];
+
+EEPROM::Device EEPROM::Device::eeprom;
+
+int
+EEPROM::Device::read(void* dest, const void* src, size_t size)
+{
+  size_t addr = (size_t) src;
+
+  if (addr + size > sizeof(memory))
+    return (-1);
+  memcpy(dest, memory + addr, size);
+  return (size);
+}
+
+int
+EEPROM::Device::write(void* dest, const void* src, size_t size)
+{
+  size_t addr = (size_t) dest;
+
+  if (addr + size > sizeof(memory))
+    return (-1);
+  memcpy(memory + addr, src, size);
+  return (size);
+}
@@ -0,0 +1,163 @@
+/**
+ * @file test.hh
+ *
+ * Host test support: checks, simulated time and in-memory devices.
+ */
+
+#ifndef TEST_HH
+#define TEST_HH
+
+#include <string>
+
+#include "Cosa/IOStream.hh"
+#include "Cosa/RTT.hh"
+#include "Cosa/Event.hh"
+
+/* Failed checks */
+extern int test_failures;
+extern int test_checks;
+
+#define CHECK(expr)                                                     \
+  test_check((expr), #expr, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual)                                   \
+  test_equal((long long) (expected), (long long) (actual),             \
+             #actual, __FILE__, __LINE__)
+
+inline bool
+test_check(bool ok, const char* expr, const char* file, int line)
+{
+  test_checks++;
+  if (!ok)
+    {
+      test_failures++;
+      printf("%s:%d: check failed: %s\n", file, line, expr);
+    }
+  return (ok);
+}
+
+inline bool
+test_equal(long long expected, long long actual, const char* expr,
+           const char* file, int line)
+{
+  test_checks++;
+  if (expected != actual)
+    {
+      test_failures++;
+      printf("%s:%d: %s is %lld, expected %lld\n",
+             file, line, expr, actual, expected);
+    }
+  return (expected == actual);
+}
+
+/* Summary and exit status */
+inline int
+test_report(const char* name)
+{
+  printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+  return (test_failures != 0);
+}
+
+#define TEST_DEFINE                                                     \
+  int test_failures = 0;                                                \
+  int test_checks = 0
+
+/* Advance simulated time */
+inline void
+host_advance(uint32_t ms)
+{
+  host_millis += ms;
+}
+
+/* Dispatch queued events */
+inline void
+host_dispatch()
+{
+  while (Event::service())
+    ;
+}
+
+/* Sentence "$body*CS\r\n" */
+inline std::string
+nmea(const char* body)
+{
+  uint8_t parity = 0;
+  char buf[256];
+
+  for (const char* p = body; *p; p++)
+    parity ^= *p;
+  snprintf(buf, sizeof(buf), "$%s*%02X\r\n", body, parity);
+  return (buf);
+}
+
+/* Read whole file, empty if missing */
+inline std::string
+load(const char* path)
+{
+  std::string data;
+  FILE* file = fopen(path, "rb");
+  char buf[4096];
+  size_t n;
+
+  if (file == NULL)
+    {
+      printf("cannot open %s\n", path);
+      return (data);
+    }
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+    data.append(buf, n);
+  fclose(file);
+  return (data);
+}
+
+/**
+ * In-memory device; reads from input, writes to output with room
+ * limited to ROOM (e.g. to hold back transmission).
+ */
+class Buffer : public IOStream::Device {
+public:
+  std::string input;
+  std::string output;
+  size_t offset;
+  int limit;
+
+  Buffer(int room = 256) : offset(0), limit(room) {}
+
+  virtual int available() { return (input.size() - offset); }
+  virtual int room() { return (limit); }
+
+  virtual int putchar(char c)
+  {
+    output += c;
+    return ((uint8_t) c);
+  }
+
+  virtual int getchar()
+  {
+    if (offset == input.size())
+      return (IOStream::EOF);
+    return ((uint8_t) input[offset++]);
+  }
+
+  virtual int read(void* buf, size_t size)
+  {
+    size_t n = input.size() - offset;
+
+    if (n > size)
+      n = size;
+    memcpy(buf, input.data() + offset, n);
+    offset += n;
+    return (n);
+  }
+
+  /* Take written output */
+  std::string take()
+  {
+    std::string s;
+
+    s.swap(output);
+    return (s);
+  }
+};
+
+#endif
@@ -0,0 +1,155 @@
+/**
+ * @file test_baud.cpp
+ *
+ * GPS_NMEA baud rate detection against the emulator: garbled output
+ * (FAULT_BAUDRATE) is detected and the rate found again, a receiver
+ * rebooted to its default rate is found and switched back with PMTK251,
+ * and a receiver that does not follow PMTK251 is searched again and
+ * kept at the rate found.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA_MT3339.hh"
+#include "GPS_NMEA_MT3339_Emulator.hh"
+
+TEST_DEFINE;
+
+/* Receiver on the emulator; the device rate is that of the emulator */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  std::vector<uint32_t> rates;
+  bool follow;
+
+  Receiver(GPS_NMEA_MT3339_Emulator* emulator) :
+    GPS_NMEA_MT3339(emulator),
+    follow(true),
+    m_emulator(emulator)
+  {}
+
+  /* Read what the emulator has, then transmit */
+  void poll()
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    int c;
+
+    while ((c = m_device->getchar()) != IOStream::EOF)
+      putchar(c);
+    transmit();
+#else
+    consume();
+#endif
+  }
+
+protected:
+  GPS_NMEA_MT3339_Emulator* m_emulator;
+
+  virtual bool device_baudrate(uint32_t rate)
+  {
+    rates.push_back(rate);
+    m_emulator->device_baudrate(rate);
+    return (true);
+  }
+
+  /* Command lost unless followed */
+  virtual bool receiver_baudrate(uint32_t rate)
+  {
+    if (!follow)
+      return (true);
+    return (GPS_NMEA_MT3339::receiver_baudrate(rate));
+  }
+};
+
+/* Run until hunting is as given, at most ms; true if it was */
+static bool
+run(Receiver& gps, bool hunting, uint32_t ms)
+{
+  for (uint32_t t = 0; t < ms; t += 10)
+    {
+      host_advance(10);
+      gps.poll();
+      if (gps.hunting() == hunting)
+        return (true);
+    }
+  return (false);
+}
+
+/* Run for given time; commits */
+static uint16_t
+commits(Receiver& gps, uint32_t ms)
+{
+  uint16_t start = gps.commits();
+
+  for (uint32_t t = 0; t < ms; t += 10)
+    {
+      host_advance(10);
+      gps.poll();
+    }
+  return (gps.commits() - start);
+}
+
+int
+main()
+{
+  GPS_NMEA_MT3339_Emulator emulator;
+  Receiver gps(&emulator);
+  size_t i;
+
+  emulator.baudrate(115200);
+  emulator.device_baudrate(115200);
+  CHECK(gps.begin());
+  gps.detect(115200);
+  CHECK(commits(gps, 3000) > 0);
+  CHECK(!gps.hunting());
+  CHECK_EQUAL(0, gps.resyncs());
+  CHECK_EQUAL(0, gps.recovery());
+
+  /* Garbled output; hunting until clean at the configured rate */
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_BAUDRATE);
+  CHECK(run(gps, true, 5000));
+  CHECK_EQUAL(1, gps.resyncs());
+  CHECK(!run(gps, false, 30000));
+  emulator.faults(0, 0);
+  CHECK(run(gps, false, 30000));
+  CHECK_EQUAL(115200UL, gps.baudrate());
+  CHECK(gps.recovery() > 10000);
+  CHECK(commits(gps, 3000) > 0);
+
+  /* Receiver back at its default rate; found and switched back */
+  gps.rates.clear();
+  emulator.baudrate(9600);
+  CHECK(run(gps, true, 5000));
+  CHECK(run(gps, false, 30000));
+  CHECK_EQUAL(2, gps.resyncs());
+  CHECK_EQUAL(115200UL, gps.baudrate());
+  CHECK_EQUAL(115200UL, emulator.baudrate());
+  if (CHECK(gps.rates.size() >= 2))
+    {
+      CHECK_EQUAL(9600UL, gps.rates[gps.rates.size() - 2]);
+      CHECK_EQUAL(115200UL, gps.rates.back());
+    }
+  CHECK(gps.recovery() > 0);
+  CHECK(commits(gps, 3000) > 0);
+  printf("baud: restored in %lu ms\n", (unsigned long) gps.recovery());
+
+  /* Switch not followed; searched again and kept at the rate found */
+  gps.rates.clear();
+  gps.follow = false;
+  emulator.baudrate(9600);
+  CHECK(run(gps, true, 5000));
+  CHECK(run(gps, false, 30000));
+  CHECK_EQUAL(3, gps.resyncs());
+  CHECK_EQUAL(9600UL, gps.baudrate());
+  CHECK_EQUAL(9600UL, emulator.baudrate());
+  for (i = 0; i < gps.rates.size() && gps.rates[i] != 9600; i++)
+    ;
+  CHECK(i + 1 < gps.rates.size());
+  if (i + 1 < gps.rates.size())
+    CHECK_EQUAL(115200UL, gps.rates[i + 1]);
+  CHECK_EQUAL(9600UL, gps.rates.back());
+  CHECK(commits(gps, 3000) > 0);
+  printf("baud: searched in %lu ms\n", (unsigned long) gps.recovery());
+
+  return (test_report("baud"));
+}
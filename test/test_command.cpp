@@ -0,0 +1,229 @@
+/**
+ * @file test_command.cpp
+ *
+ * GPS_NMEA_Command field formatting and the GPS_NMEA_MT3339 command
+ * queue: PMTK001 matching, retries, timeouts, cancellation on reset()
+ * and end() with a full queue. Time to first fix across a factory
+ * reset. With
+ * GPS_INTERRUPT_IMPL acknowledgements are only recorded by the parser
+ * and must complete in transmit().
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA_Command.hh"
+#include "GPS_NMEA_MT3339.hh"
+
+TEST_DEFINE;
+
+/* Receiver fed as the serial driver would; records completions */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  std::vector<uint16_t> command;
+  std::vector<uint8_t> status;
+
+  Receiver(IOStream::Device* device) : GPS_NMEA_MT3339(device) {}
+
+  void feed(const std::string& s)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      putchar(s[i]);
+#else
+    GPS_NMEA_MT3339::feed(s.data(), s.size());
+#endif
+  }
+
+  /* Acknowledge and run transmit() as the application would */
+  void ack(uint16_t number, uint8_t result)
+  {
+    size_t completed = status.size();
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "PMTK001,%u,%u", number, result);
+    feed(nmea(buf));
+#ifdef GPS_INTERRUPT_IMPL
+    CHECK_EQUAL(completed, status.size());
+#else
+    (void) completed;
+#endif
+    transmit();
+  }
+
+  void clear()
+  {
+    command.clear();
+    status.clear();
+  }
+
+protected:
+  virtual void command_completed(uint16_t number, uint8_t result)
+  {
+    command.push_back(number);
+    status.push_back(result);
+  }
+};
+
+static void
+epoch(Receiver& gps)
+{
+  gps.feed(nmea("GPRMC,080000.000,A,5919.7576,N,01804.1168,E,"
+                "0.00,0.00,111026,,,A"));
+  gps.feed(nmea("GPGGA,080000.000,5919.7576,N,01804.1168,E,"
+                "1,09,0.9,28.0,M,0.0,M,,"));
+}
+
+static size_t
+count(const std::string& s, const char* what)
+{
+  size_t n = 0;
+
+  for (size_t i = s.find(what); i != std::string::npos;
+       i = s.find(what, i + 1))
+    n++;
+  return (n);
+}
+
+/* Field formatting */
+static void
+fields()
+{
+  Buffer device;
+  GPS_NMEA_Command out(&device);
+
+  out.field(-123456, 3, 2);
+  out.field(-2147483647 - 1);
+  out.field(7, 2);
+  out.field(1, 40, 40);
+  CHECK(device.take() ==
+        ",-123.456,-2147483648,0.07,0.00000000001");
+}
+
+int
+main()
+{
+  Buffer device;
+  Receiver gps(&device);
+
+  fields();
+
+  /* Wake is not acknowledged */
+  CHECK(gps.begin());
+  CHECK_EQUAL(1, gps.command.size());
+  CHECK_EQUAL(0, gps.command[0]);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, gps.status[0]);
+  gps.clear();
+
+  /* First sentence selects sentences */
+  epoch(gps);
+  gps.transmit();
+  CHECK_EQUAL(1, count(device.take(), "$PMTK314,"));
+  CHECK_EQUAL(1, gps.pending());
+  gps.ack(314, GPS_NMEA_MT3339::STATUS_SUCCESS);
+  CHECK_EQUAL(0, gps.pending());
+  CHECK_EQUAL(1, gps.command.size());
+  CHECK_EQUAL(314, gps.command[0]);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, gps.status[0]);
+  gps.clear();
+
+  /* Out of range rate is not queued */
+  CHECK(!gps.rate(99));
+  CHECK(!gps.rate(10001));
+  CHECK_EQUAL(0, gps.pending());
+
+  /* Failed is retried */
+  CHECK(gps.rate(200));
+  CHECK_EQUAL(1, count(device.take(), "$PMTK220,200*"));
+  gps.ack(220, GPS_NMEA_MT3339::STATUS_FAILED);
+  CHECK_EQUAL(0, gps.command.size());
+  CHECK_EQUAL(1, count(device.take(), "$PMTK220,200*"));
+  gps.ack(220, GPS_NMEA_MT3339::STATUS_SUCCESS);
+  CHECK_EQUAL(1, gps.command.size());
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, gps.status[0]);
+  gps.clear();
+
+  /* Unacknowledged is retried, then times out */
+  CHECK(gps.rate(500));
+  for (uint8_t i = 0; i < GPS_NMEA_MT3339_RETRIES; i++)
+    {
+      host_advance(GPS_NMEA_MT3339_ACK_TIMEOUT);
+      gps.transmit();
+    }
+  CHECK_EQUAL(1 + GPS_NMEA_MT3339_RETRIES,
+              count(device.take(), "$PMTK220,500*"));
+  CHECK_EQUAL(0, gps.command.size());
+  host_advance(GPS_NMEA_MT3339_ACK_TIMEOUT);
+  gps.transmit();
+  CHECK_EQUAL(1, gps.command.size());
+  CHECK_EQUAL(220, gps.command[0]);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_TIMEOUT, gps.status[0]);
+  gps.clear();
+
+  /* Reset drops queued commands as cancelled */
+  device.limit = 0;
+  CHECK(gps.locus_query());
+  CHECK(gps.rate(1000));
+  CHECK_EQUAL(2, gps.pending());
+  gps.reset();
+  CHECK_EQUAL(0, gps.pending());
+  CHECK_EQUAL(2, gps.command.size());
+  CHECK_EQUAL(183, gps.command[0]);
+  CHECK_EQUAL(220, gps.command[1]);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_CANCELLED, gps.status[0]);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_CANCELLED, gps.status[1]);
+  gps.clear();
+
+  /* End is deferred until standby is acknowledged */
+  device.limit = 256;
+  epoch(gps);
+  gps.transmit();
+  gps.ack(314, GPS_NMEA_MT3339::STATUS_SUCCESS);
+  device.take();
+  gps.clear();
+  gps.end();
+  CHECK(!gps.active());
+  CHECK_EQUAL(1, count(device.take(), "$PMTK161,0*"));
+  gps.ack(161, GPS_NMEA_MT3339::STATUS_SUCCESS);
+  CHECK_EQUAL(1, gps.command.size());
+  CHECK_EQUAL(161, gps.command[0]);
+  gps.clear();
+
+  /* End with a full queue ends at once */
+  CHECK(gps.begin());
+  epoch(gps);
+  gps.transmit();
+  gps.ack(314, GPS_NMEA_MT3339::STATUS_SUCCESS);
+  device.take();
+  device.limit = 0;
+  gps.clear();
+  while (gps.locus_query())
+    ;
+  CHECK_EQUAL(GPS_NMEA_MT3339_COMMANDS, gps.pending());
+  gps.end();
+  CHECK(!gps.active());
+  CHECK_EQUAL(0, gps.pending());
+  CHECK_EQUAL(1, count(device.take(), "$PMTK161,0*"));
+  CHECK_EQUAL(GPS_NMEA_MT3339_COMMANDS, gps.command.size());
+  for (size_t i = 0; i < gps.status.size(); i++)
+    CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_CANCELLED, gps.status[i]);
+
+  /* Time to first fix, measured again after a factory reset */
+  device.limit = 256;
+  CHECK(gps.begin());
+  CHECK(!gps.ttff_measured());
+  host_advance(1200);
+  epoch(gps);
+  CHECK(gps.ttff_measured());
+  CHECK_EQUAL(1200, gps.ttff());
+  gps.factory_reset();
+  CHECK(gps.active());
+  CHECK(!gps.ttff_measured());
+  CHECK_EQUAL(0, gps.ttff());
+  host_advance(300);
+  epoch(gps);
+  CHECK(gps.ttff_measured());
+  CHECK_EQUAL(300, gps.ttff());
+
+  return (test_report("command"));
+}
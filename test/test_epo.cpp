@@ -0,0 +1,177 @@
+/**
+ * @file test_epo.cpp
+ *
+ * GPS_NMEA_MT3339 EPO upload against the emulator in binary mode: a
+ * full upload, failed packets that are retried, failure after the
+ * retries, a receiver that does not acknowledge, and packets after a
+ * stray preamble byte.
+ */
+
+#include "test.hh"
+#include "GPS_NMEA_MT3339.hh"
+#include "GPS_NMEA_MT3339_Emulator.hh"
+
+TEST_DEFINE;
+
+/* EPO data; 10 packets of three 60 byte records */
+static const size_t EPO_SIZE = 10 * GPS_NMEA_MT3339::EPO::DATA;
+
+/* Receiver fed as the serial driver would; records completions */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  uint16_t completed;
+  uint8_t status;
+
+  Receiver(IOStream::Device* device) :
+    GPS_NMEA_MT3339(device),
+    completed(0),
+    status(0)
+  {}
+
+  /* Read what the emulator has, then transmit */
+  void poll()
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    int c;
+
+    while ((c = m_device->getchar()) != IOStream::EOF)
+      putchar(c);
+    transmit();
+#else
+    consume();
+#endif
+  }
+
+protected:
+  virtual void command_completed(uint16_t number, uint8_t result)
+  {
+    if (number != 722)
+      return;
+    completed++;
+    status = result;
+  }
+};
+
+/* Upload and run until completed or a minute passed */
+static uint8_t
+upload(GPS_NMEA_MT3339_Emulator& emulator, Receiver& gps)
+{
+  Buffer source;
+  GPS_NMEA_MT3339::EPO epo(&source);
+  uint16_t completed = gps.completed;
+
+  for (size_t i = 0; i < EPO_SIZE; i++)
+    source.input += (char) (i * 7);
+  CHECK(gps.upload(&epo));
+  CHECK(!gps.upload(&epo));
+  for (uint16_t i = 0; i < 6000 && gps.completed == completed; i++)
+    {
+      host_advance(10);
+      gps.poll();
+      if (emulator.binary())
+        CHECK(epo.state() != GPS_NMEA_MT3339::EPO::IDLE);
+    }
+  CHECK_EQUAL(completed + 1, gps.completed);
+  CHECK_EQUAL(GPS_NMEA_MT3339::EPO::IDLE, epo.state());
+  CHECK_EQUAL(gps.status, epo.status());
+  CHECK(!emulator.binary());
+  return (epo.status());
+}
+
+/* Run for given time; number of fixes committed */
+static uint16_t
+run(Receiver& gps, uint32_t ms)
+{
+  uint16_t commits = gps.commits();
+
+  for (uint32_t t = 0; t < ms; t += 10)
+    {
+      host_advance(10);
+      gps.poll();
+    }
+  return (gps.commits() - commits);
+}
+
+/* Binary EPO packet (722) with given sequence and a record of zeros */
+static std::string
+packet(uint16_t sequence)
+{
+  const uint8_t RECORD = GPS_NMEA_MT3339::EPO::DATA /
+    GPS_NMEA_MT3339::EPO::RECORDS;
+  std::string s("\x04\x24", 2);
+  uint8_t checksum = 0;
+
+  s += (char) (RECORD + 11);
+  s += (char) 0;
+  s += (char) (722 & 0xff);
+  s += (char) (722 >> 8);
+  s += (char) (sequence & 0xff);
+  s += (char) (sequence >> 8);
+  s.append(RECORD, (char) 0);
+  for (size_t i = 2; i < s.size(); i++)
+    checksum ^= s[i];
+  s += (char) checksum;
+  s += "\r\n";
+  return (s);
+}
+
+/* Write to emulator */
+static void
+send(GPS_NMEA_MT3339_Emulator& emulator, const std::string& s)
+{
+  for (size_t i = 0; i < s.size(); i++)
+    emulator.putchar(s[i]);
+}
+
+int
+main()
+{
+  GPS_NMEA_MT3339_Emulator emulator;
+  GPS_NMEA_MT3339_Emulator stray;
+  Receiver gps(&emulator);
+  uint16_t packets;
+
+  CHECK(gps.begin());
+  CHECK(run(gps, 3000) > 0);
+
+  /* Full upload; data packets and the final one */
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, upload(emulator, gps));
+  CHECK_EQUAL(11, emulator.epo_packets());
+  CHECK(run(gps, 3000) > 0);
+
+  /* Failed packets are retried */
+  packets = emulator.epo_packets();
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_EPO_NACK, 64);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, upload(emulator, gps));
+  CHECK(emulator.epo_packets() - packets > 11);
+  printf("epo: %u packets sent for 11 with 25%% failed\n",
+         (unsigned) (emulator.epo_packets() - packets));
+
+  /* Failed after retries; receiver is switched back to NMEA */
+  packets = emulator.epo_packets();
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_EPO_NACK, 255);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_FAILED, upload(emulator, gps));
+  CHECK_EQUAL(1 + GPS_NMEA_MT3339_RETRIES, emulator.epo_packets() - packets);
+
+  /* Not acknowledged */
+  packets = emulator.epo_packets();
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_DROP_ACK, 255);
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_TIMEOUT, upload(emulator, gps));
+  CHECK_EQUAL(1 + GPS_NMEA_MT3339_RETRIES, emulator.epo_packets() - packets);
+
+  /* Fixes again */
+  emulator.faults(0, 0);
+  CHECK(run(gps, 3000) > 0);
+
+  /* Packets after a stray 0x04 are received */
+  send(stray, "$PMTK253,1,0*37\r\n");
+  CHECK(stray.binary());
+  send(stray, packet(0));
+  CHECK_EQUAL(1, stray.epo_packets());
+  send(stray, "\x04" + packet(1));
+  CHECK_EQUAL(2, stray.epo_packets());
+  send(stray, "\x04\x04" + packet(2));
+  CHECK_EQUAL(3, stray.epo_packets());
+
+  return (test_report("epo"));
+}
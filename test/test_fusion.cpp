@@ -0,0 +1,211 @@
+/**
+ * @file test_fusion.cpp
+ *
+ * GPS_Fusion of three receivers: epochs aligned by time, position
+ * weighted by satellites and hdop, failover to the others as soon as a
+ * receiver has stalled, without waiting for the next epoch, rejoin, and
+ * positions on both sides of the antimeridian.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_Fusion.hh"
+
+TEST_DEFINE;
+
+/* Receiver committing given fixes */
+class Source : public GPS {
+public:
+  void commit(const GPS::fix_t& fix)
+  {
+    m_date = fix.date;
+    m_time = fix.time;
+#ifndef GPS_TIME_ONLY
+    m_latitude = fix.latitude;
+    m_longitude = fix.longitude;
+    m_altitude = fix.altitude;
+    m_course = fix.course;
+    m_speed = fix.speed;
+    m_satellites = fix.satellites;
+    m_hdop = fix.hdop;
+#endif
+    m_last_update = RTT::millis();
+    notify();
+    host_dispatch();
+  }
+};
+
+/* Collects fused fixes and the receivers used */
+class Fused : public GPS::Listener {
+public:
+  std::vector<GPS::fix_t> fix;
+  std::vector<uint8_t> used;
+  GPS_Fusion* fusion;
+
+  virtual void on_fix(GPS& gps)
+  {
+    GPS::fix_t f;
+
+    gps.get(f);
+    fix.push_back(f);
+    used.push_back(fusion->used());
+  }
+};
+
+/* Fix of given second after 08:00:00 */
+static GPS::fix_t
+epoch(uint16_t second, int32_t latitude = 59000000L,
+      int32_t longitude = 18000000L, uint8_t satellites = 8,
+      uint16_t hdop = 100)
+{
+  GPS::fix_t fix;
+
+  memset(&fix, 0, sizeof(fix));
+  fix.date = 111026;
+  fix.time = ((800UL + second / 60) * 100 + second % 60) * 1000;
+#ifndef GPS_TIME_ONLY
+  fix.latitude = latitude;
+  fix.longitude = longitude;
+  fix.altitude = 2800;
+  fix.course = satellites * 100;
+  fix.speed = hdop;
+  fix.satellites = satellites;
+  fix.hdop = hdop;
+#else
+  (void) latitude;
+  (void) longitude;
+  (void) satellites;
+  (void) hdop;
+#endif
+  return (fix);
+}
+
+int
+main()
+{
+  GPS_Fusion fusion(1500);
+  Source a, b, c;
+  Fused fused;
+  uint16_t second = 0;
+  size_t n;
+
+  fused.fusion = &fusion;
+  fusion.attach(&fused);
+  CHECK(fusion.add(&a));
+  CHECK(fusion.add(&b));
+  CHECK(fusion.add(&c));
+
+  /* First epoch fused with the first receiver; the others are then
+   * expected */
+  host_advance(1000);
+  a.commit(epoch(++second));
+  CHECK_EQUAL(1, fused.fix.size());
+  CHECK_EQUAL(1, fused.used.back());
+  b.commit(epoch(second));
+  c.commit(epoch(second));
+  CHECK_EQUAL(1, fused.fix.size());
+
+  /* Aligned; fused when all have reported */
+  host_advance(1000);
+  a.commit(epoch(++second));
+  b.commit(epoch(second));
+  CHECK_EQUAL(1, fused.fix.size());
+  c.commit(epoch(second));
+  CHECK_EQUAL(2, fused.fix.size());
+  CHECK_EQUAL(7, fused.used.back());
+  CHECK_EQUAL(epoch(second).time, fused.fix.back().time);
+  CHECK_EQUAL(0, fusion.failovers());
+
+  /* Weighted by satellites / hdop; best receiver for the rest */
+  host_advance(1000);
+  a.commit(epoch(++second, 59000000L, 18000000L, 10, 100));
+  b.commit(epoch(second, 59001250L, 18002500L, 5, 200));
+  c.commit(epoch(second, 58999200L, 17998400L, 8, 100));
+  CHECK_EQUAL(3, fused.fix.size());
+#ifndef GPS_TIME_ONLY
+  /* Weights 1000, 250 and 800 */
+  CHECK_EQUAL(59000000L + (250L * 1250 - 800L * 800) / 2050,
+              fused.fix.back().latitude);
+  CHECK_EQUAL(18000000L + (250L * 2500 - 800L * 1600) / 2050,
+              fused.fix.back().longitude);
+  CHECK_EQUAL(10, fused.fix.back().satellites);
+  CHECK_EQUAL(100, fused.fix.back().hdop);
+  CHECK_EQUAL(1000, fused.fix.back().course);
+#endif
+
+  /* B stops. Fused when the last of the others reports after B has
+   * stalled, not with the next epoch */
+  host_advance(1000);
+  a.commit(epoch(++second));
+  host_advance(600);
+  n = fused.fix.size();
+  c.commit(epoch(second));
+  CHECK_EQUAL(n + 1, fused.fix.size());
+  CHECK_EQUAL(5, fused.used.back());
+  CHECK_EQUAL(epoch(second).time, fused.fix.back().time);
+  CHECK_EQUAL(1, fusion.failovers());
+  host_advance(400);
+  a.commit(epoch(++second));
+  c.commit(epoch(second));
+  CHECK_EQUAL(n + 2, fused.fix.size());
+  CHECK_EQUAL(1, fusion.failovers());
+
+  /* C stops too; fused by service() once C has stalled */
+  host_advance(1000);
+  a.commit(epoch(++second));
+  CHECK_EQUAL(n + 2, fused.fix.size());
+  host_advance(400);
+  fusion.service();
+  CHECK_EQUAL(n + 2, fused.fix.size());
+  host_advance(200);
+  fusion.service();
+  host_dispatch();
+  CHECK_EQUAL(n + 3, fused.fix.size());
+  CHECK_EQUAL(1, fused.used.back());
+  CHECK_EQUAL(epoch(second).time, fused.fix.back().time);
+  CHECK_EQUAL(2, fusion.failovers());
+
+  /* Missing without stalling; fused when the next epoch arrives */
+  host_advance(400);
+  a.commit(epoch(++second));
+  CHECK_EQUAL(n + 4, fused.fix.size());
+
+  /* B and C rejoin; fused late the first epoch, expected next */
+  host_advance(1000);
+  a.commit(epoch(++second));
+  b.commit(epoch(second));
+  c.commit(epoch(second));
+  CHECK_EQUAL(n + 5, fused.fix.size());
+  CHECK_EQUAL(1, fused.used.back());
+  host_advance(1000);
+  a.commit(epoch(++second));
+  b.commit(epoch(second));
+  CHECK_EQUAL(n + 5, fused.fix.size());
+  c.commit(epoch(second));
+  CHECK_EQUAL(n + 6, fused.fix.size());
+  CHECK_EQUAL(7, fused.used.back());
+  CHECK_EQUAL(2, fusion.failovers());
+
+#ifndef GPS_TIME_ONLY
+  /* Across the antimeridian; 4.4 m apart, the middle is on the west
+   * side */
+  CHECK(fusion.remove(&c));
+  host_advance(1000);
+  a.commit(epoch(++second, 10000000L, 179999990L));
+  b.commit(epoch(second, 10000000L, -179999970L));
+  CHECK_EQUAL(n + 7, fused.fix.size());
+  CHECK_EQUAL(3, fused.used.back());
+  CHECK_EQUAL(-179999990L, fused.fix.back().longitude);
+  host_advance(1000);
+  a.commit(epoch(++second, 10000000L, 179999990L));
+  b.commit(epoch(second, 10000000L, -179999990L));
+  CHECK_EQUAL(180000000L, fused.fix.back().longitude);
+  host_advance(1000);
+  a.commit(epoch(++second, 10000000L, 179999970L));
+  b.commit(epoch(second, 10000000L, -179999990L));
+  CHECK_EQUAL(179999990L, fused.fix.back().longitude);
+#endif
+
+  return (test_report("fusion"));
+}
@@ -0,0 +1,100 @@
+/**
+ * @file test_gate.cpp
+ *
+ * GPS_NMEA commit gate on implied speed: a step across the antimeridian
+ * is short, a jump is rejected, and a run of rejected fixes that agree
+ * with each other replaces a bad reference.
+ */
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+
+TEST_DEFINE;
+
+/* Parser fed as the serial driver would */
+class Receiver : public GPS_NMEA {
+public:
+  void feed(const std::string& s)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      putchar(s[i]);
+#else
+    GPS_NMEA::feed(s.data(), s.size());
+#endif
+  }
+};
+
+/* One second later, fix at given NMEA latitude and longitude */
+static void
+epoch(Receiver& gps, const char* latitude, const char* longitude)
+{
+  static uint32_t second = 0;
+  char time[16];
+  char buf[128];
+
+  host_advance(1000);
+  second++;
+  snprintf(time, sizeof(time), "08%02lu%02lu.000",
+           (unsigned long) (second / 60 % 60), (unsigned long) (second % 60));
+  snprintf(buf, sizeof(buf),
+           "GPRMC,%s,A,%s,%s,0.00,0.00,111026,,,A",
+           time, latitude, longitude);
+  gps.feed(nmea(buf));
+  snprintf(buf, sizeof(buf),
+           "GPGGA,%s,%s,%s,1,09,0.9,28.0,M,0.0,M,,",
+           time, latitude, longitude);
+  gps.feed(nmea(buf));
+}
+
+int
+main()
+{
+  Receiver gps;
+  GPS::fix_t fix;
+  uint16_t commits;
+  uint16_t rejects;
+
+  gps.begin();
+  gps.gate(2000, 0);
+
+  /* Across the antimeridian, 3.7m */
+  epoch(gps, "1000.0000,N", "17959.9990,E");
+  epoch(gps, "1000.0000,N", "17959.9990,W");
+  CHECK_EQUAL(2, gps.commits());
+  CHECK_EQUAL(0, gps.rejects());
+  gps.get(fix);
+  CHECK_EQUAL(-179999983L, fix.longitude);
+  epoch(gps, "1000.0000,N", "17959.9980,W");
+  CHECK_EQUAL(3, gps.commits());
+
+  /* Jump of 20km rejected; back on track committed */
+  epoch(gps, "1010.0000,N", "17959.9980,W");
+  CHECK_EQUAL(3, gps.commits());
+  CHECK_EQUAL(1, gps.rejects());
+  CHECK_EQUAL(GPS_NMEA::REJECT_SPEED, gps.rejected(fix));
+  epoch(gps, "1000.0000,N", "17959.9970,W");
+  CHECK_EQUAL(4, gps.commits());
+
+  /* Rejected fixes far from each other keep the reference */
+  commits = gps.commits();
+  rejects = gps.rejects();
+  epoch(gps, "1010.0000,N", "17959.9970,W");
+  epoch(gps, "1020.0000,N", "17959.9970,W");
+  epoch(gps, "1030.0000,N", "17959.9970,W");
+  CHECK_EQUAL(commits, gps.commits());
+  CHECK_EQUAL(rejects + 3, gps.rejects());
+
+  /* Rejected fixes that agree replace the reference */
+  epoch(gps, "1100.0000,N", "17959.9970,W");
+  epoch(gps, "1100.0010,N", "17959.9970,W");
+  CHECK_EQUAL(commits, gps.commits());
+  epoch(gps, "1100.0020,N", "17959.9970,W");
+  CHECK_EQUAL(commits + 1, gps.commits());
+  gps.get(fix);
+  CHECK_EQUAL(11000033L, fix.latitude);
+  epoch(gps, "1100.0030,N", "17959.9970,W");
+  CHECK_EQUAL(commits + 2, gps.commits());
+
+  return (test_report("gate"));
+}
@@ -0,0 +1,63 @@
+/**
+ * @file test_generator.cpp
+ *
+ * GPS_NMEA_Generator trajectory over long gaps between epochs and the
+ * receivers() estimate for long measurements.
+ */
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_NMEA_Generator.hh"
+
+TEST_DEFINE;
+
+/* Position reported by the generator's current epoch */
+static GPS::fix_t
+parse(GPS_NMEA_Generator& generator)
+{
+  Buffer device;
+  GPS_NMEA gps(&device);
+  GPS::fix_t fix;
+
+  while (generator.sentence(&device))
+    ;
+  device.input = device.take();
+  gps.begin();
+  gps.consume();
+  gps.get(fix);
+  return (fix);
+}
+
+int
+main()
+{
+  Buffer device;
+  GPS_NMEA gps(&device);
+  GPS_NMEA_Generator generator;
+  GPS_NMEA_Generator reference;
+  GPS::fix_t fix;
+  GPS::fix_t expected;
+
+  /* Ten hours north-east at 10 knots in one epoch; moves as many 1 Hz
+   * epochs do, over 100 km */
+  generator.position(10000000, 20000000, 0);
+  generator.motion(1000, 4500);
+  generator.epoch(0);
+  generator.epoch(36000000UL);
+  fix = parse(generator);
+  reference.position(10000000, 20000000, 0);
+  reference.motion(1000, 4500);
+  for (uint16_t i = 0; i <= 36000; i++)
+    reference.epoch();
+  expected = parse(reference);
+  CHECK_EQUAL(expected.latitude, fix.latitude);
+  CHECK_EQUAL(expected.longitude, fix.longitude);
+  CHECK(fix.latitude - 10000000 > 1000000);
+  CHECK(fix.longitude - 20000000 > 1000000);
+
+  /* Long measurement */
+  generator.rate(10000);
+  CHECK(generator.receivers(gps, 1000) > 0);
+
+  return (test_report("generator"));
+}
@@ -0,0 +1,237 @@
+/**
+ * @file test_geofence.cpp
+ *
+ * GPS_Geofence enter/exit events for circle and polygon fences, moves
+ * across grid cells and out of the grid, and a circle near the pole.
+ * The grid is checked against testing every fence, and evaluate() is
+ * timed with 10 to 10,000 fences.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_Geofence.hh"
+
+TEST_DEFINE;
+
+/* Records events as fence numbers, negative on exit */
+template<uint16_t FENCES, uint16_t VERTICES, uint16_t ENTRIES>
+class Fences : public GPS_Geofences<FENCES, VERTICES, 64, 64, ENTRIES> {
+public:
+  std::vector<int32_t> event;
+
+  /* Cell of last evaluated position */
+  uint16_t current()
+  {
+    return (this->m_cell);
+  }
+
+  /* Is position inside given fence, without the grid */
+  bool within(uint16_t fence, int32_t latitude, int32_t longitude)
+  {
+    return (this->contains(&this->m_fence[fence], latitude, longitude));
+  }
+
+protected:
+  virtual void on_enter(uint16_t fence)
+  {
+    event.push_back(fence);
+  }
+
+  virtual void on_exit(uint16_t fence)
+  {
+    event.push_back(-1 - (int32_t) fence);
+  }
+};
+
+/* Evaluate position; events raised */
+template<typename T>
+static std::vector<int32_t>
+move(T& fences, int32_t latitude, int32_t longitude)
+{
+  fences.event.clear();
+  fences.evaluate(latitude, longitude);
+  return (fences.event);
+}
+
+/* The only event, or NONE */
+static int32_t
+one(const std::vector<int32_t>& e)
+{
+  if (!CHECK_EQUAL(1, e.size()))
+    return (GPS_Geofence::NONE);
+  return (e[0]);
+}
+
+static uint32_t random_state = 0x2545f491;
+
+static uint32_t
+random(uint32_t n)
+{
+  random_state ^= random_state << 13;
+  random_state ^= random_state >> 17;
+  random_state ^= random_state << 5;
+  return (random_state % n);
+}
+
+/* Fences spread over half a degree square, every fourth a square
+ * polygon, others circles of 50..300m; a random walk is evaluated
+ * with the grid and checked against all fences. */
+template<uint16_t N>
+static void
+bench()
+{
+  static Fences<N, N, 65535> fences;
+  static const uint16_t FIXES = 10000;
+  static int32_t latitude[FIXES];
+  static int32_t longitude[FIXES];
+  int32_t lat = 59250000;
+  int32_t lon = 18000000;
+  uint32_t tested = 0;
+  uint32_t start;
+  bool same = true;
+
+  for (uint16_t f = 0; f < N; f++)
+    {
+      int32_t y = 59000000 + random(500000);
+      int32_t x = 17750000 + random(500000);
+
+      if (f % 4 == 3)
+        {
+          int32_t side = 500 + random(4000);
+          int32_t ys[] = { y, y, y + side, y + side };
+          int32_t xs[] = { x, x + side, x + side, x };
+
+          CHECK_EQUAL(f, fences.add_polygon(ys, xs, 4));
+        }
+      else
+        CHECK_EQUAL(f, fences.add_circle(y, x, 50 + random(250)));
+    }
+  CHECK(fences.index());
+
+  /* Steps of up to about 100m */
+  for (uint16_t i = 0; i < FIXES; i++)
+    {
+      lat += (int32_t) random(1801) - 900;
+      lon += (int32_t) random(3601) - 1800;
+      latitude[i] = lat;
+      longitude[i] = lon;
+    }
+
+  start = RTT::micros();
+  for (uint16_t i = 0; i < FIXES; i++)
+    {
+      fences.evaluate(latitude[i], longitude[i]);
+      tested += fences.tested();
+    }
+  start = RTT::micros() - start;
+  printf("geofence: %5u fences, %5.1f tested/fix, %.0f ns/fix\n",
+         N, (double) tested / FIXES, start * 1000.0 / FIXES);
+
+  for (uint16_t f = 0; f < N; f++)
+    if (fences.inside(f) != fences.within(f, lat, lon))
+      same = false;
+  CHECK(same);
+  if (N >= 1000)
+    CHECK(tested / FIXES < N / 10);
+}
+
+int
+main()
+{
+  static Fences<8, 16, 4096> fences;
+  std::vector<int32_t> e;
+  uint16_t circle, polygon, large, polar;
+  uint16_t cell;
+
+  /* Circle of 500m; L-shaped polygon of 1km with the north-east
+   * quarter cut out; polygon of about 10km x 5km across many cells */
+  int32_t lys[] = { 59400000, 59400000, 59404500, 59404500,
+                    59409000, 59409000 };
+  int32_t lxs[] = { 18100000, 18117600, 18117600, 18108800,
+                    18108800, 18100000 };
+  int32_t bys[] = { 59300000, 59300000, 59390000, 59390000 };
+  int32_t bxs[] = { 18200000, 18290000, 18290000, 18200000 };
+
+  circle = fences.add_circle(59329300, 18068600, 500);
+  polygon = fences.add_polygon(lys, lxs, 6);
+  large = fences.add_polygon(bys, bxs, 4);
+  CHECK_EQUAL(0, circle);
+  CHECK_EQUAL(1, polygon);
+  CHECK_EQUAL(2, large);
+  CHECK(fences.index());
+
+  /* Circle; 4.5 millionths of a degree latitude is 0.5m */
+  CHECK_EQUAL(0, move(fences, 59320000, 18068600).size());
+  e = move(fences, 59325000, 18068600);
+  CHECK_EQUAL(circle, one(e));
+  CHECK(fences.inside(circle));
+  CHECK_EQUAL(0, move(fences, 59329300, 18068600).size());
+  e = move(fences, 59333800, 18068600);
+  CHECK_EQUAL(0, e.size());
+  e = move(fences, 59334000, 18068600);
+  CHECK_EQUAL(-1 - circle, one(e));
+  CHECK(!fences.inside(circle));
+
+  /* East-west; 500m is 8800 millionths of a degree of longitude */
+  CHECK_EQUAL(1, move(fences, 59329300, 18077200).size());
+  CHECK_EQUAL(1, move(fences, 59329300, 18077800).size());
+
+  /* Polygon; the cut out quarter is outside */
+  e = move(fences, 59402000, 18102000);
+  CHECK_EQUAL(polygon, one(e));
+  CHECK_EQUAL(0, move(fences, 59407000, 18102000).size());
+  e = move(fences, 59407000, 18112000);
+  CHECK_EQUAL(-1 - polygon, one(e));
+  CHECK_EQUAL(1, move(fences, 59402000, 18112000).size());
+  CHECK(fences.inside(polygon));
+
+  /* Across cells inside the large polygon; one enter, one exit */
+  e = move(fences, 59345000, 18190000);
+  CHECK_EQUAL(-1 - polygon, one(e));
+  cell = fences.current();
+  for (int32_t x = 18190500; x <= 18300000; x += 1000)
+    {
+      e = move(fences, 59345000, x);
+      if (x == 18200500)
+        {
+          CHECK_EQUAL(1, e.size());
+          CHECK(fences.inside(large));
+        }
+      else if (x == 18290500)
+        {
+          CHECK_EQUAL(1, e.size());
+          CHECK(!fences.inside(large));
+        }
+      else
+        CHECK_EQUAL(0, e.size());
+    }
+  CHECK(fences.current() != cell);
+
+  /* Out of the grid from inside; exit is raised */
+  CHECK_EQUAL(1, move(fences, 59345000, 18250000).size());
+  e = move(fences, 50000000, 10000000);
+  CHECK_EQUAL(-1 - large, one(e));
+  CHECK_EQUAL(GPS_Geofence::NONE, fences.current());
+
+  /* Circle of 1km at 89.9N; 3 degrees of longitude is 580m, 6 degrees
+   * is 1160m */
+  fences.clear();
+  polar = fences.add_circle(89900000, 0, 1000);
+  CHECK(fences.index());
+  CHECK_EQUAL(1, move(fences, 89900000, 3000000).size());
+  CHECK(fences.inside(polar));
+  CHECK_EQUAL(0, move(fences, 89905000, 0).size());
+  CHECK_EQUAL(0, move(fences, 89900000, -3000000).size());
+  CHECK_EQUAL(1, move(fences, 89900000, -6000000).size());
+  CHECK(!fences.inside(polar));
+  CHECK_EQUAL(1, move(fences, 89908000, 0).size());
+  CHECK_EQUAL(1, move(fences, 89910000, 0).size());
+
+  bench<10>();
+  bench<100>();
+  bench<1000>();
+  bench<10000>();
+
+  return (test_report("geofence"));
+}
@@ -0,0 +1,130 @@
+/**
+ * @file test_health.cpp
+ *
+ * GPS_NMEA_MT3339 health monitor against the emulator: with garbled
+ * output (as at a wrong baudrate) each unhealthy window escalates one
+ * recovery step up to a factory reset, and clean output again is
+ * counted as a recovery. With GPS_INTERRUPT_IMPL characters received
+ * in the interrupt handler never take a step; only transmit() does.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA_MT3339.hh"
+#include "GPS_NMEA_MT3339_Emulator.hh"
+
+TEST_DEFINE;
+
+/* Receiver fed as the serial driver would */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  Receiver(IOStream::Device* device) : GPS_NMEA_MT3339(device) {}
+
+  /* Read what the emulator has */
+  void receive()
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    int c;
+
+    while ((c = m_device->getchar()) != IOStream::EOF)
+      putchar(c);
+#else
+    consume();
+#endif
+  }
+
+  /* Read, then transmit as the application would */
+  void poll()
+  {
+    receive();
+#ifdef GPS_INTERRUPT_IMPL
+    transmit();
+#endif
+  }
+};
+
+/* Run for given time; health steps taken, in order */
+static std::vector<uint8_t>
+run(Receiver& gps, uint32_t ms)
+{
+  std::vector<uint8_t> steps;
+  uint8_t health = gps.health();
+
+  for (uint32_t t = 0; t < ms; t += 10)
+    {
+      host_advance(10);
+      gps.poll();
+      if (gps.health() != health)
+        {
+          health = gps.health();
+          steps.push_back(health);
+        }
+    }
+  return (steps);
+}
+
+int
+main()
+{
+  GPS_NMEA_MT3339_Emulator emulator;
+  Receiver gps(&emulator);
+  std::vector<uint8_t> steps;
+  uint16_t restarts;
+
+  CHECK(gps.begin());
+  steps = run(gps, 12000);
+  CHECK_EQUAL(0, steps.size());
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_OK, gps.health());
+  CHECK(gps.sentence_gap() <= 1000);
+  CHECK_EQUAL(100, gps.commit_ratio());
+  CHECK_EQUAL(0, gps.error_ratio());
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* Received in the interrupt handler; no step without transmit() */
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_BAUDRATE);
+  for (uint16_t t = 0; t < 12000; t += 10)
+    {
+      host_advance(10);
+      gps.receive();
+    }
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_OK, gps.health());
+  gps.transmit();
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_RESYNC, gps.health());
+  emulator.faults(0, 0);
+  steps = run(gps, 12000);
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_OK, gps.health());
+  CHECK_EQUAL(1, gps.recoveries());
+#endif
+
+  /* Garbled output; a step per window up to a factory reset, which is
+   * the last */
+  restarts = emulator.restarts();
+  emulator.faults(GPS_NMEA_MT3339_Emulator::FAULT_BAUDRATE);
+  steps = run(gps, 6 * GPS_NMEA_MT3339_HEALTH_WINDOW);
+  CHECK_EQUAL(4, steps.size());
+  if (steps.size() == 4)
+    {
+      CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_RESYNC, steps[0]);
+      CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_SELECT, steps[1]);
+      CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_WAKE, steps[2]);
+      CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_FACTORY_RESET, steps[3]);
+    }
+  CHECK(gps.sentence_gap() > GPS_NMEA_MT3339_HEALTH_GAP);
+  CHECK_EQUAL(0, gps.commit_ratio());
+
+  /* Clean again; recovered by the factory reset */
+  emulator.faults(0, 0);
+  steps = run(gps, 3 * GPS_NMEA_MT3339_HEALTH_WINDOW);
+  CHECK_EQUAL(1, steps.size());
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_OK, gps.health());
+  CHECK_EQUAL(GPS_NMEA_MT3339::HEALTH_FACTORY_RESET, gps.recovered_by());
+  CHECK(gps.recovery_time() >= 4 * GPS_NMEA_MT3339_HEALTH_WINDOW);
+
+  /* The emulator ignores input while garbled; the reset was not seen */
+  CHECK_EQUAL(restarts, emulator.restarts());
+  printf("health: recovered in %lu ms\n",
+         (unsigned long) gps.recovery_time());
+
+  return (test_report("health"));
+}
@@ -0,0 +1,100 @@
+/**
+ * @file test_kalman.cpp
+ *
+ * GPS_Kalman on constant velocity tracks with position noise: the
+ * smoothed position is closer to the track than the fixes, and speed
+ * and course converge to those of the track, also above 55 knots.
+ */
+
+#include <math.h>
+
+#include "test.hh"
+#include "GPS_Kalman.hh"
+#include "GPS_Track.hh"
+
+TEST_DEFINE;
+
+/* Seconds of track; error is measured over the second half */
+static const uint16_t SECONDS = 120;
+
+/* Position noise in millionths of a degree of latitude, about 3m */
+static const int32_t NOISE = 30;
+
+static uint16_t random_state = 0xace1;
+
+/* Uniform noise in -NOISE..NOISE */
+static int32_t
+noise()
+{
+  random_state ^= random_state << 7;
+  random_state ^= random_state >> 9;
+  random_state ^= random_state << 8;
+  return ((int32_t) (random_state % (2 * NOISE + 1)) - NOISE);
+}
+
+/* Run track; RMS error of fixes and of smoothed positions in meters.
+ * The track follows the cosine approximations of the library, as the
+ * filter does, so that only the filter is measured. */
+static void
+track(GPS::speed_t speed, GPS::course_t course, const char* name)
+{
+  GPS_Kalman kalman;
+  GPS::fix_t fix;
+  GPS::fix_t smoothed;
+  double latitude = 48000000;
+  double longitude = 11000000;
+  double north = speed * 0.005144 / 0.1113 * GPS::cos_course(course) / 32768;
+  double east = speed * 0.005144 / 0.1113 *
+    GPS::cos_course(course - 9000) / 32768;
+  double scale;
+  double raw = 0;
+  double error = 0;
+  int32_t deviation;
+
+  memset(&fix, 0, sizeof(fix));
+  fix.date = 10115;
+  fix.speed = speed;
+  fix.course = course;
+  fix.satellites = 8;
+  fix.hdop = 100;
+  for (uint16_t t = 0; t < SECONDS; t++)
+    {
+      scale = GPS::cos_latitude(lround(latitude)) / 32768.0;
+      fix.time = GPS_Track::millis_to_time(43200000UL + t * 1000UL);
+      fix.latitude = lround(latitude) + noise();
+      fix.longitude = lround(longitude) + lround(noise() / scale);
+      fix.altitude = 10000 + noise();
+      kalman.update(fix);
+      CHECK(kalman.valid());
+      kalman.get(smoothed);
+      if (t >= SECONDS / 2)
+        {
+          raw += pow(fix.latitude - latitude, 2) +
+            pow((fix.longitude - longitude) * scale, 2);
+          error += pow(smoothed.latitude - latitude, 2) +
+            pow((smoothed.longitude - longitude) * scale, 2);
+        }
+      latitude += north;
+      longitude += east / scale;
+    }
+  raw = sqrt(raw / (SECONDS / 2)) * 0.1113;
+  error = sqrt(error / (SECONDS / 2)) * 0.1113;
+  printf("kalman: %s, %.2f m rms for fixes, %.2f m smoothed\n",
+         name, raw, error);
+
+  CHECK(error < raw);
+  deviation = (int32_t) smoothed.speed - (int32_t) speed;
+  CHECK(abs(deviation) <= (int32_t) speed / 50);
+  deviation = ((int32_t) smoothed.course - course + 54000) % 36000 - 18000;
+  CHECK(abs(deviation) <= 100);
+}
+
+int
+main()
+{
+  track(2000, 4500, "20 knots north-east");
+  track(800, 27000, "8 knots west");
+  track(30000, 13500, "300 knots south-east");
+
+  return (test_report("kalman"));
+}
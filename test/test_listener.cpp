@@ -0,0 +1,143 @@
+/**
+ * @file test_listener.cpp
+ *
+ * GPS::Listener delivery and early time. With GPS_INTERRUPT_IMPL the
+ * call is deferred and must see the fix as committed, and lost
+ * notifications must be counted.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+
+TEST_DEFINE;
+
+/* Collects committed fixes */
+class Fixes : public GPS::Listener {
+public:
+  std::vector<GPS::fix_t> fix;
+
+  virtual void on_fix(GPS& gps)
+  {
+    GPS::fix_t f;
+
+    gps.get(f);
+    fix.push_back(f);
+  }
+};
+
+/* Parser fed as the serial driver would */
+class Receiver : public GPS_NMEA {
+public:
+  void feed(const std::string& s)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      putchar(s[i]);
+#else
+    GPS_NMEA::feed(s.data(), s.size());
+#endif
+  }
+};
+
+static void
+feed(Receiver& gps, const std::string& s)
+{
+  gps.feed(s);
+}
+
+static void
+epoch(Receiver& gps, const char* time, const char* latitude)
+{
+  char buf[128];
+
+  snprintf(buf, sizeof(buf),
+           "GPRMC,%s,A,%s,N,01804.1168,E,0.00,0.00,111026,,,A",
+           time, latitude);
+  feed(gps, nmea(buf));
+  snprintf(buf, sizeof(buf),
+           "GPGGA,%s,%s,N,01804.1168,E,1,09,0.9,28.0,M,0.0,M,,",
+           time, latitude);
+  feed(gps, nmea(buf));
+}
+
+int
+main()
+{
+  Receiver gps;
+  Fixes fixes;
+
+  gps.attach(&fixes);
+  gps.begin();
+
+  /* Committed fix is delivered */
+  epoch(gps, "080000.000", "5919.7576");
+  host_dispatch();
+  CHECK_EQUAL(1, fixes.fix.size());
+  CHECK_EQUAL(80000000, fixes.fix[0].time);
+#ifndef GPS_TIME_ONLY
+  CHECK_EQUAL(59329293, fixes.fix[0].latitude);
+#endif
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* Deferred call sees the commit, not the sentences parsed after it */
+  fixes.fix.clear();
+  epoch(gps, "080001.000", "5919.7564");
+  epoch(gps, "080002.000", "5919.7552");
+  feed(gps, nmea("GPRMC,080003.000,A,5919.7540,N,01804.1168,E,"
+                 "0.00,0.00,111026,,,A"));
+  host_dispatch();
+  CHECK_EQUAL(1, fixes.fix.size());
+  CHECK_EQUAL(80002000, fixes.fix[0].time);
+  CHECK_EQUAL(59329253, fixes.fix[0].latitude);
+  CHECK_EQUAL(1, gps.dropped());
+
+  /* Full event queue */
+  Event::Handler other;
+  fixes.fix.clear();
+  for (uint8_t i = 0; i < Event::QUEUE_MAX; i++)
+    Event::push(Event::USER_TYPE, &other);
+  epoch(gps, "080004.000", "5919.7528");
+  host_dispatch();
+  CHECK_EQUAL(0, fixes.fix.size());
+  CHECK_EQUAL(2, gps.dropped());
+  epoch(gps, "080005.000", "5919.7516");
+  host_dispatch();
+  CHECK_EQUAL(1, fixes.fix.size());
+  CHECK_EQUAL(80005000, fixes.fix[0].time);
+#else
+  /* Called on each commit */
+  epoch(gps, "080001.000", "5919.7564");
+  epoch(gps, "080002.000", "5919.7552");
+  CHECK_EQUAL(3, fixes.fix.size());
+  CHECK_EQUAL(80002000, fixes.fix[2].time);
+#endif
+
+  /* Detached listener is not called */
+  CHECK(gps.detach(&fixes));
+  fixes.fix.clear();
+  epoch(gps, "080006.000", "5919.7504");
+  host_dispatch();
+  CHECK_EQUAL(0, fixes.fix.size());
+
+  /* Time ahead of the position; date() and time() stay with it */
+  host_advance(500);
+  feed(gps, nmea("GPRMC,080007.000,A,5919.7492,N,01804.1168,E,"
+                 "0.00,0.00,121026,,,A"));
+  CHECK_EQUAL(80007000, gps.early_time());
+  CHECK_EQUAL(121026, gps.early_date());
+  CHECK_EQUAL(host_millis, gps.last_time_update());
+#ifndef GPS_TIME_ONLY
+  CHECK_EQUAL(80006000, gps.time());
+  CHECK_EQUAL(111026, gps.date());
+  CHECK(gps.last_update() != gps.last_time_update());
+  feed(gps, nmea("GPGGA,080007.000,5919.7492,N,01804.1168,E,"
+                 "1,09,0.9,28.0,M,0.0,M,,"));
+#endif
+  CHECK_EQUAL(80007000, gps.time());
+  CHECK_EQUAL(121026, gps.date());
+  CHECK_EQUAL(gps.last_update(), gps.last_time_update());
+
+  return (test_report("listener"));
+}
@@ -0,0 +1,164 @@
+/**
+ * @file test_locus.cpp
+ *
+ * GPS_NMEA_MT3339 LOCUS dump (PMTK622) decoded from data/locus.nmea:
+ * the sector header is skipped, records are passed in flash order and
+ * erased records are ignored; a corrupted line is counted. Data lines
+ * are not failed sentences to the NMEA parser. With
+ * GPS_INTERRUPT_IMPL records are passed from the event handler. The
+ * dump is synthesized to the MT3339 flash layout with basic record
+ * content (a sector header, 18 records at 15 s along a track and
+ * erased flash), not read from a receiver.
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA_MT3339.hh"
+
+TEST_DEFINE;
+
+/* Receiver fed as the serial driver would; records completions */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  std::vector<uint16_t> command;
+  std::vector<uint8_t> status;
+  uint16_t failed;
+
+  Receiver(IOStream::Device* device) : GPS_NMEA_MT3339(device), failed(0) {}
+
+  /* With GPS_INTERRUPT_IMPL events are dispatched after each line, as
+   * the application loop would, unless held */
+  void feed(const std::string& s, bool held = false)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      {
+        putchar(s[i]);
+        if (s[i] == '\n' && !held)
+          host_dispatch();
+      }
+#else
+    UNUSED(held);
+    GPS_NMEA_MT3339::feed(s.data(), s.size());
+#endif
+    transmit();
+  }
+
+protected:
+  virtual void command_completed(uint16_t number, uint8_t result)
+  {
+    command.push_back(number);
+    status.push_back(result);
+  }
+
+  virtual void sentence(bool valid)
+  {
+    if (!valid)
+      failed++;
+    GPS_NMEA_MT3339::sentence(valid);
+  }
+};
+
+/* Collects records */
+class Dump : public GPS_NMEA_MT3339::Locus {
+public:
+  std::vector<record_t> record;
+
+  virtual void on_record(const record_t& r)
+  {
+    record.push_back(r);
+  }
+};
+
+/* Dump data into locus; status of the PMTK622 completion */
+static uint8_t
+dump(Receiver& gps, Dump& locus, const std::string& data)
+{
+  gps.command.clear();
+  gps.status.clear();
+  CHECK(gps.dump(&locus));
+  CHECK(!gps.dump(&locus));
+  gps.transmit();
+  gps.feed(data);
+  if (!CHECK_EQUAL(1, gps.command.size()))
+    return (0);
+  CHECK_EQUAL(622, gps.command[0]);
+  return (gps.status[0]);
+}
+
+int
+main()
+{
+  std::string data = load("data/locus.nmea");
+  Buffer device;
+  Receiver gps(&device);
+  Dump locus;
+  Dump corrupted;
+  size_t line;
+
+  gps.begin();
+  gps.feed(nmea("PMTK001,314,3"));
+  CHECK(data.size() > 0);
+
+  /* Header line, then records in flash order */
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, dump(gps, locus, data));
+  CHECK_EQUAL(4, locus.total());
+  CHECK_EQUAL(4, locus.lines());
+  CHECK_EQUAL(0, locus.errors());
+  CHECK_EQUAL(18, locus.records());
+  CHECK_EQUAL(18, locus.record.size());
+  CHECK_EQUAL(0, gps.failed);
+  if (locus.record.size() == 18)
+    {
+      /* 2026-10-11 08:00:00 UTC */
+      CHECK_EQUAL(1791705600UL, locus.record[0].clock);
+      CHECK_EQUAL(2, locus.record[0].fix);
+      CHECK_EQUAL(59329292L, locus.record[0].latitude);
+      CHECK_EQUAL(18068613L, locus.record[0].longitude);
+      CHECK_EQUAL(28, locus.record[0].height);
+      CHECK_EQUAL(1791705600UL + 17 * 15, locus.record[17].clock);
+      CHECK_EQUAL(59336945L, locus.record[17].latitude);
+      CHECK_EQUAL(18073883L, locus.record[17].longitude);
+      CHECK_EQUAL(45, locus.record[17].height);
+      for (size_t i = 1; i < locus.record.size(); i++)
+        CHECK_EQUAL(15, locus.record[i].clock - locus.record[i - 1].clock);
+    }
+
+  /* Corrupted data line is dropped with its records */
+  line = data.find("$PMTKLOX,1,1,");
+  CHECK(line != std::string::npos);
+  data[line + 14] ^= 0x01;
+  CHECK_EQUAL(GPS_NMEA_MT3339::STATUS_SUCCESS, dump(gps, corrupted, data));
+  CHECK_EQUAL(3, corrupted.lines());
+  CHECK_EQUAL(1, corrupted.errors());
+  CHECK_EQUAL(12, corrupted.records());
+  CHECK_EQUAL(0, gps.failed);
+
+#ifdef GPS_INTERRUPT_IMPL
+  /* Records are passed from the event handler, not in the interrupt;
+   * of the three valid lines of the corrupted data, the two received
+   * while the first is held are dropped */
+  Dump held;
+  gps.command.clear();
+  CHECK(gps.dump(&held));
+  gps.transmit();
+  gps.feed(data, true);
+  CHECK_EQUAL(0, held.records());
+  CHECK_EQUAL(0, held.record.size());
+  host_dispatch();
+  CHECK_EQUAL(3, held.lines());
+  CHECK_EQUAL(3, held.errors());
+  CHECK_EQUAL(2, held.records());
+  CHECK_EQUAL(2, held.record.size());
+#endif
+
+  /* Fixes are parsed after the dump */
+  gps.feed(nmea("GPRMC,080000.000,A,5919.7576,N,01804.1168,E,"
+                "0.00,0.00,111026,,,A"));
+  gps.feed(nmea("GPGGA,080000.000,5919.7576,N,01804.1168,E,"
+                "1,09,0.9,28.0,M,0.0,M,,"));
+  CHECK_EQUAL(1, gps.commits());
+
+  return (test_report("locus"));
+}
@@ -0,0 +1,163 @@
+/**
+ * @file test_publisher.cpp
+ *
+ * GPS_Fix_Publisher region read by GPS_Fix_Publisher::Reader: latest
+ * fix and history(age) over the ring, no snapshot while a fix is being
+ * written, and consistent snapshots read from another process through
+ * GPS_Fix_Region_POSIX while fixes are published.
+ */
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "test.hh"
+#include "GPS_Fix_Publisher.hh"
+
+TEST_DEFINE;
+
+/* Fixes published by the writer process */
+static const uint32_t FIXES = 2000000UL;
+
+/* Fix number n; the fields are derived from n so that a mix of two
+ * fixes is seen */
+static GPS::fix_t
+numbered(uint32_t n)
+{
+  GPS::fix_t fix;
+
+  memset(&fix, 0, sizeof(fix));
+  fix.date = n;
+  fix.time = ~n;
+#ifndef GPS_TIME_ONLY
+  fix.latitude = -(int32_t) n;
+  fix.longitude = n * 3;
+  fix.altitude = n * 5;
+  fix.speed = n * 7;
+#endif
+  return (fix);
+}
+
+static bool
+consistent(const GPS::fix_t& fix)
+{
+  GPS::fix_t expected = numbered(fix.date);
+
+  return (fix.time == expected.time
+#ifndef GPS_TIME_ONLY
+          && fix.latitude == expected.latitude
+          && fix.longitude == expected.longitude
+          && fix.altitude == expected.altitude
+          && fix.speed == expected.speed
+#endif
+          );
+}
+
+int
+main()
+{
+  GPS_Fix_Publishers<4> publisher;
+  GPS_Fix_Publisher::Reader reader(publisher.region());
+  GPS_Fix_Publisher::header_t* header;
+  GPS::fix_t fix;
+  char name[32];
+  uint32_t snapshots = 0;
+  uint32_t retried = 0;
+  uint32_t torn = 0;
+  uint32_t previous = 0;
+  pid_t writer;
+  int status;
+
+  /* Empty region */
+  CHECK(reader.valid());
+  CHECK_EQUAL(0, reader.count());
+  CHECK(!reader.latest(fix));
+
+  /* Fewer fixes than entries */
+  publisher.publish(numbered(1));
+  publisher.publish(numbered(2));
+  CHECK_EQUAL(2, reader.count());
+  CHECK(reader.latest(fix));
+  CHECK_EQUAL(2, fix.date);
+  CHECK(reader.history(1, fix));
+  CHECK_EQUAL(1, fix.date);
+  CHECK(!reader.history(2, fix));
+
+  /* Ring wrapped; the last four are kept */
+  for (uint32_t n = 3; n <= 10; n++)
+    publisher.publish(numbered(n));
+  CHECK_EQUAL(10, reader.count());
+  for (uint8_t age = 0; age < 4; age++)
+    {
+      CHECK(reader.history(age, fix));
+      CHECK_EQUAL(10 - age, fix.date);
+      CHECK(consistent(fix));
+    }
+  CHECK(!reader.history(4, fix));
+
+  /* No snapshot while a fix is being written */
+  header = (GPS_Fix_Publisher::header_t*) publisher.region();
+  header->sequence++;
+  CHECK(!reader.latest(fix));
+  header->sequence++;
+  CHECK(reader.latest(fix));
+
+  /* Layout checked */
+  header->fix_size++;
+  CHECK(!reader.valid());
+  CHECK(!reader.latest(fix));
+  header->fix_size--;
+
+  /* Shared memory; another process publishes as fast as it can, this
+   * one takes snapshots */
+  snprintf(name, sizeof(name), "/test_publisher.%d", (int) getpid());
+  GPS_Fix_Region_POSIX region;
+  GPS_Fix_Region_POSIX mapped;
+  void* shared = region.create(name, 8);
+  if (!CHECK(shared != NULL))
+    return (test_report("publisher"));
+  GPS_Fix_Publisher shm(shared, 8);
+  CHECK(mapped.open(name) != NULL);
+  GPS_Fix_Publisher::Reader remote(mapped.region());
+  CHECK(remote.valid());
+
+  writer = fork();
+  if (writer == 0)
+    {
+      for (uint32_t n = 1; n <= FIXES; n++)
+        shm.publish(numbered(n));
+      _exit(0);
+    }
+  while (waitpid(writer, &status, WNOHANG) == 0)
+    {
+      if (!remote.history(snapshots & 7, fix))
+        {
+          retried++;
+          continue;
+        }
+      snapshots++;
+      if (!consistent(fix))
+        torn++;
+      if ((snapshots & 7) == 0)
+        {
+          if (fix.date < previous)
+            torn++;
+          previous = fix.date;
+        }
+    }
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  CHECK_EQUAL(0, torn);
+  CHECK_EQUAL(FIXES, remote.count());
+  CHECK(remote.latest(fix));
+  CHECK_EQUAL(FIXES, fix.date);
+  CHECK(remote.history(7, fix));
+  CHECK_EQUAL(FIXES - 7, fix.date);
+  printf("publisher: %lu snapshots, %lu not taken\n",
+         (unsigned long) snapshots, (unsigned long) retried);
+
+  /* Removed name; mapping stays, new readers fail */
+  CHECK(GPS_Fix_Region_POSIX::unlink(name));
+  CHECK(mapped.open(name) == NULL);
+  CHECK(!GPS_Fix_Region_POSIX::unlink(name));
+
+  return (test_report("publisher"));
+}
@@ -0,0 +1,181 @@
+/**
+ * @file test_queue.cpp
+ *
+ * GPS_NMEA_Pool and GPS_Fix_Queue on generated streams: fixes from
+ * all receivers gathered in one queue keep their order per receiver,
+ * a bursting receiver gets the budget left over by quiet ones, busy
+ * receivers share evenly, and a full queue drops and counts. Reports
+ * service time per fix for 1 to GPS_NMEA_POOL_RECEIVERS receivers.
+ */
+
+#include "test.hh"
+#include "GPS_Fix_Queue.hh"
+#include "GPS_NMEA_Generator.hh"
+#include "GPS_NMEA_Pool.hh"
+
+TEST_DEFINE;
+
+static const uint8_t RECEIVERS = GPS_NMEA_POOL_RECEIVERS;
+
+/* Receiver with its generated input */
+struct Stream {
+  Buffer device;
+  GPS_NMEA gps;
+  GPS_NMEA_Generator generator;
+
+  Stream() : device(4096), gps(&device) {}
+
+  /* Queue given number of epochs of input */
+  void generate(uint16_t epochs)
+  {
+    Buffer out;
+
+    generator.generate(&out, epochs);
+    device.input.erase(0, device.offset);
+    device.offset = 0;
+    device.input += out.take();
+  }
+
+  /* Characters not yet parsed */
+  size_t backlog()
+  {
+    return (device.input.size() - device.offset);
+  }
+};
+
+/* Drain queue; false if a receiver's fixes are out of order */
+static bool
+drain(GPS_Fix_Queue& queue, Stream* stream, uint32_t* last,
+      uint16_t* count)
+{
+  GPS_Fix_Queue::entry_t entry;
+  bool ordered = true;
+
+  while (queue.get(entry))
+    {
+      uint8_t i = 0;
+
+      while (i < RECEIVERS && &stream[i].gps != entry.gps)
+        i++;
+      if (i == RECEIVERS)
+        return (false);
+      if (count[i] != 0 && entry.fix.time <= last[i])
+        ordered = false;
+      last[i] = entry.fix.time;
+      count[i]++;
+    }
+  return (ordered);
+}
+
+int
+main()
+{
+  static Stream stream[RECEIVERS];
+  GPS_Fix_Queues<64> queue;
+  GPS_Fix_Queue::Input* input[RECEIVERS];
+  GPS_NMEA_Pool pool;
+  uint32_t last[RECEIVERS];
+  uint16_t count[RECEIVERS];
+  size_t before[RECEIVERS];
+  bool ordered = true;
+  size_t spare;
+  uint32_t start;
+  uint32_t fixes;
+
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    {
+      stream[i].generator.position(59000000L + i * 100000L, 18000000L, 0);
+      stream[i].generator.motion(1000, 9000 * i);
+      stream[i].generator.sentences(GPS_NMEA_Generator::SENTENCE_RMC |
+                                    GPS_NMEA_Generator::SENTENCE_GGA);
+      stream[i].gps.begin();
+      input[i] = new GPS_Fix_Queue::Input(&queue);
+      stream[i].gps.attach(input[i]);
+      CHECK(pool.attach(&stream[i].gps));
+      count[i] = 0;
+    }
+  CHECK(!pool.attach(&stream[0].gps));
+
+  /* Receiver 0 bursting with 20 epochs, the others one each; all in
+   * one queue, in order per receiver */
+  stream[0].generate(20);
+  for (uint8_t i = 1; i < RECEIVERS; i++)
+    stream[i].generate(1);
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    before[i] = stream[i].backlog();
+  spare = 0;
+  for (uint8_t i = 1; i < RECEIVERS; i++)
+    spare += 256 - before[i];
+  CHECK(pool.service(256) > 0);
+  for (uint8_t i = 1; i < RECEIVERS; i++)
+    CHECK_EQUAL(0, stream[i].backlog());
+  CHECK_EQUAL(256 + spare, before[0] - stream[0].backlog());
+  while (pool.service(256) > 0)
+    ordered &= drain(queue, stream, last, count);
+  ordered &= drain(queue, stream, last, count);
+  CHECK(ordered);
+  CHECK_EQUAL(20, count[0]);
+  for (uint8_t i = 1; i < RECEIVERS; i++)
+    CHECK_EQUAL(1, count[i]);
+  CHECK_EQUAL(0, queue.dropped());
+
+  /* All bursting; the same share each, in turn */
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    {
+      stream[i].generate(10);
+      before[i] = stream[i].backlog();
+    }
+  CHECK_EQUAL(RECEIVERS * 256, pool.service(256));
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    CHECK_EQUAL(256, before[i] - stream[i].backlog());
+  for (uint8_t n = 0; n < 4; n++)
+    {
+      pool.service(64);
+      ordered &= drain(queue, stream, last, count);
+    }
+  while (pool.service(256) > 0)
+    ordered &= drain(queue, stream, last, count);
+  ordered &= drain(queue, stream, last, count);
+  CHECK(ordered);
+  CHECK_EQUAL(30, count[0]);
+  CHECK_EQUAL(11, count[RECEIVERS - 1]);
+
+  /* Full queue; fixes are dropped and counted, order is kept */
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    stream[i].generate(20);
+  while (pool.service(256) > 0)
+    ;
+  CHECK_EQUAL(63, queue.available());
+  CHECK_EQUAL(RECEIVERS * 20 - 63, queue.dropped());
+  CHECK(drain(queue, stream, last, count));
+  CHECK_EQUAL(0, queue.available());
+
+  /* Service time per fix, 1 to RECEIVERS receivers of 200 epochs */
+  for (uint8_t n = 1; n <= RECEIVERS; n++)
+    {
+      for (uint8_t i = 0; i < RECEIVERS; i++)
+        pool.detach(&stream[i].gps);
+      for (uint8_t i = 0; i < n; i++)
+        {
+          pool.attach(&stream[i].gps);
+          stream[i].generate(200);
+        }
+      fixes = 0;
+      start = RTT::micros();
+      while (pool.service() > 0)
+        {
+          fixes += queue.available();
+          ordered &= drain(queue, stream, last, count);
+        }
+      start = RTT::micros() - start;
+      CHECK_EQUAL(n * 200, fixes);
+      printf("queue: %u receivers, %.0f ns/fix\n",
+             n, start * 1000.0 / fixes);
+    }
+  CHECK(ordered);
+
+  for (uint8_t i = 0; i < RECEIVERS; i++)
+    delete input[i];
+
+  return (test_report("queue"));
+}
@@ -0,0 +1,61 @@
+/**
+ * @file test_satellites.cpp
+ *
+ * GPS_NMEA satellite table from $GPGSA and a $GPGSV sequence; the table
+ * is published when the sequence completes.
+ */
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+
+TEST_DEFINE;
+
+/* Parser fed as the serial driver would */
+class Receiver : public GPS_NMEA {
+public:
+  void feed(const std::string& s)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      putchar(s[i]);
+#else
+    GPS_NMEA::feed(s.data(), s.size());
+#endif
+  }
+};
+
+int
+main()
+{
+  Receiver gps;
+  GPS_NMEA::satellite_table_t table;
+
+  gps.begin();
+  gps.feed(nmea("GPGSA,A,3,05,12,,,,,,,,,,,2.1,1.2,1.7"));
+  gps.feed(nmea("GPGSV,2,1,05,05,40,083,46,12,20,230,42,"
+                "17,65,300,38,21,10,045,00"));
+  CHECK(!gps.visible(5));
+
+  gps.feed(nmea("GPGSV,2,2,05,30,05,120,"));
+  CHECK(gps.visible(5));
+  CHECK(gps.visible(30));
+  CHECK(!gps.visible(6));
+  CHECK(gps.used(5));
+  CHECK(gps.used(12));
+  CHECK(!gps.used(17));
+
+  gps.satellite_table(table);
+  CHECK_EQUAL(5, table.count);
+  CHECK_EQUAL(3, table.fix);
+  CHECK_EQUAL(120, table.hdop);
+  CHECK_EQUAL(46, table.satellite[0].snr);
+  CHECK_EQUAL(1, table.satellite[1].used);
+
+  /* Broken sequence keeps the published table */
+  gps.feed(nmea("GPGSV,2,1,01,07,40,083,46"));
+  gps.feed(nmea("GPGSV,3,3,01,08,40,083,46"));
+  CHECK(gps.visible(5));
+  CHECK(!gps.visible(7));
+
+  return (test_report("satellites"));
+}
@@ -0,0 +1,199 @@
+/**
+ * @file test_serial.cpp
+ *
+ * GPS_Serial_POSIX over a pty pair: raw mode, commands out and sentences
+ * in, then CPU per fix parsing a capture (data/drive.nmea) streamed at
+ * 115200 and 921600 baud. The pty does not pace by baudrate; a writer
+ * process does, and only the reading process is measured.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_Serial_POSIX.hh"
+
+TEST_DEFINE;
+
+/* Fixes streamed per baudrate */
+static const uint16_t FIXES = 100;
+
+static int
+pty(const char** name)
+{
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    return (-1);
+  *name = ptsname(master);
+  return (master);
+}
+
+static uint64_t
+now(clockid_t clock)
+{
+  struct timespec ts;
+
+  clock_gettime(clock, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+/* Write data at baudrate, 10 bits per character */
+static void
+stream(int fd, const std::string& data, uint32_t baudrate)
+{
+  uint64_t start = now(CLOCK_MONOTONIC);
+  size_t sent = 0;
+
+  while (sent < data.size())
+    {
+      uint64_t due = (now(CLOCK_MONOTONIC) - start) * (baudrate / 10)
+        / 1000000000ULL;
+      ssize_t n;
+
+      if (due > data.size())
+        due = data.size();
+      if (due > sent)
+        {
+          n = write(fd, data.data() + sent, due - sent);
+          if (n < 0)
+            return;
+          sent += n;
+        }
+      usleep(500);
+    }
+}
+
+/* Number of fixes committed from data */
+static uint16_t
+commits(const std::string& data)
+{
+  Buffer device;
+  GPS_NMEA gps(&device);
+
+  device.input = data;
+  gps.begin();
+  gps.consume();
+  return (gps.commits());
+}
+
+/* Stream data at baudrate, parse as read; CPU nanoseconds per fix */
+static uint64_t
+benchmark(const std::string& data, uint32_t baudrate, uint16_t expected)
+{
+  GPS_Serial_POSIX serial;
+  GPS_NMEA gps(&serial);
+  const char* name;
+  int master = pty(&name);
+  uint64_t deadline;
+  uint64_t cpu;
+  pid_t writer;
+
+  CHECK(master >= 0);
+  CHECK(serial.open(name, baudrate, 64));
+  gps.begin();
+
+  writer = fork();
+  if (writer == 0)
+    {
+      stream(master, data, baudrate);
+      _exit(0);
+    }
+  CHECK(writer > 0);
+
+  cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+  deadline = now(CLOCK_MONOTONIC) + 10000000000ULL;
+  while (gps.commits() < expected && now(CLOCK_MONOTONIC) < deadline)
+    {
+      /* Less than min characters are read on timeout */
+      serial.wait(20);
+      gps.consume();
+    }
+  cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+
+  waitpid(writer, NULL, 0);
+  CHECK_EQUAL(expected, gps.commits());
+  serial.close();
+  close(master);
+
+  return (gps.commits() == 0 ? 0 : cpu / gps.commits());
+}
+
+int
+main()
+{
+  GPS_Serial_POSIX serial;
+  GPS_NMEA gps(&serial);
+  std::string capture = load("data/drive.nmea");
+  std::string data;
+  std::string s;
+  const char* name;
+  char buf[64];
+  int master = pty(&name);
+  size_t end = 0;
+  ssize_t n;
+
+  CHECK(master >= 0);
+  CHECK(!serial.open(name, 1234));
+  CHECK(!serial.open("/nonexistent/tty", 115200));
+  CHECK(serial.open(name, 115200));
+  CHECK_EQUAL(-1, serial.getchar());
+  CHECK(!serial.wait(0));
+  CHECK(serial.room() > 0);
+
+  /* Command out, unchanged in raw mode */
+  s = nmea("PMTK000");
+  CHECK_EQUAL(s.size(), serial.write(s.data(), s.size()));
+  CHECK_EQUAL(0, serial.flush());
+  n = read(master, buf, sizeof(buf));
+  CHECK_EQUAL(s.size(), n);
+  CHECK(n > 0 && std::string(buf, n) == s);
+
+  /* Sentences in; one fix */
+  gps.begin();
+  s = nmea("GPRMC,123519.000,A,4807.038,N,01131.000,E,022.4,084.4,230394,,");
+  s += nmea("GPGGA,123519.000,4807.038,N,01131.000,E,1,08,0.9,545.4,M,"
+            "46.9,M,,");
+  CHECK_EQUAL(s.size(), write(master, s.data(), s.size()));
+  CHECK(serial.wait(1000));
+  for (int i = 0; i < 10 && serial.available() < (int) s.size(); i++)
+    usleep(10000);
+  CHECK_EQUAL(s.size(), serial.available());
+  gps.consume();
+  CHECK_EQUAL(1, gps.commits());
+  CHECK_EQUAL(0, serial.available());
+
+  /* Discarded input */
+  CHECK_EQUAL(s.size(), write(master, s.data(), s.size()));
+  CHECK(serial.wait(1000));
+  serial.empty();
+  CHECK(!serial.wait(50));
+  serial.close();
+  CHECK(!serial.wait(0));
+  close(master);
+
+  /* First fixes of the capture, each an RMC and GGA line */
+  for (uint16_t i = 0; i < 2 * FIXES && end != std::string::npos; i++)
+    {
+      end = capture.find('\n', end);
+      if (end != std::string::npos)
+        end++;
+    }
+  data = capture.substr(0, end);
+  CHECK(commits(data) > 0);
+
+  signal(SIGPIPE, SIG_IGN);
+  printf("serial: %u fixes, %u bytes\n",
+         (unsigned) commits(data), (unsigned) data.size());
+  for (uint32_t baudrate : { 115200, 921600 })
+    printf("serial: %lu baud, %lu ns cpu per fix\n",
+           (unsigned long) baudrate,
+           (unsigned long) benchmark(data, baudrate, commits(data)));
+
+  return (test_report("serial"));
+}
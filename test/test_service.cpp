@@ -0,0 +1,117 @@
+/**
+ * @file test_service.cpp
+ *
+ * GPS_NMEA_Service slices over a capture (data/drive.nmea): a receive
+ * event works off the backlog in slices of the slice size, a slice that
+ * uses all of its budget continues through the event queue behind other
+ * handlers, and a partial slice does not continue.
+ */
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_NMEA_Service.hh"
+
+TEST_DEFINE;
+
+/* Scheduler on simulated time; the test runs the jobs */
+class Clock : public Job::Scheduler {
+public:
+  virtual uint32_t time()
+  {
+    return (RTT::millis());
+  }
+};
+
+/* Counts events, e.g. of another driver */
+class Counter : public Event::Handler {
+public:
+  uint16_t events;
+
+  Counter() : events(0) {}
+
+  virtual void on_event(uint8_t type, uint16_t value)
+  {
+    UNUSED(type);
+    UNUSED(value);
+    events++;
+  }
+};
+
+static const uint16_t SLICE = 64;
+
+int
+main()
+{
+  std::string capture = load("data/drive.nmea");
+  Buffer device;
+  GPS_NMEA gps(&device);
+  GPS_NMEA reference(&device);
+  Clock clock;
+  GPS_NMEA_Service service(&clock, &gps, 100, SLICE);
+  Counter other;
+  uint32_t slices;
+  uint16_t commits;
+
+  CHECK(capture.size() > 10 * SLICE);
+  CHECK_EQUAL(SLICE, service.slice());
+
+  /* Commits of the capture when consumed at once */
+  reference.begin();
+  device.input = capture;
+  reference.consume();
+  commits = reference.commits();
+  CHECK(commits > 0);
+
+  /* Receive event; one slice, continued behind the event of another
+   * handler queued meanwhile */
+  gps.begin();
+  device.offset = 0;
+  CHECK(Event::push(Event::RECEIVE_COMPLETED_TYPE, &service));
+  CHECK(Event::push(Event::USER_TYPE, &other));
+  CHECK(Event::service());
+  CHECK_EQUAL(1, service.slices());
+  CHECK_EQUAL(1, service.continued());
+  CHECK_EQUAL(SLICE, device.offset);
+  CHECK(Event::service());
+  CHECK_EQUAL(1, service.slices());
+  CHECK_EQUAL(1, other.events);
+  CHECK(Event::service());
+  CHECK_EQUAL(2, service.slices());
+  CHECK_EQUAL(2 * SLICE, device.offset);
+
+  /* A receive event while continued queues no other slice */
+  CHECK(Event::push(Event::RECEIVE_COMPLETED_TYPE, &service));
+  CHECK(Event::service());
+  CHECK(Event::service());
+  CHECK_EQUAL(4, service.slices());
+  CHECK_EQUAL(3, service.continued());
+  CHECK(Event::service());
+  CHECK_EQUAL(5, service.slices());
+  CHECK_EQUAL(4, service.continued());
+
+  /* Backlog worked off in full slices; the last is partial and not
+   * continued, nor was the slice of the receive event */
+  host_dispatch();
+  slices = capture.size() / SLICE + 1;
+  CHECK_EQUAL(capture.size(), device.offset);
+  CHECK_EQUAL(slices, service.slices());
+  CHECK_EQUAL(slices - 2, service.continued());
+  CHECK(!Event::service());
+  CHECK_EQUAL(commits, gps.commits());
+
+  /* Partial slice of new data; not continued */
+  device.input += nmea("GPRMC,090000.000,V,,,,,,,111026,,,N");
+  CHECK(Event::push(Event::RECEIVE_COMPLETED_TYPE, &service));
+  CHECK(Event::service());
+  CHECK_EQUAL(slices + 1, service.slices());
+  CHECK_EQUAL(slices - 2, service.continued());
+  CHECK(!Event::service());
+  CHECK_EQUAL(device.input.size(), device.offset);
+
+  /* Periodic slice with nothing received */
+  service.run();
+  CHECK_EQUAL(slices + 2, service.slices());
+  CHECK(!Event::service());
+
+  return (test_report("service"));
+}
@@ -0,0 +1,229 @@
+/**
+ * @file test_storage.cpp
+ *
+ * GPS_Storage records in EEPROM and in a file: round trip, erased,
+ * corrupted and short records, and the save interval. The loaded fix
+ * aids GPS_NMEA_MT3339::begin() with PMTK740 and, in full builds,
+ * PMTK741 generated with the time at transmission; aiding is used
+ * once. Time to first fix is measured from the aided begin().
+ */
+
+#include <algorithm>
+#include <vector>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "test.hh"
+#include "GPS_NMEA_MT3339.hh"
+#include "GPS_Storage.hh"
+
+TEST_DEFINE;
+
+/* Receiver fed as the serial driver would; records completions */
+class Receiver : public GPS_NMEA_MT3339 {
+public:
+  std::vector<uint16_t> command;
+
+  Receiver(IOStream::Device* device) : GPS_NMEA_MT3339(device) {}
+
+  void feed(const std::string& s)
+  {
+#ifdef GPS_INTERRUPT_IMPL
+    for (size_t i = 0; i < s.size(); i++)
+      putchar(s[i]);
+#else
+    GPS_NMEA_MT3339::feed(s.data(), s.size());
+#endif
+    transmit();
+    host_dispatch();
+  }
+
+  void ack(uint16_t number)
+  {
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "PMTK001,%u,3", number);
+    feed(nmea(buf));
+  }
+
+protected:
+  virtual void command_completed(uint16_t number, uint8_t result)
+  {
+    command.push_back(number);
+  }
+};
+
+/* Record bytes covered by the checksum, with it */
+class Record : public GPS_Storage_EEPROM {
+public:
+  static const size_t CHECKED = offsetof(record_t, checksum) + 1;
+};
+
+/* Fix one second after the previous */
+static void
+epoch(Receiver& gps)
+{
+  static uint8_t second = 0;
+  char buf[128];
+
+  second++;
+  snprintf(buf, sizeof(buf), "GPRMC,0800%02u.000,A,5919.7576,N,"
+           "01804.1168,E,0.00,0.00,111026,,,A", second);
+  gps.feed(nmea(buf));
+  snprintf(buf, sizeof(buf), "GPGGA,0800%02u.000,5919.7576,N,"
+           "01804.1168,E,1,09,0.9,28.0,M,0.0,M,,", second);
+  gps.feed(nmea(buf));
+}
+
+static bool
+same(const GPS::fix_t& a, const GPS::fix_t& b)
+{
+  return (a.date == b.date && a.time == b.time
+#ifndef GPS_TIME_ONLY
+          && a.latitude == b.latitude && a.longitude == b.longitude
+          && a.altitude == b.altitude && a.course == b.course
+          && a.speed == b.speed && a.satellites == b.satellites
+          && a.hdop == b.hdop
+#endif
+          );
+}
+
+/* Sentence with given prefix in output, empty if none */
+static std::string
+sentence(const std::string& output, const char* prefix)
+{
+  size_t start = output.find(prefix);
+
+  if (start == std::string::npos)
+    return ("");
+  return (output.substr(start, output.find('*', start) - start));
+}
+
+int
+main()
+{
+  Buffer device;
+  Receiver gps(&device);
+  EEPROM eeprom;
+  GPS_Storage_EEPROM storage(&eeprom, (void*) 16, 10);
+  GPS::fix_t fix;
+  GPS::fix_t loaded;
+  uint8_t record[GPS_Storage_EEPROM::RECORD_SIZE];
+  char path[64];
+  time_t now;
+  std::string output;
+  FILE* file;
+
+  /* A committed fix */
+  gps.begin();
+  epoch(gps);
+  CHECK_EQUAL(1, gps.commits());
+  gps.get(fix);
+
+  /* EEPROM; zeroed memory is not a record */
+  CHECK(!storage.load(loaded));
+  CHECK(storage.save(fix));
+  CHECK(storage.load(loaded));
+  CHECK(same(fix, loaded));
+
+  /* Any changed byte is detected; erased is not a record */
+  for (size_t i = 0; i < Record::CHECKED; i++)
+    {
+
+      eeprom.read(record, (void*) 16, sizeof(record));
+      record[i] ^= 0x20;
+      eeprom.write((void*) 16, record, sizeof(record));
+      if (!CHECK(!storage.load(loaded)))
+        break;
+      record[i] ^= 0x20;
+      eeprom.write((void*) 16, record, sizeof(record));
+    }
+  CHECK(storage.load(loaded));
+  memset(record, 0xff, sizeof(record));
+  eeprom.write((void*) 16, record, sizeof(record));
+  CHECK(!storage.load(loaded));
+
+  /* Saved on commit at most once per interval */
+  gps.attach(&storage);
+  epoch(gps);
+  CHECK_EQUAL(1, storage.saves());
+  host_advance(9000);
+  epoch(gps);
+  CHECK_EQUAL(1, storage.saves());
+  host_advance(1000);
+  epoch(gps);
+  CHECK_EQUAL(2, storage.saves());
+  gps.get(fix);
+  CHECK(storage.load(loaded));
+  CHECK(same(fix, loaded));
+  gps.detach(&storage);
+
+  /* File; replaced as a whole */
+  snprintf(path, sizeof(path), "/tmp/test_storage.%d", (int) getpid());
+  GPS_Storage_File store(path);
+  CHECK(!store.load(loaded));
+  CHECK(store.save(fix));
+  CHECK(store.load(loaded));
+  CHECK(same(fix, loaded));
+  CHECK(access((std::string(path) + ".tmp").c_str(), F_OK) != 0);
+
+  /* Short and corrupted files are not records */
+  file = fopen(path, "r+b");
+  CHECK(file != NULL);
+  fseek(file, 4, SEEK_SET);
+  fputc(0x55, file);
+  fclose(file);
+  CHECK(!store.load(loaded));
+  CHECK(store.save(fix));
+  CHECK(truncate(path, GPS_Storage_EEPROM::RECORD_SIZE - 1) == 0);
+  CHECK(!store.load(loaded));
+  unlink(path);
+  GPS_Storage_File missing("/tmp/no such directory/fix");
+  CHECK(!missing.save(fix));
+
+  /* Aided start 2026-10-11 08:00:00; the commands are generated when
+   * transmitted by begin(), 5 s after assist() */
+  now.seconds = 0;
+  now.minutes = 0;
+  now.hours = 8;
+  now.date = 11;
+  now.month = 10;
+  now.year = 26;
+  gps.end();
+  gps.ack(161);
+  gps.assist(now, &loaded);
+  host_advance(5000);
+  device.take();
+  CHECK(gps.begin());
+  output = device.take();
+  CHECK(sentence(output, "$PMTK740") == "$PMTK740,2026,10,11,08,00,05");
+#ifndef GPS_TIME_ONLY
+  CHECK(sentence(output, "$PMTK741") ==
+        "$PMTK741,59.329293,18.068613,28,2026,10,11,08,00,05");
+  gps.ack(741);
+#else
+  CHECK(sentence(output, "$PMTK741") == "");
+#endif
+  gps.ack(740);
+  CHECK(std::find(gps.command.begin(), gps.command.end(), 740) !=
+        gps.command.end());
+
+  /* Time to first fix from the aided begin() */
+  host_advance(700);
+  epoch(gps);
+  CHECK(gps.ttff_measured());
+  CHECK_EQUAL(700, gps.ttff());
+
+  /* Aiding is used once */
+  gps.end();
+  gps.ack(161);
+  device.take();
+  CHECK(gps.begin());
+  host_advance(1000);
+  gps.transmit();
+  output = device.take();
+  CHECK(sentence(output, "$PMTK740") == "");
+  CHECK(sentence(output, "$PMTK741") == "");
+
+  return (test_report("storage"));
+}
@@ -0,0 +1,172 @@
+/**
+ * @file test_telemetry.cpp
+ *
+ * GPS_Telemetry encode/decode round trip over a capture
+ * (data/drive.nmea), with lost and corrupted packets. Reports bytes
+ * per fix and encode time per fix against the text output of
+ * operator<<(IOStream&, GPS&).
+ */
+
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_Telemetry.hh"
+
+TEST_DEFINE;
+
+/* Collects committed fixes */
+class Fixes : public GPS::Listener {
+public:
+  std::vector<GPS::fix_t> fix;
+
+  virtual void on_fix(GPS& gps)
+  {
+    GPS::fix_t f;
+
+    gps.get(f);
+    fix.push_back(f);
+  }
+};
+
+/* GPS holding a given fix, for printing */
+class Snapshot : public GPS {
+public:
+  void set(const GPS::fix_t& fix)
+  {
+    m_last_update = 1;
+    m_date = fix.date;
+    m_time = fix.time;
+#ifndef GPS_TIME_ONLY
+    m_latitude = fix.latitude;
+    m_longitude = fix.longitude;
+    m_altitude = fix.altitude;
+    m_course = fix.course;
+    m_speed = fix.speed;
+    m_satellites = fix.satellites;
+    m_hdop = fix.hdop;
+#endif
+  }
+};
+
+static bool
+same(const GPS::fix_t& a, const GPS::fix_t& b)
+{
+  return (a.date == b.date && a.time == b.time
+#ifndef GPS_TIME_ONLY
+          && a.latitude == b.latitude && a.longitude == b.longitude
+          && a.altitude == b.altitude && a.course == b.course
+          && a.speed == b.speed && a.satellites == b.satellites
+          && a.hdop == b.hdop
+#endif
+          );
+}
+
+/* Encode fixes, decode all but the lost packet; packets decoded */
+static std::vector<GPS::fix_t>
+round_trip(const std::vector<GPS::fix_t>& fixes, bool delta, size_t lost,
+           const char* name)
+{
+  GPS_Telemetry::Encoder encoder(delta);
+  GPS_Telemetry::Decoder decoder;
+  std::vector<std::string> packets;
+  std::vector<GPS::fix_t> decoded;
+  uint8_t buf[GPS_Telemetry::KEY_SIZE];
+  GPS::fix_t fix;
+  size_t bytes = 0;
+  uint32_t start;
+
+  start = RTT::micros();
+  for (size_t i = 0; i < fixes.size(); i++)
+    {
+      size_t n = encoder.encode(fixes[i], buf, sizeof(buf));
+
+      CHECK(n == GPS_Telemetry::KEY_SIZE || n == GPS_Telemetry::DELTA_SIZE);
+      packets.push_back(std::string((const char*) buf, n));
+      bytes += n;
+    }
+  start = RTT::micros() - start;
+  printf("%s: %u fixes, %.2f bytes/fix (fix_t %u), %.0f ns/fix\n",
+         name, (unsigned) fixes.size(), (double) bytes / fixes.size(),
+         (unsigned) sizeof(GPS::fix_t), start * 1000.0 / fixes.size());
+
+  for (size_t i = 0; i < packets.size(); i++)
+    if (i != lost && decoder.decode(packets[i].data(), packets[i].size(), fix))
+      decoded.push_back(fix);
+  CHECK_EQUAL(0, decoder.errors());
+  return (decoded);
+}
+
+int
+main()
+{
+  std::string capture = load("data/drive.nmea");
+  Buffer device;
+  GPS_NMEA gps(&device);
+  Fixes fixes;
+  std::vector<GPS::fix_t> decoded;
+  GPS_Telemetry::Encoder encoder;
+  GPS_Telemetry::Decoder decoder;
+  uint8_t buf[GPS_Telemetry::KEY_SIZE];
+  GPS::fix_t fix;
+  Snapshot snapshot;
+  Buffer text;
+  IOStream out(&text);
+  uint32_t start;
+  size_t n;
+
+  /* Parse capture */
+  gps.attach(&fixes);
+  gps.begin();
+  device.input = capture;
+  gps.consume();
+  CHECK_EQUAL(600, fixes.fix.size());
+
+  /* Key packets only */
+  decoded = round_trip(fixes.fix, false, fixes.fix.size(), "key");
+  CHECK_EQUAL(fixes.fix.size(), decoded.size());
+  for (size_t i = 0; i < decoded.size(); i++)
+    if (!CHECK(same(fixes.fix[i], decoded[i])))
+      break;
+
+  /* Delta packets */
+  decoded = round_trip(fixes.fix, true, fixes.fix.size(), "delta");
+  CHECK_EQUAL(fixes.fix.size(), decoded.size());
+  for (size_t i = 0; i < decoded.size(); i++)
+    if (!CHECK(same(fixes.fix[i], decoded[i])))
+      break;
+
+  /* Lost delta packet; deltas up to the next key packet are skipped,
+   * the fixes decoded are exact */
+  decoded = round_trip(fixes.fix, true, 20, "lost");
+  CHECK(decoded.size() < fixes.fix.size() - 1);
+  CHECK(decoded.size() >= fixes.fix.size() - 16);
+  for (size_t i = 0, k = 0; i < fixes.fix.size() && k < decoded.size(); i++)
+    if (fixes.fix[i].time == decoded[k].time)
+      CHECK(same(fixes.fix[i], decoded[k++]));
+
+  /* Corrupted packet is counted and skipped */
+  n = encoder.encode(fixes.fix[0], buf, sizeof(buf));
+  buf[n / 2] ^= 0x10;
+  CHECK(!decoder.decode(buf, n, fix));
+  CHECK_EQUAL(1, decoder.errors());
+  CHECK(!decoder.decode(buf, n - 1, fix));
+  CHECK_EQUAL(2, decoder.errors());
+  n = encoder.encode(fixes.fix[1], buf, GPS_Telemetry::KEY_SIZE - 1);
+  CHECK_EQUAL(0, n);
+
+  /* Text output of the same fixes */
+  start = RTT::micros();
+  for (size_t i = 0; i < fixes.fix.size(); i++)
+    {
+      snapshot.set(fixes.fix[i]);
+      out << snapshot << IOStream::CRLF;
+    }
+  start = RTT::micros() - start;
+  printf("text: %u fixes, %.2f bytes/fix, %.0f ns/fix\n",
+         (unsigned) fixes.fix.size(),
+         (double) text.output.size() / fixes.fix.size(),
+         start * 1000.0 / fixes.fix.size());
+
+  return (test_report("telemetry"));
+}
@@ -0,0 +1,146 @@
+/**
+ * @file test_track.cpp
+ *
+ * GPS_Track encode/decode round trip over a capture (data/drive.nmea,
+ * 10 minutes of $GPRMC/$GPGGA at 1 Hz with stops and turns). Reports
+ * bytes per fix and encode time per fix.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include "test.hh"
+#include "GPS_NMEA.hh"
+#include "GPS_Track.hh"
+
+TEST_DEFINE;
+
+/* Collects committed fixes */
+class Fixes : public GPS::Listener {
+public:
+  std::vector<GPS::fix_t> fix;
+
+  virtual void on_fix(GPS& gps)
+  {
+    GPS::fix_t f;
+
+    gps.get(f);
+    fix.push_back(f);
+  }
+};
+
+static bool
+same(const GPS::fix_t& a, const GPS::fix_t& b)
+{
+  return (a.date == b.date && a.time == b.time
+#ifndef GPS_TIME_ONLY
+          && a.latitude == b.latitude && a.longitude == b.longitude
+          && a.altitude == b.altitude && a.course == b.course
+          && a.speed == b.speed && a.satellites == b.satellites
+          && a.hdop == b.hdop
+#endif
+          );
+}
+
+/* Encode fixes, return records decoded */
+static std::vector<GPS::fix_t>
+round_trip(const std::vector<GPS::fix_t>& fixes, uint16_t tolerance,
+           const char* name)
+{
+  Buffer log;
+  GPS_Track::Encoder encoder(&log, tolerance);
+  std::vector<GPS::fix_t> decoded;
+  GPS::fix_t fix;
+  uint32_t start;
+
+  start = RTT::micros();
+  for (size_t i = 0; i < fixes.size(); i++)
+    encoder.encode(fixes[i]);
+  encoder.flush();
+  start = RTT::micros() - start;
+
+  CHECK_EQUAL(fixes.size(), encoder.fixes());
+  CHECK_EQUAL(log.output.size(), encoder.bytes());
+  printf("%s: %u fixes, %u records, %.2f bytes/fix (fix_t %u), "
+         "%.0f ns/fix\n", name,
+         (unsigned) encoder.fixes(), (unsigned) encoder.records(),
+         (double) encoder.bytes() / encoder.fixes(),
+         (unsigned) sizeof(GPS::fix_t),
+         start * 1000.0 / encoder.fixes());
+
+  log.input = log.take();
+  GPS_Track::Decoder decoder(&log);
+  while (decoder.decode(fix))
+    decoded.push_back(fix);
+  CHECK_EQUAL(encoder.records(), decoded.size());
+  return (decoded);
+}
+
+int
+main()
+{
+  std::string capture = load("data/drive.nmea");
+  Buffer device;
+  GPS_NMEA gps(&device);
+  Fixes fixes;
+  std::vector<GPS::fix_t> decoded;
+
+  /* Parse capture */
+  gps.attach(&fixes);
+  gps.begin();
+  device.input = capture;
+  gps.consume();
+  CHECK_EQUAL(600, fixes.fix.size());
+
+  /* Lossless */
+  decoded = round_trip(fixes.fix, 0, "lossless");
+  CHECK_EQUAL(fixes.fix.size(), decoded.size());
+  for (size_t i = 0; i < decoded.size() && i < fixes.fix.size(); i++)
+    if (!CHECK(same(fixes.fix[i], decoded[i])))
+      break;
+
+#ifndef GPS_TIME_ONLY
+  /* Simplified; kept fixes are exact, dropped ones within tolerance
+   * of the line between the kept fixes around them (plus rounding) */
+  const double tolerance = 10;
+  decoded = round_trip(fixes.fix, tolerance, "simplified");
+  CHECK(decoded.size() < fixes.fix.size() / 2);
+  size_t k = 0;
+  double worst = 0;
+  for (size_t i = 0; i < fixes.fix.size() && k < decoded.size(); i++)
+    {
+      const GPS::fix_t& f = fixes.fix[i];
+
+      if (f.time == decoded[k].time)
+        {
+          CHECK(same(f, decoded[k]));
+          k++;
+          continue;
+        }
+      if (!CHECK(k > 0))
+        break;
+
+      /* Meters from segment decoded[k - 1]..decoded[k] */
+      const GPS::fix_t& a = decoded[k - 1];
+      const GPS::fix_t& b = decoded[k];
+      double m = 0.111195;
+      double c = cos(a.latitude * 1e-6 * M_PI / 180);
+      double bx = (b.longitude - a.longitude) * m * c;
+      double by = (b.latitude - a.latitude) * m;
+      double px = (f.longitude - a.longitude) * m * c;
+      double py = (f.latitude - a.latitude) * m;
+      double l = bx * bx + by * by;
+      double t = (l == 0 ? 0 : (px * bx + py * by) / l);
+      if (t < 0) t = 0;
+      if (t > 1) t = 1;
+      double d = hypot(px - t * bx, py - t * by);
+      if (d > worst)
+        worst = d;
+    }
+  CHECK_EQUAL(decoded.size(), k);
+  printf("simplified: worst deviation %.1f m\n", worst);
+  CHECK(worst <= tolerance + 4);
+#endif
+
+  return (test_report("track"));
+}
@@ -0,0 +1,132 @@
+/**
+ * @file test_units.cpp
+ *
+ * GPS::decimal() printing and the integer unit conversions against
+ * tables: rounding at and around half a unit, negative values, zero
+ * places, the clamp at 9 places and the ends of the value ranges.
+ */
+
+#include "test.hh"
+#include "GPS.hh"
+
+TEST_DEFINE;
+
+/* GPS holding given speed and altitude */
+class Snapshot : public GPS {
+public:
+#ifndef GPS_TIME_ONLY
+  void set(speed_t speed, altitude_t altitude)
+  {
+    m_speed = speed;
+    m_altitude = altitude;
+  }
+#endif
+};
+
+static const struct {
+  int32_t value;
+  uint8_t places;
+  const char* text;
+} decimals[] = {
+  { 0, 0, "0" },
+  { 0, 2, "0.00" },
+  { 7, 0, "7" },
+  { -7, 0, "-7" },
+  { 123456, 0, "123456" },
+  { 5, 2, "0.05" },
+  { -5, 2, "-0.05" },
+  { -50, 2, "-0.50" },
+  { 100, 2, "1.00" },
+  { -100, 2, "-1.00" },
+  { 59329293, 6, "59.329293" },
+  { -18068613, 6, "-18.068613" },
+  { -1, 9, "-0.000000001" },
+  { 1, 12, "0.000000001" },
+  { 2147483647, 9, "2.147483647" },
+  { -2147483647 - 1, 9, "-2.147483648" },
+  { -2147483647 - 1, 0, "-2147483648" },
+  { -2147483647 - 1, 255, "-2.147483648" }
+};
+
+#ifndef GPS_TIME_ONLY
+/* Speed in 100ths of a knot; rounded half up. A 100th of a knot is
+ * 463/250 100ths of a km/h, 463/90 mm/s and 57875/50292 100ths of a
+ * mph; 125, 45 and 25146 are exactly half way. The products of the
+ * last row do not fit 32 bits. */
+static const struct {
+  uint32_t speed;
+  uint32_t kmph100;
+  uint32_t mmps;
+  uint32_t mph100;
+} speeds[] = {
+  { 0, 0, 0, 0 },
+  { 1, 2, 5, 1 },
+  { 2, 4, 10, 2 },
+  { 45, 83, 232, 52 },
+  { 124, 230, 638, 143 },
+  { 125, 232, 643, 144 },
+  { 135, 250, 695, 155 },
+  { 375, 695, 1929, 432 },
+  { 25146, 46570, 129362, 28938 },
+  { 50291, 93139, 258719, 57874 },
+  { 50292, 93141, 258724, 57875 },
+  { 9276000, 17179152, 47719867, 10674630 },
+  { 10000000, 18520000, 51444444, 11507794 }
+};
+
+/* Altitude in centimeters to 10ths of a foot, rounded half away from
+ * zero; a centimeter is 125/381 10ths of a foot, never exactly half */
+static const struct {
+  int32_t altitude;
+  int32_t ft10;
+} altitudes[] = {
+  { 0, 0 },
+  { 1, 0 },
+  { -1, 0 },
+  { 2, 1 },
+  { -2, -1 },
+  { 32, 10 },
+  { -32, -10 },
+  { 349, 115 },
+  { -349, -115 },
+  { 884000, 290026 },
+  { -42000, -13780 },
+  { 17000000, 5577428 },
+  { -17000000, -5577428 }
+};
+#endif
+
+int
+main()
+{
+  Buffer buffer;
+  IOStream out(&buffer);
+
+  for (size_t i = 0; i < membersof(decimals); i++)
+    {
+      out << GPS::decimal(decimals[i].value, decimals[i].places);
+      if (!CHECK(buffer.take() == decimals[i].text))
+        printf("decimal(%ld, %u)\n",
+               (long) decimals[i].value, decimals[i].places);
+    }
+  CHECK_EQUAL(9, GPS::decimal(1, 10).places);
+
+#ifndef GPS_TIME_ONLY
+  Snapshot gps;
+
+  for (size_t i = 0; i < membersof(speeds); i++)
+    {
+      gps.set(speeds[i].speed, 0);
+      CHECK_EQUAL(speeds[i].kmph100, gps.speed_kmph100());
+      CHECK_EQUAL(speeds[i].mmps, gps.speed_mmps());
+      CHECK_EQUAL(speeds[i].mph100, gps.speed_mph100());
+    }
+  for (size_t i = 0; i < membersof(altitudes); i++)
+    {
+      gps.set(0, altitudes[i].altitude);
+      CHECK_EQUAL(altitudes[i].ft10, gps.altitude_ft10());
+    }
+#endif
+
+  return (test_report("units"));
+}